@@ -19,7 +19,10 @@
 #endif
 
 #ifdef __cplusplus
+#	include <cstddef>
 #	include <cstdint>
+#	include <memory>
+#	include <new>
 #	define BUNGEE_PREFIX extern "C" BUNGEE_VISIBILITY const Bungee::Functions
 namespace Bungee {
 #else
@@ -79,6 +82,19 @@ struct InputChunk
 	int end;
 };
 
+/**
+ * @brief Formats of input audio samples accepted by Stretcher::analyseGrainFormatted().
+ * @details Integer samples are scaled so that full scale maps to [-1, 1). 24-bit samples are packed little-endian
+ * in three bytes. 16-bit floating-point samples are IEEE 754 binary16 values. Strides are in samples.
+ */
+enum SampleFormat
+{
+	sampleFormat_float32,
+	sampleFormat_int16,
+	sampleFormat_int24,
+	sampleFormat_float16,
+};
+
 /**
  * @brief Describes a chunk of audio output.
  * @details Output chunks do not overlap and should be appended for seamless playback.
@@ -86,7 +102,8 @@ struct InputChunk
 struct OutputChunk
 {
 	/**
-	 * @brief Audio output data, not aligned and not interleaved.
+	 * @brief Audio output data, not aligned and, unless interleaved output is enabled, not interleaved: frame n of
+	 * channel c is at data[n * frameStride + c * channelStride], where frameStride is Stretcher::outputFrameStride().
 	 */
 	float *data;
 
@@ -125,6 +142,164 @@ struct SampleRates
 	int output;
 };
 
+/**
+ * @brief Describes the input audio of one stretcher's grain when several stretchers are processed together.
+ * @details Members correspond to the parameters of Stretcher::analyseGrain().
+ */
+struct GrainInput
+{
+	/**
+	 * @brief Pointer to input audio data for the range returned by specifyGrain().
+	 */
+	const float *data;
+
+	/**
+	 * @brief nth audio channel audio starts at data[n * channelStride].
+	 */
+	intptr_t channelStride;
+
+	/**
+	 * @brief Number of unavailable frames at the start of the input chunk.
+	 */
+	int muteFrameCountHead;
+
+	/**
+	 * @brief Number of unavailable frames at the end of the input chunk.
+	 */
+	int muteFrameCountTail;
+};
+
+/**
+ * @brief A point on a timeline of grains, as passed to Stretcher::schedule().
+ * @details From outputFrame on, grains take the speed and pitch of request, changing linearly towards those of the next
+ * keyframe, and its modes. Where request.position is not NaN the timeline seeks there, resetting the stretcher if
+ * request.reset is set. Elsewhere positions advance with speed, as by Stretcher::next().
+ */
+struct Keyframe
+{
+	/**
+	 * @brief Output frame at which the keyframe takes effect; keyframes must be in nondecreasing order of outputFrame.
+	 */
+	double outputFrame;
+
+	/**
+	 * @brief Speed, pitch and resample mode from outputFrame and, unless NaN, a position to seek to. The first keyframe must have a position.
+	 */
+	struct Request request;
+};
+
+/**
+ * @brief Phases of grain processing that are timed for Stretcher::getStats(), with descriptions.
+ */
+#define BUNGEE_STATS_PHASES \
+	X_PHASE(inputResample, "input resampling") \
+	X_PHASE(analysisWindow, "analysis window, including any conversion of input samples and any forward FFT fused with it") \
+	X_PHASE(forwardTransform, "forward FFT, where not fused with the analysis window") \
+	X_PHASE(polar, "energy and phase of each bin") \
+	X_PHASE(enumeratePartials, "Partials::enumerate") \
+	X_PHASE(suppressTransientPartials, "Partials::suppressTransientPartials") \
+	X_PHASE(synthesise, "Synthesis::synthesise") \
+	X_PHASE(inverseTransform, "bin rotation, any formant correction and inverse FFT, and any overlap-add fused with them") \
+	X_PHASE(overlapAdd, "synthesis window and overlap-add, where not fused with the inverse FFT") \
+	X_PHASE(outputResample, "output resampling")
+
+/**
+ * @brief Index of each phase of grain processing within Stats::phases.
+ */
+enum StatsPhase
+{
+#define X_PHASE(phase, description) statsPhase_##phase,
+	BUNGEE_STATS_PHASES
+#undef X_PHASE
+	statsPhase_count
+};
+
+/**
+ * @brief Distribution of the durations of timed calls to one phase of grain processing.
+ */
+struct StatsHistogram
+{
+	/**
+	 * @brief Number of timed calls.
+	 */
+	uint64_t count;
+
+	/**
+	 * @brief Sum of the durations of all timed calls, in nanoseconds.
+	 */
+	uint64_t totalNanoseconds;
+
+	/**
+	 * @brief bins[k] counts calls whose duration, in nanoseconds, is in the range [2^k, 2^(k+1)).
+	 * @details The first bin also counts calls of less than a nanosecond and the last bin counts all longer calls.
+	 */
+	uint64_t bins[32];
+};
+
+/**
+ * @brief Timing statistics of a stretcher's grain processing since its construction, as returned by Stretcher::getStats().
+ * @details All counts are zero if the library was built with BUNGEE_NO_STATS defined.
+ */
+struct Stats
+{
+	/**
+	 * @brief Histogram of each phase, indexed by StatsPhase.
+	 */
+	struct StatsHistogram phases[statsPhase_count];
+};
+
+/**
+ * @brief FFT implementations that a build of the library may include, with descriptions.
+ * @details PFFFT and lanes are always included; vDSP is included by default on Apple platforms. The others are
+ * included when the library is built with the corresponding BUNGEE_USE_ option (see CMakeLists.txt).
+ */
+#define BUNGEE_FFT_BACKENDS \
+	X_FFT(pffft, "PFFFT, portable SIMD FFT") \
+	X_FFT(fftw, "FFTW 3, single precision") \
+	X_FFT(vdsp, "vDSP, Apple Accelerate framework") \
+	X_FFT(ipp, "Intel Integrated Performance Primitives") \
+	X_FFT(kissfft, "KissFFT") \
+	X_FFT(lanes, "Bungee's own FFT, with the channels of a grain in SIMD lanes")
+
+/**
+ * @brief Selects the FFT implementation of a stretcher, as by Stretcher::setFftBackend().
+ */
+enum FftBackend
+{
+#define X_FFT(backend, description) fftBackend_##backend,
+	BUNGEE_FFT_BACKENDS
+#undef X_FFT
+	fftBackend_count,
+	/** For each transform length, whichever included backend was fastest when timed once per process */
+	fftBackend_fastest = fftBackend_count,
+};
+
+/**
+ * @brief Memory functions with which a stretcher allocates its buffers, as passed to its constructor.
+ * @details A stretcher holds all of its audio and spectral buffers in one block, allocated when it is constructed and
+ * freed when it is destroyed, so these functions are never called by grain functions. Copies of input for the checks of
+ * instrumentation are a second block, allocated when instrumentation is first enabled. Small bookkeeping objects, and
+ * the FFT kernels and windows that stretchers share, are allocated from the default heap. Stream and Push::InputBuffer
+ * can take their buffers from the same functions through AllocatorAdapter.
+ */
+struct Allocator
+{
+	/**
+	 * @brief Returns size bytes aligned to alignment, a power of two, or null if it cannot.
+	 */
+	void *(*allocate)(void *context, intptr_t size, intptr_t alignment);
+
+	/**
+	 * @brief Frees memory returned by allocate with the same size and alignment.
+	 */
+	void (*deallocate)(void *context, void *memory, intptr_t size, intptr_t alignment);
+
+	/**
+	 * @brief Passed to allocate and deallocate; must remain valid until the stretcher is destroyed.
+	 */
+	void *context;
+};
+
 /**
  * @brief C API function table for the Bungee stretcher.
  * @details This struct is not part of the C++ API. It is necessary here to facilitate extern "C" linkage to shared libraries.
@@ -167,6 +342,84 @@ struct Functions
 
 	/** @brief Returns true if the stretcher is flushed. */
 	bool (*isFlushed)(const void *implementation);
+
+	/** @brief Analyses and synthesises the current grain of each of several stretcher instances. */
+	void (*processGrains)(int count, void *const *implementations, const struct GrainInput *inputs, struct OutputChunk *outputChunks);
+
+	/** @brief Sets the number of threads that share the per-channel work of each grain. */
+	void (*setThreadCount)(void *implementation, int threadCount);
+
+	/** @brief Enables or disables pipelined operation. */
+	void (*enablePipelining)(void *implementation, int enable);
+
+	/** @brief Begins processing the grain, with input audio whose frames are frameStride apart. */
+	void (*analyseGrainStrided)(void *implementation, const float *data, intptr_t channelStride, intptr_t frameStride, int muteFrameCountHead, int muteFrameCountTail);
+
+	/** @brief Enables or disables interleaved output chunks. */
+	void (*enableInterleavedOutput)(void *implementation, int enable);
+
+	/** @brief Begins processing the grain, with input audio samples of the given format. */
+	void (*analyseGrainFormatted)(void *implementation, const void *data, enum SampleFormat sampleFormat, intptr_t channelStride, intptr_t frameStride, int muteFrameCountHead, int muteFrameCountTail);
+
+	/** @brief Completes processing of the grain and also writes its output as dithered 16-bit samples. */
+	void (*synthesiseGrainInt16)(void *implementation, struct OutputChunk *outputChunk, int16_t *data, intptr_t channelStride, intptr_t frameStride);
+
+	/** @brief Returns the maximum output frame count. */
+	int (*maxOutputFrameCount)(const void *implementation);
+
+	/** @brief Copies timing statistics of grain processing. */
+	void (*getStats)(const void *implementation, struct Stats *stats);
+
+	/** @brief Selects the FFT implementation of a stretcher, returning false if the backend is not included. */
+	bool (*setFftBackend)(void *implementation, enum FftBackend backend);
+
+	/** @brief Selects the FFT implementation of stretchers created afterwards, returning false if the backend is not included. */
+	bool (*setDefaultFftBackend)(enum FftBackend backend);
+
+	/** @brief Returns the FFT implementation that a stretcher uses for its grains. */
+	enum FftBackend (*fftBackend)(const void *implementation);
+
+	/** @brief Enables or disables real-time mode, in which grain functions never allocate, lock or make system calls. */
+	void (*enableRealTime)(void *implementation, int enable);
+
+	/** @brief Enables or disables multi-resolution mode, in which transient grains use transforms of half the usual length. */
+	void (*enableMultiResolution)(void *implementation, int enable);
+
+	/** @brief Computes the requests and input chunks of every grain of a timeline of keyframes, returning the number of grains. */
+	int (*schedule)(const void *implementation, const struct Keyframe *keyframes, int keyframeCount, struct Request *requests, struct InputChunk *inputChunks, int capacity);
+
+	/** @brief Writes the stretcher's state between grains to data, if capacity bytes suffice, and returns its size in bytes. */
+	intptr_t (*snapshot)(const void *implementation, void *data, intptr_t capacity);
+
+	/** @brief Replaces the stretcher's state with a snapshot, returning false and changing nothing if it cannot. */
+	bool (*restore)(void *implementation, const void *data, intptr_t size);
+
+	/** @brief Enables or disables low-latency mode, in which every grain uses a transform of half the usual length. */
+	void (*enableLowLatency)(void *implementation, int enable);
+
+	/** @brief Returns, in input frames, the latency of grains like request. */
+	double (*latency)(const void *implementation, const struct Request *request);
+
+	/** @brief Enables or disables formant preservation, which keeps the spectral envelope of pitch-shifted grains. */
+	void (*enableFormantPreservation)(void *implementation, int enable);
+
+	/** @brief Divides the channels into groups, each of whose channels share phase. */
+	bool (*setChannelGroups)(void *implementation, const int *channelCounts, int groupCount);
+
+	/** @brief Creates a new stretcher instance whose buffers are allocated by allocator, or as by create() if allocator is null; returns null if allocation fails. */
+	void *(*createWithAllocator)(struct SampleRates sampleRates, int channelCount, int log2SynthesisHopAdjust, const struct Allocator *allocator);
+
+	/** @brief Enables or disables partial tracking, in which each grain's partials follow those of the previous grain. */
+	void (*enablePartialTracking)(void *implementation, int enable);
+
+	/** @brief Sets the interpolation filter used by any resampling of subsequent grains. */
+	void (*setInterpolationMode)(void *implementation, enum InterpolationMode interpolationMode);
+
+	/** @brief Specifies the input chunk for a grain, as specifyGrain(), whose pitch ramps from the previous grain through pitchMidpoint. */
+	struct InputChunk (*specifyGrainWithPitchMidpoint)(void *implementation, const struct Request *request, double bufferStartPosition, double pitchMidpoint);
+
+	/** @brief Returns the stride between consecutive frames of output chunks: 1, or the channel count if interleaved output is enabled. */
+	intptr_t (*outputFrameStride)(const void *implementation);
 };
 
 #ifdef __cplusplus
@@ -206,6 +459,60 @@ struct Pro
 	static constexpr auto getFunctions = &getFunctionsBungeePro;
 };
 
+/**
+ * @brief Standard-library allocator that takes memory from an Allocator, or from the default heap if the Allocator's
+ * functions are null, so that containers such as the buffers of Stream and Push::InputBuffer share a stretcher's memory.
+ *
+ * @tparam T The element type.
+ */
+template <class T>
+struct AllocatorAdapter
+{
+	typedef T value_type;
+
+	Allocator allocator{};
+
+	AllocatorAdapter() = default;
+
+	explicit AllocatorAdapter(const Allocator &allocator) :
+		allocator(allocator)
+	{
+	}
+
+	template <class U>
+	AllocatorAdapter(const AllocatorAdapter<U> &other) :
+		allocator(other.allocator)
+	{
+	}
+
+	/**
+	 * @throws std::bad_alloc if Allocator::allocate returns null.
+	 */
+	T *allocate(std::size_t n)
+	{
+		if (!allocator.allocate || !allocator.deallocate)
+			return std::allocator<T>().allocate(n);
+		void *p = allocator.allocate(allocator.context, intptr_t(n * sizeof(T)), alignof(T));
+		if (!p)
+			throw std::bad_alloc();
+		return static_cast<T *>(p);
+	}
+
+	void deallocate(T *p, std::size_t n)
+	{
+		if (!allocator.allocate || !allocator.deallocate)
+			std::allocator<T>().deallocate(p, n);
+		else
+			allocator.deallocate(allocator.context, p, intptr_t(n * sizeof(T)), alignof(T));
+	}
+
+	template <class U>
+	bool operator==(const AllocatorAdapter<U> &other) const
+	{
+		return allocator.allocate == other.allocator.allocate && allocator.deallocate == other.allocator.deallocate && allocator.context == other.allocator.context;
+	}
+};
+
 /**
  * @brief Bungee audio stretcher class template.
  *
@@ -251,6 +558,27 @@ struct Stretcher
 	{
 	}
 
+	/**
+	 * @brief Constructs a new Stretcher instance whose buffers are allocated by allocator.
+	 *
+	 * @param sampleRates The input and output sample rates.
+	 * @param channelCount Number of audio channels.
+	 * @param log2SynthesisHopAdjust Granularity adjustment, as for the constructor above.
+	 * @param allocator Memory functions, for example of a pool local to a NUMA node or of huge pages, which are
+	 * called once to allocate the block that holds all of the stretcher's audio and spectral buffers and once to
+	 * free it, and once more for input copies if instrumentation is enabled. The functions are copied but their
+	 * context must remain valid until the stretcher is destroyed.
+	 * @throws std::bad_alloc if allocation fails. The library's Functions::createWithAllocator returns null instead, so
+	 * that no exception crosses the C interface, and this constructor throws on the caller's side of it.
+	 */
+	inline Stretcher(SampleRates sampleRates, int channelCount, int log2SynthesisHopAdjust, const Allocator &allocator) :
+		functions(Edition::getFunctions()),
+		state(functions->createWithAllocator(sampleRates, channelCount, log2SynthesisHopAdjust, &allocator))
+	{
+		if (!state)
+			throw std::bad_alloc();
+	}
+
 	/**
 	 * @brief Destructor. Destroys the stretcher instance and releases resources.
 	 */
@@ -264,6 +592,7 @@ struct Stretcher
 	 *
 	 * @param enable Set to true to enable diagnostics, false to disable.
 	 * @note Diagnostics are reported to the system log file on iOS, Mac, and Android, or to stderr on other platforms.
+	 * Enabling allocates storage for input checks, so call outside real-time code.
 	 */
 	inline void enableInstrumentation(bool enable)
 	{
@@ -281,6 +610,15 @@ struct Stretcher
 		return functions->maxInputFrameCount(state);
 	}
 
+	/**
+	 * @brief Returns the largest number of frames that an output chunk can contain.
+	 * @return The maximum output frame count.
+	 */
+	inline int maxOutputFrameCount() const
+	{
+		return functions->maxOutputFrameCount(state);
+	}
+
 	/**
 	 * @brief Adjusts the request for preroll.
 	 *
@@ -317,6 +655,23 @@ struct Stretcher
 		return functions->specifyGrain(state, &request, bufferStartPosition);
 	}
 
+	/**
+	 * @brief Specifies a grain of audio, like specifyGrain(), whose pitch ramps from the previous grain's along a curve.
+	 *
+	 * Where output resampling applies, the output's pitch and speed move together, sample by sample, from the
+	 * previous grain's Request::pitch to this grain's. By default they follow a straight line; here they follow the
+	 * parabola through pitchMidpoint instead, so that smooth automation such as a tape stop needs no more grains than
+	 * usual. Curves that would approach zero pitch are straightened.
+	 * @param request The request describing the grain.
+	 * @param bufferStartPosition The start position of the buffer.
+	 * @param pitchMidpoint Pitch midway between the previous grain and this one, or zero for a linear ramp.
+	 * @return The input chunk required for the grain.
+	 */
+	inline InputChunk specifyGrain(const Request &request, double bufferStartPosition, double pitchMidpoint)
+	{
+		return functions->specifyGrainWithPitchMidpoint(state, &request, bufferStartPosition, pitchMidpoint);
+	}
+
 	/**
 	 * @brief Begins processing the grain.
 	 *
@@ -333,6 +688,38 @@ struct Stretcher
 		functions->analyseGrain(state, data, channelStride, muteFrameCountHead, muteFrameCountTail);
 	}
 
+	/**
+	 * @brief Begins processing the grain, like analyseGrain(), with input audio that need not be contiguous in each channel.
+	 *
+	 * Frame n of channel c is read from data[n * frameStride + c * channelStride]. For interleaved audio, pass a
+	 * channelStride of 1 and a frameStride equal to the channel count, avoiding a separate deinterleaving pass.
+	 * @param data Pointer to input audio data.
+	 * @param channelStride Stride between channels in the data buffer.
+	 * @param frameStride Stride between consecutive frames in the data buffer.
+	 * @param muteFrameCountHead Number of unavailable frames at the start (default 0).
+	 * @param muteFrameCountTail Number of unavailable frames at the end (default 0).
+	 */
+	inline void analyseGrainStrided(const float *data, intptr_t channelStride, intptr_t frameStride, int muteFrameCountHead = 0, int muteFrameCountTail = 0)
+	{
+		functions->analyseGrainStrided(state, data, channelStride, frameStride, muteFrameCountHead, muteFrameCountTail);
+	}
+
+	/**
+	 * @brief Begins processing the grain, like analyseGrainStrided(), with input audio samples that are not 32-bit float.
+	 *
+	 * Samples are converted as the analysis window is applied, so there is no need for a separate conversion to float.
+	 * @param data Pointer to input audio data.
+	 * @param sampleFormat Format of the samples at data.
+	 * @param channelStride Stride, in samples, between channels in the data buffer.
+	 * @param frameStride Stride, in samples, between consecutive frames in the data buffer.
+	 * @param muteFrameCountHead Number of unavailable frames at the start (default 0).
+	 * @param muteFrameCountTail Number of unavailable frames at the end (default 0).
+	 */
+	inline void analyseGrainFormatted(const void *data, SampleFormat sampleFormat, intptr_t channelStride, intptr_t frameStride, int muteFrameCountHead = 0, int muteFrameCountTail = 0)
+	{
+		functions->analyseGrainFormatted(state, data, sampleFormat, channelStride, frameStride, muteFrameCountHead, muteFrameCountTail);
+	}
+
 	/**
 	 * @brief Completes processing of the grain of audio previously set up with specifyGrain() and analyseGrain().
 	 *
@@ -343,6 +730,92 @@ struct Stretcher
 		functions->synthesiseGrain(state, &outputChunk);
 	}
 
+	/**
+	 * @brief Completes processing of the grain, like synthesiseGrain(), and also writes the output chunk's audio as
+	 * 16-bit samples with triangular dither.
+	 *
+	 * @param outputChunk The output chunk to fill with synthesised audio.
+	 * @param data Buffer with room for maxOutputFrameCount() frames, to receive outputChunk.frameCount frames.
+	 * @param channelStride Stride, in samples, between channels in the data buffer.
+	 * @param frameStride Stride, in samples, between consecutive frames in the data buffer.
+	 */
+	inline void synthesiseGrain(OutputChunk &outputChunk, int16_t *data, intptr_t channelStride, intptr_t frameStride)
+	{
+		functions->synthesiseGrainInt16(state, &outputChunk, data, channelStride, frameStride);
+	}
+
+	/**
+	 * @brief Analyses and synthesises the current grain of each of several stretchers in a single call.
+	 *
+	 * Equivalent to calling analyseGrain() and then synthesiseGrain() on each stretcher in turn. Processing
+	 * proceeds stage by stage across all the stretchers, and stretchers with equal sample rates and
+	 * granularity share transform kernels and window tables, so these stay in cache. This helps
+	 * applications that run many concurrent streams. Call specifyGrain() on every stretcher first.
+	 * @param count Number of stretchers.
+	 * @param states Array of Stretcher::state pointers of count stretchers of this Edition.
+	 * @param inputs Array of count input audio descriptions, in the same order as states.
+	 * @param outputChunks Array of count output chunks, filled as by synthesiseGrain().
+	 */
+	static inline void processGrains(int count, void *const *states, const GrainInput *inputs, OutputChunk *outputChunks)
+	{
+		Edition::getFunctions()->processGrains(count, states, inputs, outputChunks);
+	}
+
+	/**
+	 * @brief Sets the number of threads that share the per-channel windowing and FFT work of each grain.
+	 *
+	 * The default, 1, does all work on the caller's thread. Larger values start threadCount - 1 worker
+	 * threads that help with each grain, reducing per-grain latency for content with many channels.
+	 * Grain functions neither allocate nor lock when workers are active, but this function does both,
+	 * so call it outside real-time code and never concurrently with the stretcher's other functions.
+	 * @param threadCount Total number of threads, including the caller's, to share each grain's work.
+	 */
+	inline void setThreadCount(int threadCount)
+	{
+		functions->setThreadCount(state, threadCount);
+	}
+
+	/**
+	 * @brief Enables or disables pipelined operation, in which each grain is analysed concurrently with the
+	 * synthesis of the previous grain.
+	 *
+	 * The call sequence of specifyGrain(), analyseGrain() and synthesiseGrain() is unchanged, but the output chunk
+	 * returned by synthesiseGrain() is that of the previous grain: one grain of extra latency. OutputChunk::request
+	 * describes the output as usual. Analysis and synthesis run on separate threads when setThreadCount() has
+	 * provided at least two, approaching twice the throughput of a single stream.
+	 * Call only while the stretcher is flushed, for example before the first grain. Allocates.
+	 * @param enable Set to true to enable pipelining, false to disable.
+	 */
+	inline void enablePipelining(bool enable)
+	{
+		functions->enablePipelining(state, enable);
+	}
+
+	/**
+	 * @brief Enables or disables interleaved output.
+	 *
+	 * When enabled, output chunks are interleaved: OutputChunk::channelStride is 1 and outputFrameStride() is the
+	 * channel count, so that synthesised audio can be passed directly to interleaved sinks.
+	 * @param enable Set to true to enable interleaved output, false for the default, non-interleaved output.
+	 */
+	inline void enableInterleavedOutput(bool enable)
+	{
+		functions->enableInterleavedOutput(state, enable);
+	}
+
+	/**
+	 * @brief Returns the stride between consecutive frames of the output chunks that synthesiseGrain() returns.
+	 *
+	 * Frame n of channel c is at OutputChunk::data[n * outputFrameStride() + c * OutputChunk::channelStride].
+	 * The stride is reported here rather than in OutputChunk so that the layout of OutputChunk, which callers
+	 * allocate, is unchanged from earlier versions of the library.
+	 * @return 1, or the channel count if interleaved output is enabled.
+	 */
+	inline intptr_t outputFrameStride() const
+	{
+		return functions->outputFrameStride(state);
+	}
+
 	/**
 	 * @brief Returns true if every grain in the stretcher's pipeline is invalid (its Request::position was NaN).
 	 * @return True if the stretcher is flushed, false otherwise.
@@ -352,6 +825,252 @@ struct Stretcher
 		return functions->isFlushed(state);
 	}
 
+	/**
+	 * @brief Returns timing statistics of each phase of grain processing since the stretcher was constructed.
+	 *
+	 * Statistics are gathered with little overhead and without locks, so this function may be called from any thread,
+	 * including while another thread processes grains; in that case counts of different phases may be a grain apart.
+	 * @return Histogram of durations of each phase, indexed by StatsPhase.
+	 */
+	inline Stats getStats() const
+	{
+		Stats stats;
+		functions->getStats(state, &stats);
+		return stats;
+	}
+
+	/**
+	 * @brief Selects the FFT implementation used by this stretcher.
+	 *
+	 * Backends differ only in speed and in the least significant bits of their results. With fftBackend_fastest,
+	 * the first stretcher of each transform length times every included backend and later stretchers reuse the
+	 * result. This function allocates and may take some milliseconds, so call it outside real-time code and never
+	 * concurrently with the stretcher's other functions.
+	 * @param backend The FFT implementation to use.
+	 * @return False, leaving the current implementation in use, if the library was built without backend.
+	 */
+	inline bool setFftBackend(FftBackend backend)
+	{
+		return functions->setFftBackend(state, backend);
+	}
+
+	/**
+	 * @brief Selects the FFT implementation of stretchers constructed after this call, in any thread.
+	 *
+	 * The initial default is fftBackend_pffft.
+	 * @param backend The FFT implementation to use.
+	 * @return False, leaving the default unchanged, if the library was built without backend.
+	 */
+	static inline bool setDefaultFftBackend(FftBackend backend)
+	{
+		return Edition::getFunctions()->setDefaultFftBackend(backend);
+	}
+
+	/**
+	 * @brief Returns the FFT implementation that this stretcher uses for its grains.
+	 * @return An included backend, never fftBackend_fastest.
+	 */
+	inline FftBackend fftBackend() const
+	{
+		return functions->fftBackend(state);
+	}
+
+	/**
+	 * @brief Enables or disables real-time mode, in which specifyGrain(), analyseGrain() and synthesiseGrain()
+	 * never allocate, lock or make system calls.
+	 *
+	 * Grain functions never allocate in any mode, but otherwise may write diagnostics directly, locking and making
+	 * system calls, and may sleep on, or wake, worker threads. In real-time mode, diagnostics of
+	 * enableInstrumentation() are instead formatted into a fixed, lock-free ring that a background thread
+	 * writes out (messages are dropped if it fills), and worker threads of setThreadCount() yield rather than sleep
+	 * between grains, so that they never need a system call to wake them. Timing for getStats() reads a clock
+	 * that common platforms map into user space. The vDSP and IPP FFT backends allocate scratch the first time
+	 * each thread transforms, so with those backends let a few grains pass before relying on real-time operation.
+	 * This function allocates and may start a thread, so call it outside real-time code and never concurrently
+	 * with the stretcher's other functions. The benchmark's --real-time option checks these guarantees.
+	 * @param enable Set to true to enable real-time mode, false for the default.
+	 */
+	inline void enableRealTime(bool enable)
+	{
+		functions->enableRealTime(state, enable);
+	}
+
+	/**
+	 * @brief Enables or disables multi-resolution mode, which adapts each grain's transform length to its content.
+	 *
+	 * By default every grain is analysed and synthesised with a transform eight synthesis hops long, for the
+	 * frequency resolution that keeps tones clean. In multi-resolution mode, a grain that follows a rise in spectral
+	 * energy (as measured when transient partials are suppressed) uses a transform of half that length, until
+	 * analysis has moved half a long transform beyond the rise, so that onsets smear less in time; grains in
+	 * stationary sound keep the long transform. Short transforms also cost less. The mode does not change the
+	 * length of input chunks, latency or the output of bypassed, unit-speed grains.
+	 * Allocates when first enabled, so call it outside real-time code, for example before the first grain.
+	 * @param enable Set to true to enable multi-resolution mode, false for the default.
+	 */
+	inline void enableMultiResolution(bool enable)
+	{
+		functions->enableMultiResolution(state, enable);
+	}
+
+	/**
+	 * @brief Computes, ahead of time, the request and input chunk of every grain of a timeline.
+	 *
+	 * Grains start with the preroll() of the first keyframe's request, which is followed by a grain at the first keyframe's
+	 * output frame, and continue while they are within the last keyframe's output frame. Successive grains are as
+	 * many output frames apart as the output chunks between them. Passing requests[i] to specifyGrain() for each
+	 * grain in turn, without calling next(), returns inputChunks[i] offset by the bufferStartPosition argument, so
+	 * that an application can read or map all the input it needs before processing. Further grains with a NaN
+	 * position flush the output of the last grains. This function does not change the stretcher's state, does not
+	 * allocate and may be called from any thread.
+	 * @param keyframes Points on the timeline, in nondecreasing order of Keyframe::outputFrame.
+	 * @param keyframeCount Number of keyframes.
+	 * @param requests Receives the request of each of the first capacity grains.
+	 * @param inputChunks Receives the input chunk of each of the first capacity grains, relative to the start of the input.
+	 * @param capacity Number of elements of requests and inputChunks; zero to count grains only.
+	 * @return Number of grains in the timeline, which may exceed capacity, or zero if the first keyframe has no position.
+	 */
+	inline int schedule(const Keyframe *keyframes, int keyframeCount, Request *requests, InputChunk *inputChunks, int capacity) const
+	{
+		return functions->schedule(state, keyframes, keyframeCount, requests, inputChunks, capacity);
+	}
+
+	/**
+	 * @brief Serialises the stretcher's state, so that another stretcher, perhaps in another process or on another host,
+	 * can continue from it.
+	 *
+	 * Call between grains, that is before specifyGrain() or after synthesiseGrain(). The snapshot is a compact binary
+	 * record of everything that carries from one grain to the next: the recent grains' requests, phases, energies and
+	 * rotations, the overlap-add buffer and its resampling offset, and the state of any pipeline. It does not include the
+	 * application's next Request, which should be stored alongside. This function does not allocate, so may be called
+	 * in real-time mode.
+	 * @param data Receives the snapshot, or may be null to measure it.
+	 * @param capacity Size of data in bytes.
+	 * @return Size of the snapshot in bytes; nothing is written if this exceeds capacity.
+	 */
+	inline intptr_t snapshot(void *data, intptr_t capacity) const
+	{
+		return functions->snapshot(state, data, capacity);
+	}
+
+	/**
+	 * @brief Replaces the stretcher's state with one written by snapshot().
+	 *
+	 * Restore between grains, then continue with the request that followed the snapshot: output continues without a
+	 * reset, as it would have done from the stretcher that took the snapshot. The snapshot must come from a stretcher of
+	 * the same edition, sample rates, channel count and granularity, with the same pipelining and multi-resolution
+	 * settings, on a host of the same byte order. Snapshots are checked before any state changes: one that is truncated,
+	 * that comes from a stretcher of another configuration, or that holds a count, index, position or energy out of
+	 * range is rejected. Checks cannot detect every corruption, so snapshots should be restored as they were written.
+	 * @param data A snapshot.
+	 * @param size Size of the snapshot in bytes.
+	 * @return True if the state was restored, or false, leaving the stretcher unchanged, if the snapshot does not match.
+	 */
+	inline bool restore(const void *data, intptr_t size)
+	{
+		return functions->restore(state, data, size);
+	}
+
+	/**
+	 * @brief Enables or disables low-latency mode, for live monitoring and other uses that need output promptly.
+	 *
+	 * By default each grain is analysed with a transform eight synthesis hops long, so its input chunk spans four hops
+	 * either side of its position. In low-latency mode every grain uses a transform of half that length, four hops per
+	 * transform, and input chunks are half as long, which reduces latency() from six synthesis hops to four at unit speed
+	 * and pitch. Frequency resolution is halved, so tones are less clean. Combine with a granularity of -1 (see the
+	 * constructor) for lower latency still. Allocates when first enabled, so call it outside real-time code.
+	 * @param enable Set to true to enable low-latency mode, false for the default.
+	 */
+	inline void enableLowLatency(bool enable)
+	{
+		functions->enableLowLatency(state, enable);
+	}
+
+	/**
+	 * @brief Returns the stretcher's algorithmic latency for grains like request.
+	 *
+	 * This is the difference of input position between the end of a grain's input chunk, which is the most recent input
+	 * that must be available to specify the grain, and the position of the first frame of the output chunk that
+	 * synthesiseGrain() then returns. It depends on request's speed, pitch and resample mode, and on low-latency and
+	 * pipelined operation; it is exact up to the rounding of grain positions to whole frames. Divide by the input sample
+	 * rate for the delay, at unit speed, that a live application should compensate. It does not include any buffering
+	 * by the application or by Stream. This function does not allocate and takes constant time.
+	 * @param request Speed, pitch and modes of the grains; position is ignored.
+	 * @return Latency in input frames.
+	 */
+	inline double latency(const Request &request) const
+	{
+		return functions->latency(state, &request);
+	}
+
+	/**
+	 * @brief Enables or disables formant preservation, so that pitch shifts change the pitch of voices and instruments
+	 * without changing their timbre.
+	 *
+	 * Pitch shifting scales all frequencies, including those of the resonances (formants) that shape a voice's
+	 * spectral envelope, which makes voices sound unnaturally small or large. With formant preservation, each grain
+	 * whose Request::pitch is not 1 is multiplied, bin by bin, by the gain that moves its envelope back to where it
+	 * was. The envelope is estimated from the energy spectrum that analysis already computes, and the gain is applied
+	 * in the same multiply that rotates the grain's bins, so it costs no extra transforms.
+	 * Grains of unit pitch are unchanged. This function does not allocate and takes effect from the next grain.
+	 * @param enable Set to true to preserve formants, false for the default.
+	 */
+	inline void enableFormantPreservation(bool enable)
+	{
+		functions->enableFormantPreservation(state, enable);
+	}
+
+	/**
+	 * @brief Enables or disables partial tracking, which finds each grain's partials from the previous grain's rather
+	 * than from every bin of its spectrum.
+	 *
+	 * Analysis divides each grain's spectrum into partials, each a peak and the bins around it. With partial tracking,
+	 * while the spectrum is sparse and changes little each of the previous grain's peaks climbs to the nearest peak of
+	 * the new spectrum, at a cost that scales with the number of partials rather than with the transform length.
+	 * Peaks more than 60 dB below the strongest are taken as noise floor: they are not tracked, and do not count
+	 * towards the density of the spectrum, so material whose noise lies within 60 dB of its partials is not tracked.
+	 * Tracking falls back to the full search of every bin after a change of transform length, when the spectrum is
+	 * dense or its total energy changes by more than a factor of two, and when two peaks merge or energy grows in the
+	 * valley between them, as where a new partial appears, so it suits sustained, tonal music.
+	 * This function does not allocate and takes effect from the next grain.
+	 * @param enable Set to true to track partials, false for the default.
+	 */
+	inline void enablePartialTracking(bool enable)
+	{
+		functions->enablePartialTracking(state, enable);
+	}
+
+	/**
+	 * @brief Sets the interpolation filter used where grains are resampled, on input or output.
+	 *
+	 * Bilinear interpolation, the default, is fastest. Polyphase windowed-sinc interpolation costs more per resampled
+	 * frame but keeps aliasing and high-frequency loss far below audibility, which matters most for large pitch shifts
+	 * and for sample rate conversion. This function does not allocate and takes effect from the next grain.
+	 * @param interpolationMode The interpolation filter.
+	 */
+	inline void setInterpolationMode(InterpolationMode interpolationMode)
+	{
+		functions->setInterpolationMode(state, interpolationMode);
+	}
+
+	/**
+	 * @brief Divides the channels into consecutive groups that are stretched independently.
+	 *
+	 * By default all channels form one group: their spectra are summed to find one set of phase, energy and partials,
+	 * and every channel is rotated alike, which keeps the channels of a stereo or surround mix phase-coherent. Unrelated
+	 * signals, such as the stems of a session, are better stretched with a group each, as if by separate stretchers:
+	 * each group then has its own phase, partials and rotation, while windows, transforms, resampling and buffers are
+	 * still shared, so that one stretcher and one call sequence serve them all. For example, channel counts {2, 2, 1}
+	 * make channels 0-1, 2-3 and 4 three groups.
+	 * Call only while the stretcher is flushed, for example before the first grain. This function does not allocate.
+	 * @param channelCounts The number of channels in each group, each at least 1 and together the stretcher's channel count.
+	 * @param groupCount The number of groups, or zero for the default, one group of all channels.
+	 * @return True if the groups were set, false, changing nothing, if the counts are invalid or the stretcher is not flushed.
+	 */
+	inline bool setChannelGroups(const int *channelCounts, int groupCount)
+	{
+		return functions->setChannelGroups(state, channelCounts, groupCount);
+	}
+
 	/**
 	 * @brief Pointer to the function table for the stretcher implementation.
 	 */
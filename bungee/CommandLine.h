@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: MPL-2.0
 
 #include <bungee/Bungee.h>
+#include <bungee/Pull.h>
+#include <bungee/Stream.h>
 
 #define CXXOPTS_NO_EXCEPTIONS
 #include "cxxopts.hpp"
@@ -9,16 +11,33 @@
 
 #include <bit>
 #include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <span>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
+#ifdef _WIN32
+#	include <fcntl.h>
+#	include <io.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
 namespace Bungee::CommandLine {
 
 static void fail(const char *message)
@@ -27,6 +46,59 @@ static void fail(const char *message)
 	exit(1);
 }
 
+// Read-only view of a whole file: memory-mapped where supported, otherwise read into memory
+struct MappedFile
+{
+	const char *data = nullptr;
+	size_t size = 0;
+
+	MappedFile(const std::string &filename)
+	{
+#ifdef _WIN32
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file)
+			fail("Please check your input file: could not open it");
+		buffer.resize(file.tellg());
+		file.seekg(0);
+		if (!file.read(buffer.data(), buffer.size()))
+			fail("Please check your input file: there was a problem reading it");
+		data = buffer.data();
+		size = buffer.size();
+#else
+		const int fd = open(filename.c_str(), O_RDONLY);
+		struct stat status;
+		if (fd < 0 || fstat(fd, &status) != 0)
+			fail("Please check your input file: could not open it");
+		size = status.st_size;
+		if (size)
+		{
+			void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (address == MAP_FAILED)
+				fail("Please check your input file: could not map it into memory");
+			madvise(address, size, MADV_SEQUENTIAL);
+			data = static_cast<const char *>(address);
+		}
+		close(fd);
+#endif
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	~MappedFile()
+	{
+#ifndef _WIN32
+		if (data)
+			munmap(const_cast<char *>(data), size);
+#endif
+	}
+
+#ifdef _WIN32
+private:
+	std::vector<char> buffer;
+#endif
+};
+
 struct Options :
 	cxxopts::Options
 {
@@ -36,17 +108,27 @@ struct Options :
 		cxxopts::Options(program_name, help_string)
 	{
 		add_options() //
-			("input", "input WAV filename", cxxopts::value<std::string>()) //
-			("output", "output WAV filename", cxxopts::value<std::string>()) //
+			("input", "input WAV filename, or - for standard input", cxxopts::value<std::string>()) //
+			("output", "output WAV filename, or - for standard output", cxxopts::value<std::string>()) //
 			("start", "start time in seconds", cxxopts::value<double>()->default_value("+0")) //
 			("stop", "stop time in seconds", cxxopts::value<double>()->default_value("-0")) //
 			;
 		add_options(helpGroups.emplace_back("Sample rate")) //
 			("output-rate", "output sample rate, Hz, or 0 to match input sample rate", cxxopts::value<int>()->default_value("0")) //
 			;
+		add_options(helpGroups.emplace_back("Pipe")) //
+			("raw", "read and write headerless PCM [s16le|s32le|f32le] rather than WAV", cxxopts::value<std::string>()) //
+			("input-rate", "sample rate, Hz, of raw input", cxxopts::value<int>()->default_value("0")) //
+			("channels", "channel count of raw input", cxxopts::value<int>()->default_value("0")) //
+			;
 		add_options(helpGroups.emplace_back("Stretch")) //
 			("s,speed", "output speed as multiple of input speed", cxxopts::value<double>()->default_value("1")) //
 			("p,pitch", "output pitch shift in semitones", cxxopts::value<double>()->default_value("0")) //
+			("multi-resolution", "shorten transforms at transients, for less smearing of onsets") //
+			("low-latency", "shorten every transform, for less latency at the cost of frequency resolution") //
+			("preserve-formants", "keep the spectral envelope when shifting pitch, so voices keep their timbre") //
+			("track-partials", "find each grain's partials from the previous grain's while the spectrum changes little") //
+			("channel-groups", "stretch groups of channels independently, for example 2,2,1 for two stereo stems and a mono stem", cxxopts::value<std::string>()) //
 			;
 		auto optionAdder = add_options(helpGroups.emplace_back("Processing"));
 
@@ -59,7 +141,7 @@ struct Options :
 #define X_ITEM(Type, type, mode, description) \
 		names += a + #mode; \
 		a = "|"; \
-		if (Request{}.type##Mode == type##Mode_##mode) \
+		if (type##Mode_##mode == 0) \
 			d = #mode;
 
 		BUNGEE_MODES
@@ -69,9 +151,18 @@ struct Options :
 #undef X_ITEM
 			//
 			;
+		std::string fftBackends = "FFT implementation [";
+#define X_FFT(backend, description) fftBackends += #backend "|";
+		BUNGEE_FFT_BACKENDS
+#undef X_FFT
+		fftBackends += "fastest]";
+
 		add_options(helpGroups.emplace_back("Developer")) //
+			("fft", fftBackends, cxxopts::value<std::string>()->default_value("pffft")) //
 			("grain", "increases [+1] or decreases [-1] grain duration by a factor of two", cxxopts::value<int>()->default_value("0")) //
 			("push", "input chunk size (0 for pull operation, negative for random push chunk size)", cxxopts::value<int>()->default_value("0")) //
+			("threads", "render segments of the file concurrently on this many threads (positive speed only)", cxxopts::value<int>()->default_value("1")) //
+			("stream", "read input audio lazily from a memory-mapped file (pull operation only)") //
 			("instrumentation", "report useful diagnostic information to system log") //
 			;
 		add_options(helpGroups.emplace_back("Help")) //
@@ -86,6 +177,20 @@ struct Options :
 struct Parameters :
 	cxxopts::ParseResult
 {
+	FftBackend fftBackend = fftBackend_pffft;
+
+	// Passed to Stretcher::setInterpolationMode() by --interpolation
+	InterpolationMode interpolationMode = interpolationMode_bilinear;
+
+	// Channel count of each group given by --channel-groups, empty for one group of all channels
+	std::vector<int> channelGroups;
+
+	// True when audio streams from standard input or in raw form, through Pipe rather than Processor
+	bool piped() const
+	{
+		return count("raw") || (*this)["input"].as<std::string>() == "-";
+	}
+
 	Parameters(Options &options, int argc, const char *argv[], Request &request) :
 		cxxopts::ParseResult(options.parse(argc, argv))
 	{
@@ -119,6 +224,56 @@ struct Parameters :
 		if ((*this)["push"].as<int>() && request.speed < 0.)
 			fail("speed not greater than zero in 'push' mode");
 
+		const auto threads = (*this)["threads"].as<int>();
+		if (threads < 1 || threads > 256)
+			fail("threads is outside of the range 1 to 256");
+
+		if (threads > 1 && !(request.speed > 0.))
+			fail("speed not greater than zero with multiple threads");
+
+		if (threads > 1 && (*this)["push"].as<int>())
+			fail("multiple threads cannot be used in 'push' mode");
+
+		if (count("stream") && (threads > 1 || (*this)["push"].as<int>()))
+			fail("'stream' cannot be used with 'push' or multiple threads");
+
+		if (piped())
+		{
+			if (!(request.speed > 0.))
+				fail("speed not greater than zero when piping");
+			if (threads > 1 || count("stream"))
+				fail("'stream' and multiple threads cannot be used when piping");
+			if (!(*this)["start"].has_default() || !(*this)["stop"].has_default())
+				fail("start and stop times cannot be used when piping");
+			if ((*this)["push"].as<int>() < 0)
+				fail("random 'push' chunk sizes cannot be used when piping");
+		}
+
+		{
+			const auto s = (*this)["fft"].as<std::string>();
+			if (s == "fastest")
+				fftBackend = fftBackend_fastest;
+#define X_FFT(backend, description) \
+			else if (s == #backend) \
+				fftBackend = fftBackend_##backend;
+			BUNGEE_FFT_BACKENDS
+#undef X_FFT
+			else
+				fail("Unrecognised value for --fft");
+		}
+
+		if (count("channel-groups"))
+		{
+			std::istringstream s((*this)["channel-groups"].as<std::string>());
+			for (std::string item; std::getline(s, item, ',');)
+			{
+				const int channelCount = std::atoi(item.c_str());
+				if (channelCount < 1)
+					fail("Unrecognised value for --channel-groups");
+				channelGroups.push_back(channelCount);
+			}
+		}
+
 #define X_BEGIN(Type, type) \
 		{ \
 			const auto s = (*this)[#type].as<std::string>(); \
@@ -126,20 +281,29 @@ struct Parameters :
 			{ \
 			}
 
+#define X_END(Type, type) \
+			else \
+			{ \
+				Bungee::CommandLine::fail("Unrecognised value for --" #type); \
+			} \
+		}
+
 #define X_ITEM(Type, type, mode, description) \
 			else if (s == #mode) \
 			{ \
 				request.type##Mode = type##Mode_##mode; \
 			}
 
-#define X_END(Type, type) \
-			else \
+		BUNGEE_MODES_RESAMPLE
+
+#undef X_ITEM
+#define X_ITEM(Type, type, mode, description) \
+			else if (s == #mode) \
 			{ \
-				Bungee::CommandLine::fail("Unrecognised value for --" #type); \
-			} \
-		}
+				type##Mode = type##Mode_##mode; \
+			}
 
-		BUNGEE_MODES
+		BUNGEE_MODES_INTERPOLATION
 
 #undef X_BEGIN
 #undef X_ITEM
@@ -187,16 +351,29 @@ struct Processor
 
 	std::vector<char> wavHeader;
 	std::vector<char> wavData;
-	decltype(wavData.begin()) o;
 	SampleRates sampleRates;
 	int inputFrameCount;
 	int inputChannelStride;
+	int outputFrameCount;
 	int sampleFormat;
 	int channelCount;
 	int bitsPerSample;
-	std::vector<float> inputBuffer;
 	std::ifstream inputFile;
+
+	// Whole input as planar float audio, unless streaming from a memory-mapped input file
+	std::vector<float> inputBuffer;
+
+	// When streaming, PCM samples are converted from the mapped file into inputCache as grains first need them
+	std::unique_ptr<MappedFile> mappedFile;
+	const char *inputSamples = nullptr;
+	float (*readInputSample)(const char *) = nullptr;
+	std::unique_ptr<Pull::InputCache> inputCache;
+
+	// Output samples are written as each chunk completes, after a header written at construction
 	std::ofstream outputFile;
+	std::ostream *output;
+	size_t outputBytesRemaining;
+	std::vector<char> outputSamples;
 
 	Processor(const cxxopts::ParseResult &parameters, Request &request) :
 		inputFile(parameters["input"].as<std::string>(), std::ios::binary)
@@ -204,6 +381,9 @@ struct Processor
 		if (!inputFile)
 			fail("Please check your input file: could not open it");
 
+		if (parameters.count("stream"))
+			mappedFile = std::make_unique<MappedFile>(parameters["input"].as<std::string>());
+
 		wavHeader.resize(20);
 		inputFile.read(wavHeader.data(), wavHeader.size());
 
@@ -264,35 +444,45 @@ struct Processor
 				fail("Please check your input file: its sample format is not supported");
 		}
 
-		std::fill(wavData.begin(), wavData.end(), 0);
-
-		outputFile.open(parameters["output"].as<std::string>(), std::ios::binary);
-		if (!outputFile)
-			fail("Please check your output path: there was a problem opening the output file");
+		const auto outputFilename = parameters["output"].as<std::string>();
+		if (outputFilename == "-")
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			output = &std::cout;
+		}
+		else
+		{
+			outputFile.open(outputFilename, std::ios::binary);
+			if (!outputFile)
+				fail("Please check your output path: there was a problem opening the output file");
+			output = &outputFile;
+		}
 
 		{
 			constexpr size_t maximumOutputDataBytes = 1ll << 30; // 1G
 			const size_t bytesPerFrame = channelCount * bitsPerSample / 8;
 			const size_t maximumOutputFrameCount = maximumOutputDataBytes / bytesPerFrame;
 
-			size_t outputFrameCount = std::floor(inputFrameCount / std::fabs(request.speed) * sampleRates.output / sampleRates.input);
-			if (outputFrameCount > maximumOutputFrameCount)
+			size_t frameCount = std::floor(inputFrameCount / std::fabs(request.speed) * sampleRates.output / sampleRates.input);
+			if (frameCount > maximumOutputFrameCount)
 			{
-				outputFrameCount = maximumOutputFrameCount;
+				frameCount = maximumOutputFrameCount;
 				std::cerr << "Warning: output audio will be truncated to 1GB\n";
 			}
 
-			const size_t wavDataBytes = outputFrameCount * bytesPerFrame;
-			wavData.resize(wavDataBytes);
+			outputFrameCount = int(frameCount);
+			outputBytesRemaining = frameCount * bytesPerFrame;
 		}
 
+		writeOutputHeader();
+
 		restart(request);
 	}
 
 	void restart(Request &request)
 	{
-		o = wavData.begin();
-
 		if (request.speed < 0)
 			request.position = inputFrameCount - 1;
 		else
@@ -322,36 +512,59 @@ struct Processor
 		return false;
 	}
 
-	const float *getInputAudio(InputChunk inputChunk) const
+	// Returns audio for inputChunk with channel stride inputChannelStride, which changes once streaming begins
+	const float *getInputAudio(InputChunk inputChunk, int maxInputFrameCount)
 	{
-		return inputBuffer.data() + inputChunk.begin;
+		if (!mappedFile)
+			return inputBuffer.data() + inputChunk.begin;
+
+		if (!inputCache)
+			inputCache = std::make_unique<Pull::InputCache>(maxInputFrameCount, channelCount);
+
+		inputCache->grain(inputChunk, [&](float *p, int stride, int position, int length) {
+			getInputAudio(p, stride, position, length);
+		});
+		inputChannelStride = inputCache->stride();
+		return inputCache->outputData();
 	}
 
 	void getInputAudio(float *p, int stride, int position, int length) const
 	{
-		for (int c = 0; c < channelCount; ++c)
-			for (int i = 0; i < length; ++i)
+		for (int i = 0; i < length; ++i)
+			for (int c = 0; c < channelCount; ++c)
 			{
 				if (position + i >= 0 && position + i < inputFrameCount)
-					p[c * stride + i] = inputBuffer[c * inputChannelStride + position + i];
+					p[c * stride + i] = inputSample(position + i, c);
 				else
 					p[c * stride + i] = 0.f;
 			}
 	}
 
+	float inputSample(int frame, int channel) const
+	{
+		if (mappedFile)
+			return readInputSample(inputSamples + (size_t(frame) * channelCount + channel) * (bitsPerSample / 8));
+		return inputBuffer[channel * inputChannelStride + frame];
+	}
+
 	template <typename Sample>
 	bool writeSamples(Bungee::OutputChunk chunk)
 	{
-		const int count = std::min<int>(chunk.frameCount * channelCount, int((wavData.end() - o) / sizeof(Sample)));
+		const int count = (int)std::min<size_t>(size_t(chunk.frameCount) * channelCount, outputBytesRemaining / sizeof(Sample));
 
+		outputSamples.resize(count / channelCount * channelCount * sizeof(Sample));
+		auto o = outputSamples.data();
 		for (int f = 0; f < count / channelCount; ++f)
 			for (int c = 0; c < channelCount; ++c)
 			{
-				write<Sample>(&*o, fromFloat<Sample>(chunk.data[f + c * chunk.channelStride]));
+				write<Sample>(o, fromFloat<Sample>(chunk.data[f + c * chunk.channelStride]));
 				o += sizeof(Sample);
 			}
 
-		return o == wavData.end();
+		output->write(outputSamples.data(), outputSamples.size());
+		outputBytesRemaining -= outputSamples.size();
+
+		return !outputBytesRemaining;
 	}
 
 	bool writeChunk(Bungee::OutputChunk chunk)
@@ -364,25 +577,47 @@ struct Processor
 			return writeSamples<int16_t>(chunk);
 	}
 
-	void writeOutputFile()
+	// Output sizes are known in advance, so the header is complete before any samples are written
+	void writeOutputHeader()
 	{
-		write<uint32_t>(&wavHeader[4], uint32_t(wavHeader.size() + wavData.size() - 8));
+		const size_t dataBytes = size_t(outputFrameCount) * channelCount * bitsPerSample / 8;
+
+		write<uint32_t>(&wavHeader[4], uint32_t(wavHeader.size() + dataBytes - 8));
 		write<uint32_t>(&wavHeader[24], uint32_t(sampleRates.output));
 		write<uint32_t>(&wavHeader[28], uint32_t(sampleRates.output * channelCount * bitsPerSample / 8));
-		write<uint32_t>(&wavHeader[wavHeader.size() - 4], uint32_t(wavData.size()));
+		write<uint32_t>(&wavHeader[wavHeader.size() - 4], uint32_t(dataBytes));
+
+		output->write(wavHeader.data(), wavHeader.size());
+	}
+
+	// Pads any output not yet written with silence and flushes
+	void writeOutputFile()
+	{
+		outputSamples.assign(outputBytesRemaining, 0);
+		output->write(outputSamples.data(), outputSamples.size());
+		outputBytesRemaining = 0;
 
-		outputFile.write(wavHeader.data(), wavHeader.size());
-		outputFile.write(wavData.data(), wavData.size());
+		if (!output->flush())
+			fail("Please check your output path: there was a problem writing the output file");
 	}
 
 	template <typename Sample>
 	void readInputAudio(double frameStart, double frameStop)
 	{
-		wavData.resize(read<uint32_t>(&wavHeader[wavHeader.size() - 4]));
-		if (!inputFile.read(wavData.data(), wavData.size()))
-			fail("Please check your input file: there was a problem reading its audio data");
+		const size_t dataBytes = read<uint32_t>(&wavHeader[wavHeader.size() - 4]);
+		if (mappedFile)
+		{
+			if (mappedFile->size < wavHeader.size() + dataBytes)
+				fail("Please check your input file: there was a problem reading its audio data");
+		}
+		else
+		{
+			wavData.resize(dataBytes);
+			if (!inputFile.read(wavData.data(), wavData.size()))
+				fail("Please check your input file: there was a problem reading its audio data");
+		}
 
-		inputFrameCount = int(8 * wavData.size() / bitsPerSample / channelCount);
+		inputFrameCount = int(8 * dataBytes / bitsPerSample / channelCount);
 
 		if (std::signbit(frameStart))
 			frameStart += inputFrameCount;
@@ -393,11 +628,21 @@ struct Processor
 			fail("Please check your start/stop times: they are outside the range of the input audio");
 
 		inputChannelStride = inputFrameCount = int(frameStop - frameStart);
+
+		if (mappedFile)
+		{
+			inputSamples = mappedFile->data + wavHeader.size() + size_t(frameStart) * channelCount * sizeof(Sample);
+			readInputSample = [](const char *data) { return toFloat(read<Sample>(data)); };
+			return;
+		}
+
 		inputBuffer.resize(channelCount * inputChannelStride);
 
 		for (int i = 0; i < inputFrameCount; ++i)
 			for (int c = 0; c < channelCount; ++c)
 				inputBuffer[c * inputChannelStride + i] = toFloat(read<Sample>(&wavData[((i + frameStart) * channelCount + c) * sizeof(Sample)]));
+
+		wavData = {};
 	}
 
 	template <typename Type>
@@ -448,4 +693,386 @@ struct Processor
 	}
 };
 
+
+// Streams audio from standard input or a file to standard output or a file with memory bounded however long the
+// audio: a reader thread decodes blocks of input, the calling thread stretches them with Bungee::Stream, and a
+// writer thread encodes and writes the output, so that I/O overlaps with stretching. Audio is WAV, whose header is
+// read from the stream and whose data may be of unknown length, or raw interleaved PCM given by --raw.
+struct Pipe
+{
+	SampleRates sampleRates;
+	int channelCount;
+	int sampleFormat;
+	int bitsPerSample;
+	bool raw;
+
+	// Frames of each input block
+	const int blockFrameCount;
+
+	Pipe(const cxxopts::ParseResult &parameters) :
+		raw(parameters.count("raw")),
+		blockFrameCount(parameters["push"].as<int>() > 0 ? parameters["push"].as<int>() : 4096)
+	{
+		const auto inputFilename = parameters["input"].as<std::string>();
+		input = open(inputFilename, stdin, "rb");
+		if (!input)
+			fail("Please check your input file: could not open it");
+
+		const auto outputFilename = parameters["output"].as<std::string>();
+		output = open(outputFilename, stdout, "wb");
+		if (!output)
+			fail("Please check your output path: there was a problem opening the output file");
+
+		if (raw)
+		{
+			const auto format = parameters["raw"].as<std::string>();
+			if (format == "s16le")
+				sampleFormat = 1, bitsPerSample = 16;
+			else if (format == "s32le")
+				sampleFormat = 1, bitsPerSample = 32;
+			else if (format == "f32le")
+				sampleFormat = 3, bitsPerSample = 32;
+			else
+				fail("Unrecognised value for --raw");
+
+			sampleRates.input = parameters["input-rate"].as<int>();
+			channelCount = parameters["channels"].as<int>();
+			if (channelCount < 1)
+				fail("raw input needs a positive --channels");
+		}
+		else
+			readHeader();
+
+		if (sampleRates.input < 8000 || sampleRates.input > 192000)
+			fail("Input sample rate must be in the range [8000, 192000] Hz");
+
+		sampleRates.output = parameters["output-rate"].has_default() ? sampleRates.input : parameters["output-rate"].as<int>();
+		if (sampleRates.output < 8000 || sampleRates.output > 192000)
+			fail("Output sample rate must be in the range [8000, 192000] kHz");
+
+		if (!(sampleFormat == 1 && (bitsPerSample == 16 || bitsPerSample == 32)) && !(sampleFormat == 3 && bitsPerSample == 32))
+			fail("Please check your input file: its sample format is not supported");
+
+		// Generous stdio buffers, so that reads and writes are few and large
+		std::setvbuf(input, nullptr, _IOFBF, 1 << 20);
+		std::setvbuf(output, nullptr, _IOFBF, 1 << 20);
+	}
+
+	Pipe(const Pipe &) = delete;
+	Pipe &operator=(const Pipe &) = delete;
+
+	~Pipe()
+	{
+		if (input != stdin)
+			std::fclose(input);
+		if (output != stdout)
+			std::fclose(output);
+	}
+
+	// Stretches all of the input at the request's speed and pitch, returning once all output is written
+	template <class Edition>
+	void run(Stretcher<Edition> &stretcher, const Request &request)
+	{
+		const double outputFramesPerInputFrame = sampleRates.output / (request.speed * sampleRates.input);
+		const int maxOutputFrameCount = (int)std::ceil(blockFrameCount * outputFramesPerInputFrame) + 1;
+
+		// Enough blocks that each thread can work on one while another waits in each queue
+		std::vector<Block> inputBlocks(3), outputBlocks(3);
+		for (auto &block : inputBlocks)
+			freeBlocks[0].push(&block.allocate(blockFrameCount, channelCount));
+		for (auto &block : outputBlocks)
+			freeBlocks[1].push(&block.allocate(maxOutputFrameCount, channelCount));
+
+		if (!raw)
+			writeHeader(0xffffffff);
+
+		std::thread reader([this]() { read(); });
+		std::thread writer([this]() { write(); });
+
+		Stream stream(stretcher, blockFrameCount, channelCount);
+
+		std::vector<const float *> inputPointers(channelCount);
+		std::vector<float *> outputPointers(channelCount);
+
+		int64_t inputFrameCount = 0;
+		int64_t outputFrameCount = -1; // known once all input has been read
+		int64_t written = 0;
+
+		for (bool done = false; !done;)
+		{
+			Block *inputBlock = nullptr;
+			int frameCount = blockFrameCount;
+			if (outputFrameCount < 0)
+			{
+				inputBlock = filledBlocks[0].pop();
+				frameCount = inputBlock->frameCount;
+				inputFrameCount += frameCount;
+				if (inputBlock->last)
+					outputFrameCount = (int64_t)std::floor(inputFrameCount * outputFramesPerInputFrame);
+				for (int c = 0; c < channelCount; ++c)
+					inputPointers[c] = inputBlock->channel(c);
+			}
+
+			Block *outputBlock = freeBlocks[1].pop();
+			outputBlock->offset = outputBlock->frameCount = 0;
+
+			if (frameCount)
+			{
+				for (int c = 0; c < channelCount; ++c)
+					outputPointers[c] = outputBlock->channel(c);
+
+				// Input beyond the end is silent, while the stretcher flushes
+				const int n = stream.process(inputBlock ? inputPointers.data() : nullptr, outputPointers.data(), frameCount, frameCount * outputFramesPerInputFrame, request.pitch);
+
+				if (n)
+				{
+					// Discard output from before input position zero, as Processor::write() does
+					const auto positionEnd = stream.outputPosition();
+					const auto positionBegin = positionEnd - n / outputFramesPerInputFrame;
+					const auto prerollInput = std::max(0., std::round(-positionBegin));
+					const int preroll = std::min(n, (int)std::round(prerollInput * (n / (positionEnd - positionBegin))));
+
+					outputBlock->offset = preroll;
+					outputBlock->frameCount = n - preroll;
+				}
+			}
+
+			if (inputBlock)
+				freeBlocks[0].push(inputBlock);
+
+			if (outputFrameCount >= 0 && written + outputBlock->frameCount >= outputFrameCount)
+			{
+				outputBlock->frameCount = int(outputFrameCount - written);
+				done = true;
+			}
+			written += outputBlock->frameCount;
+			outputBlock->last = done;
+			filledBlocks[1].push(outputBlock);
+		}
+
+		reader.join();
+		writer.join();
+
+		// Complete the WAV header, where the output can seek back to it
+		if (!raw && std::fflush(output) == 0 && std::fseek(output, 0, SEEK_SET) == 0)
+			writeHeader(uint32_t(std::min<int64_t>(written * channelCount * (bitsPerSample / 8), 0xffffffff)));
+
+		if (std::fflush(output) != 0)
+			fail("Please check your output path: there was a problem writing the output file");
+	}
+
+private:
+	// Planar audio passed between threads
+	struct Block
+	{
+		std::vector<float> audio;
+		int channelStride{};
+		int offset{};
+		int frameCount{};
+		bool last{};
+
+		Block &allocate(int frameCount, int channelCount)
+		{
+			audio.resize(size_t(frameCount) * channelCount);
+			channelStride = frameCount;
+			return *this;
+		}
+
+		float *channel(int c)
+		{
+			return audio.data() + offset + size_t(c) * channelStride;
+		}
+	};
+
+	// Blocks waiting for a thread
+	struct Queue
+	{
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Block *> blocks;
+
+		void push(Block *block)
+		{
+			{
+				const std::lock_guard lock(mutex);
+				blocks.push_back(block);
+			}
+			condition.notify_one();
+		}
+
+		Block *pop()
+		{
+			std::unique_lock lock(mutex);
+			condition.wait(lock, [this]() { return !blocks.empty(); });
+			const auto block = blocks.front();
+			blocks.pop_front();
+			return block;
+		}
+	};
+
+	std::FILE *input;
+	std::FILE *output;
+
+	// Bytes of WAV data not yet read, or effectively unlimited where the header does not give a length
+	uint64_t inputBytesRemaining = UINT64_MAX;
+
+	// Of input blocks and of output blocks
+	Queue freeBlocks[2];
+	Queue filledBlocks[2];
+
+	static std::FILE *open(const std::string &filename, std::FILE *standard, const char *mode)
+	{
+		if (filename != "-")
+			return std::fopen(filename.c_str(), mode);
+#ifdef _WIN32
+		_setmode(_fileno(standard), _O_BINARY);
+#endif
+		return standard;
+	}
+
+	void readExactly(char *data, size_t size)
+	{
+		if (std::fread(data, 1, size, input) != size)
+			fail("Please check your input file: it seems not to be a compatible WAV file (truncated header)");
+	}
+
+	void readHeader()
+	{
+		char riff[12];
+		readExactly(riff, sizeof(riff));
+		if (Processor::read<uint32_t>(&riff[0]) != Processor::read<uint32_t>("RIFF") || Processor::read<uint32_t>(&riff[8]) != Processor::read<uint32_t>("WAVE"))
+			fail("Please check your input file: it seems not to be a compatible WAV file (no 'RIFF' or 'WAVE')");
+
+		bool format = false;
+		for (;;)
+		{
+			char header[8];
+			readExactly(header, sizeof(header));
+			const auto length = Processor::read<uint32_t>(&header[4]);
+
+			if (Processor::read<uint32_t>(&header[0]) == Processor::read<uint32_t>("data"))
+			{
+				if (!format)
+					fail("Please check your input file: it seems not to be a compatible WAV file (no 'fmt ' before 'data')");
+
+				// Streaming writers leave the length zero or at its maximum when they cannot know it in advance
+				if (length && length != 0xffffffff)
+					inputBytesRemaining = length;
+				return;
+			}
+
+			std::vector<char> chunk(length + (length & 1));
+			readExactly(chunk.data(), chunk.size());
+
+			if (Processor::read<uint32_t>(&header[0]) == Processor::read<uint32_t>("fmt "))
+			{
+				if (length < 16)
+					fail("Please check your input file: it seems not to be a compatible WAV file (format length less than 16)");
+				sampleFormat = Processor::read<uint16_t>(&chunk[0]);
+				channelCount = Processor::read<uint16_t>(&chunk[2]);
+				sampleRates.input = Processor::read<uint32_t>(&chunk[4]);
+				bitsPerSample = Processor::read<uint16_t>(&chunk[14]);
+
+				// WAVE_FORMAT_EXTENSIBLE, as written for example by FFmpeg for more than two channels
+				if (sampleFormat == 0xfffe && length >= 40)
+					sampleFormat = Processor::read<uint16_t>(&chunk[24]);
+
+				if (!channelCount)
+					fail("Please check your input file: it seems not to be a compatible WAV file (zero channels)");
+				format = true;
+			}
+		}
+	}
+
+	void writeHeader(uint32_t dataBytes)
+	{
+		char header[44];
+		std::memcpy(&header[0], "RIFF", 4);
+		Processor::write<uint32_t>(&header[4], dataBytes == 0xffffffff ? dataBytes : dataBytes + 36);
+		std::memcpy(&header[8], "WAVEfmt ", 8);
+		Processor::write<uint32_t>(&header[16], 16);
+		Processor::write<uint16_t>(&header[20], uint16_t(sampleFormat));
+		Processor::write<uint16_t>(&header[22], uint16_t(channelCount));
+		Processor::write<uint32_t>(&header[24], uint32_t(sampleRates.output));
+		Processor::write<uint32_t>(&header[28], uint32_t(sampleRates.output * channelCount * bitsPerSample / 8));
+		Processor::write<uint16_t>(&header[32], uint16_t(channelCount * bitsPerSample / 8));
+		Processor::write<uint16_t>(&header[34], uint16_t(bitsPerSample));
+		std::memcpy(&header[36], "data", 4);
+		Processor::write<uint32_t>(&header[40], dataBytes);
+		if (std::fwrite(header, 1, sizeof(header), output) != sizeof(header))
+			fail("Please check your output path: there was a problem writing the output file");
+	}
+
+	template <typename Sample>
+	void decode(Block &block, const char *bytes)
+	{
+		for (int i = 0; i < block.frameCount; ++i)
+			for (int c = 0; c < channelCount; ++c)
+				block.channel(c)[i] = Processor::toFloat(Processor::read<Sample>(bytes + (size_t(i) * channelCount + c) * sizeof(Sample)));
+	}
+
+	template <typename Sample>
+	void encode(Block &block, char *bytes)
+	{
+		for (int i = 0; i < block.frameCount; ++i)
+			for (int c = 0; c < channelCount; ++c)
+				Processor::write<Sample>(bytes + (size_t(i) * channelCount + c) * sizeof(Sample), Processor::fromFloat<Sample>(block.channel(c)[i]));
+	}
+
+	// Reader thread: fills input blocks until the end of input, which the last, possibly empty, block marks
+	void read()
+	{
+		const size_t bytesPerFrame = channelCount * bitsPerSample / 8;
+		std::vector<char> bytes(blockFrameCount * bytesPerFrame);
+
+		for (bool last = false; !last;)
+		{
+			const auto wanted = std::min<uint64_t>(bytes.size(), inputBytesRemaining / bytesPerFrame * bytesPerFrame);
+			const auto size = std::fread(bytes.data(), 1, wanted, input);
+			if (size < wanted && std::ferror(input))
+				fail("Please check your input file: there was a problem reading its audio data");
+			inputBytesRemaining -= size;
+
+			Block &block = *freeBlocks[0].pop();
+			block.offset = 0;
+			block.frameCount = int(size / bytesPerFrame);
+			block.last = size < bytes.size();
+
+			if (sampleFormat == 3)
+				decode<float>(block, bytes.data());
+			else if (bitsPerSample == 32)
+				decode<int32_t>(block, bytes.data());
+			else
+				decode<int16_t>(block, bytes.data());
+
+			last = block.last;
+			filledBlocks[0].push(&block);
+		}
+	}
+
+	// Writer thread: writes output blocks until the last
+	void write()
+	{
+		std::vector<char> bytes;
+		for (bool last = false; !last;)
+		{
+			Block &block = *filledBlocks[1].pop();
+			bytes.resize(size_t(block.frameCount) * channelCount * bitsPerSample / 8);
+
+			if (sampleFormat == 3)
+				encode<float>(block, bytes.data());
+			else if (bitsPerSample == 32)
+				encode<int32_t>(block, bytes.data());
+			else
+				encode<int16_t>(block, bytes.data());
+
+			if (std::fwrite(bytes.data(), 1, bytes.size(), output) != bytes.size())
+				fail("Please check your output path: there was a problem writing the output file");
+
+			last = block.last;
+			freeBlocks[1].push(&block);
+		}
+	}
+};
+
 } // namespace Bungee::CommandLine
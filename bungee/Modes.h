@@ -12,8 +12,15 @@
 	X_ITEM(Resample, resample, forceIn, "input resampling, always active") \
 	X_END(Resample, resample)
 
+#define BUNGEE_MODES_INTERPOLATION \
+	X_BEGIN(Interpolation, interpolation) \
+	X_ITEM(Interpolation, interpolation, bilinear, "bilinear interpolation when resampling, fastest") \
+	X_ITEM(Interpolation, interpolation, sinc, "polyphase windowed-sinc interpolation when resampling, highest quality") \
+	X_END(Interpolation, interpolation)
+
 #define BUNGEE_MODES \
-	BUNGEE_MODES_RESAMPLE
+	BUNGEE_MODES_RESAMPLE \
+	BUNGEE_MODES_INTERPOLATION
 
 #define X_BEGIN(Type, type) \
 	enum Type##Mode \
@@ -0,0 +1,220 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include "Bungee.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numbers>
+#include <thread>
+#include <vector>
+
+namespace Bungee::Offline {
+
+// Bungee::Offline::Renderer is an optional component for batch jobs that stretch a whole,
+// in-memory file at constant speed and pitch using several threads.
+//
+// The output timeline is divided into one segment per thread. Each segment is rendered by its
+// own Bungee::Stretcher, which starts with a reset grain (see Stretcher::preroll) a few grains
+// ahead of the segment so that its state has settled by the time its output is used. Segment
+// start positions lie on the same grid of grain positions as a single-threaded render and
+// neighbouring segments are stitched with a short raised-cosine crossfade.
+//
+// Output is placed so that input position zero maps to output frame zero. The first segment's
+// audio is that of a single-threaded render; later segments differ in phase detail, which the
+// crossfades conceal. Example usage may be found in ../cmd/main.cpp.
+//
+template <class Edition>
+struct Renderer
+{
+	const SampleRates sampleRates;
+	const int channelCount;
+	const int log2SynthesisHopAdjust;
+
+	// Grains rendered and discarded ahead of each segment's crossfade
+	int warmupGrainCount = 8;
+
+	// Duration of the crossfade between neighbouring segments
+	double crossfadeSeconds = 0.05;
+
+	// Fewer segments than threads are used rather than segments shorter than this
+	double minimumSegmentSeconds = 5.;
+
+	// Passed to Stretcher::enableMultiResolution() of each segment's stretcher
+	bool multiResolution = false;
+
+	// Passed to Stretcher::enableLowLatency() of each segment's stretcher
+	bool lowLatency = false;
+
+	// Passed to Stretcher::enableFormantPreservation() of each segment's stretcher
+	bool formantPreservation = false;
+
+	// Passed to Stretcher::enablePartialTracking() of each segment's stretcher
+	bool partialTracking = false;
+
+	// Passed to Stretcher::setInterpolationMode() of each segment's stretcher
+	InterpolationMode interpolationMode = interpolationMode_bilinear;
+
+	// Passed to Stretcher::setChannelGroups() of each segment's stretcher: channel count of each group, or empty for one group
+	std::vector<int> channelGroups;
+
+	Renderer(SampleRates sampleRates, int channelCount, int log2SynthesisHopAdjust = 0) :
+		sampleRates(sampleRates),
+		channelCount(channelCount),
+		log2SynthesisHopAdjust(log2SynthesisHopAdjust)
+	{
+	}
+
+	// Renders outputFrameCount frames of output audio, starting from input position zero.
+	// The request provides a positive speed, pitch and modes; its position and reset fields are ignored.
+	void render(const Request &request, int threadCount, const float *input, intptr_t inputChannelStride, int inputFrameCount, float *output, intptr_t outputChannelStride, int outputFrameCount) const
+	{
+		const auto minimumSegmentFrameCount = std::max(minimumSegmentSeconds * sampleRates.output, 1.);
+		const int segmentCount = std::clamp(int(outputFrameCount / minimumSegmentFrameCount), 1, std::max(threadCount, 1));
+
+		std::vector<Segment> segments(segmentCount);
+		for (int k = 0; k < segmentCount; ++k)
+		{
+			segments[k].begin = int(int64_t(outputFrameCount) * k / segmentCount);
+			segments[k].end = int(int64_t(outputFrameCount) * (k + 1) / segmentCount);
+		}
+
+		const int crossfadeFrameCount = segmentCount > 1 ? (int)std::round(crossfadeSeconds * sampleRates.output) : 0;
+
+		Context context{request, input, inputChannelStride, inputFrameCount, output, outputChannelStride, outputFrameCount, crossfadeFrameCount};
+
+		std::atomic<int> nextSegment{0};
+		const auto work = [&]() {
+			for (int k; (k = nextSegment.fetch_add(1)) < segmentCount;)
+				renderSegment(context, segments[k], k == 0, k == segmentCount - 1);
+		};
+
+		std::vector<std::thread> threads;
+		for (int i = 1; i < segmentCount; ++i)
+			threads.emplace_back(work);
+		work();
+		for (auto &thread : threads)
+			thread.join();
+
+		// Each segment's fade-in is already in the output; add the preceding segment's fade-out to it
+		for (int k = 1; k < segmentCount; ++k)
+		{
+			const auto &tail = segments[k - 1].tail;
+			const int frameCount = std::min(crossfadeFrameCount, outputFrameCount - segments[k].begin);
+			for (int c = 0; c < channelCount; ++c)
+				for (int i = 0; i < frameCount; ++i)
+					output[segments[k].begin + i + c * outputChannelStride] += tail[i + c * crossfadeFrameCount];
+		}
+	}
+
+private:
+	struct Segment
+	{
+		int begin;
+		int end;
+		std::vector<float> tail;
+	};
+
+	struct Context
+	{
+		const Request &request;
+		const float *input;
+		intptr_t inputChannelStride;
+		int inputFrameCount;
+		float *output;
+		intptr_t outputChannelStride;
+		int outputFrameCount;
+		int crossfadeFrameCount;
+	};
+
+	// Rising half of a raised-cosine window; fadeIn(i) + fadeIn(n - 1 - i) == 1
+	static float fadeIn(int i, int n)
+	{
+		return float(0.5 - 0.5 * std::cos(std::numbers::pi * (i + 0.5) / n));
+	}
+
+	void renderSegment(const Context &context, Segment &segment, bool first, bool last) const
+	{
+		Stretcher<Edition> stretcher(sampleRates, channelCount, log2SynthesisHopAdjust);
+		stretcher.enableMultiResolution(multiResolution);
+		stretcher.enableLowLatency(lowLatency);
+		stretcher.enableFormantPreservation(formantPreservation);
+		stretcher.enablePartialTracking(partialTracking);
+		stretcher.setInterpolationMode(interpolationMode);
+		stretcher.setChannelGroups(channelGroups.data(), (int)channelGroups.size());
+
+		Request request = context.request;
+		request.position = 0.;
+		request.reset = false;
+
+		const int fadeFrameCount = first ? 0 : context.crossfadeFrameCount;
+		const int tailFrameCount = last ? 0 : std::min(context.crossfadeFrameCount, context.outputFrameCount - segment.end);
+		const int end = segment.end + tailFrameCount;
+
+		segment.tail.assign(size_t(context.crossfadeFrameCount) * channelCount, 0.f);
+
+		if (!first)
+		{
+			Request probe = request;
+			stretcher.next(probe);
+			const double inputHop = probe.position;
+			const double outputFramesPerGrain = inputHop * sampleRates.output / (request.speed * sampleRates.input);
+			const auto grain = std::floor(segment.begin / outputFramesPerGrain) - warmupGrainCount;
+			request.position = std::max(grain, 0.) * inputHop;
+		}
+
+		stretcher.preroll(request);
+
+		// Output frame index of the next output chunk, determined by the first chunk with a valid position
+		int64_t cursor = 0;
+		bool anchored = false;
+
+		while (!anchored || cursor < end)
+		{
+			InputChunk inputChunk = stretcher.specifyGrain(request);
+
+			const auto muteFrameCountHead = std::max(0, -inputChunk.begin);
+			const auto muteFrameCountTail = std::max(0, inputChunk.end - context.inputFrameCount);
+
+			stretcher.analyseGrain(context.input + inputChunk.begin, context.inputChannelStride, muteFrameCountHead, muteFrameCountTail);
+
+			OutputChunk outputChunk;
+			stretcher.synthesiseGrain(outputChunk);
+
+			stretcher.next(request);
+
+			const auto positionBegin = outputChunk.request[OutputChunk::begin]->position;
+			const auto positionEnd = outputChunk.request[OutputChunk::end]->position;
+			if (std::isnan(positionBegin) || positionBegin == positionEnd)
+				continue;
+
+			if (!anchored)
+			{
+				cursor = std::llround(positionBegin * (outputChunk.frameCount / std::abs(positionEnd - positionBegin)));
+				anchored = true;
+			}
+
+			const int i0 = (int)std::clamp<int64_t>(segment.begin - cursor, 0, outputChunk.frameCount);
+			const int i1 = (int)std::clamp<int64_t>(end - cursor, 0, outputChunk.frameCount);
+			for (int c = 0; c < channelCount; ++c)
+				for (int i = i0; i < i1; ++i)
+				{
+					const auto x = outputChunk.data[i + c * outputChunk.channelStride];
+					const auto f = int(cursor + i);
+					if (f < segment.begin + fadeFrameCount)
+						context.output[f + c * context.outputChannelStride] = x * fadeIn(f - segment.begin, fadeFrameCount);
+					else if (f < segment.end)
+						context.output[f + c * context.outputChannelStride] = x;
+					else
+						segment.tail[f - segment.end + c * context.crossfadeFrameCount] = x * fadeIn(segment.end + context.crossfadeFrameCount - 1 - f, context.crossfadeFrameCount);
+				}
+
+			cursor += outputChunk.frameCount;
+		}
+	}
+};
+
+} // namespace Bungee::Offline
@@ -0,0 +1,123 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include <bungee/Bungee.h>
+
+namespace Bungee::Pull {
+
+// Bungee::Pull::InputCache is an optional component that assists users of Bungee::Stretcher in
+// applications that fetch ("pull") each grain's input from a source of random access, for example
+// a decoder or a memory-mapped file, and that play in reverse, scrub or freeze.
+//
+// Successive grains overlap by most of their length whatever the speed, so fetching each grain's
+// whole input chunk decodes and converts the same frames several times over. This cache holds the
+// frames of recent grains and, for each new grain, fetches only those frames that it does not yet
+// hold, before or after the cached range, so it works equally in either direction and fetches
+// nothing at all while speed is zero. Cached frames are moved only when the grain reaches an end
+// of the buffer, which is several grains long. Example usage may be found in ../bungee/CommandLine.h.
+//
+struct InputCache
+{
+	InputCache(int maxInputFrameCount, int channelCount, int capacity = 0) :
+		capacity(std::max(capacity, 3 * maxInputFrameCount)),
+		maxInputFrameCount(maxInputFrameCount),
+		vector(size_t(this->capacity) * channelCount)
+	{
+	}
+
+	// Specifies the next grain, calling fetch(float *data, int channelStride, int position, int frameCount)
+	// to write, for every channel, each run of frames [position, position + frameCount) that is not cached
+	template <class Fetch>
+	void grain(const InputChunk &inputChunk, Fetch &&fetch)
+	{
+		const int frameCount = inputChunk.end - inputChunk.begin;
+		assert(frameCount >= 0 && frameCount <= maxInputFrameCount);
+
+		const int overlapBegin = std::max(inputChunk.begin, begin);
+		const int overlapEnd = std::min(inputChunk.end, end);
+
+		// Buffer index of the grain's first frame
+		current = origin + (inputChunk.begin - begin);
+
+		if (overlapBegin >= overlapEnd)
+		{
+			// Nothing to reuse, for example after a seek or on the first grain
+			current = (capacity - frameCount) / 2;
+			origin = current;
+			begin = end = inputChunk.begin;
+		}
+		else if (current < 0 || current + frameCount > capacity)
+		{
+			// Keep the frames that this grain reuses, moved so that the grain is at the middle of the buffer
+			const int middle = (capacity - frameCount) / 2;
+			const int from = origin + (overlapBegin - begin);
+			const int to = middle + (overlapBegin - inputChunk.begin);
+			for (size_t x = 0; x < vector.size(); x += stride())
+				std::memmove(&vector[x + to], &vector[x + from], (overlapEnd - overlapBegin) * sizeof(float));
+
+			current = middle;
+			origin = to;
+			begin = overlapBegin;
+			end = overlapEnd;
+		}
+
+		if (inputChunk.begin < begin)
+		{
+			fetch(&vector[current], stride(), inputChunk.begin, begin - inputChunk.begin);
+			fetched += begin - inputChunk.begin;
+			origin = current;
+			begin = inputChunk.begin;
+		}
+
+		if (end < inputChunk.end)
+		{
+			fetch(&vector[origin + (end - begin)], stride(), end, inputChunk.end - end);
+			fetched += inputChunk.end - end;
+			end = inputChunk.end;
+		}
+	}
+
+	// Forgets all cached frames, for example when the source audio changes
+	void clear()
+	{
+		begin = end = 0;
+	}
+
+	// The current grain's audio, for Stretcher::analyseGrain with stride()
+	const float *outputData() const
+	{
+		return &vector[current];
+	}
+
+	int stride() const
+	{
+		return capacity;
+	}
+
+	// Total number of frames fetched, a measure of the cache's effectiveness
+	long long fetchedFrameCount() const
+	{
+		return fetched;
+	}
+
+private:
+	const int capacity;
+	const int maxInputFrameCount;
+	std::vector<float> vector;
+	long long fetched = 0;
+
+	// Cached frames [begin, end) of the source are at buffer indices from origin
+	int begin = 0;
+	int end = 0;
+	int origin = 0;
+	int current = 0;
+};
+
+} // namespace Bungee::Pull
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <vector>
 
@@ -36,14 +38,20 @@ namespace Bungee::Push {
 //
 struct InputBuffer
 {
-	std::vector<float> vector;
+	std::vector<float, AllocatorAdapter<float>> vector;
 	int maxInputFrameCount;
 	int begin = 0;
 	int end = -1;
 	int endRequired = 0;
 
 	InputBuffer(int maxInputFrameCount, int channelCount) :
-		vector(maxInputFrameCount * channelCount),
+		InputBuffer(maxInputFrameCount, channelCount, Allocator{})
+	{
+	}
+
+	// Allocates the buffer, once, with a host's Allocator, as a stretcher's buffers are; throws std::bad_alloc if it returns null
+	InputBuffer(int maxInputFrameCount, int channelCount, const Allocator &allocator) :
+		vector(maxInputFrameCount * channelCount, AllocatorAdapter<float>(allocator)),
 		maxInputFrameCount(maxInputFrameCount)
 	{
 	}
@@ -114,4 +122,112 @@ struct InputBuffer
 	}
 };
 
+// Bungee::Push::RingBuffer is an alternative to InputBuffer for applications that deliver audio on
+// one thread (for example, a decoder or network thread) and call Bungee::Stretcher on another (for
+// example, a real-time audio callback).
+//
+// It is a wait-free, single-producer, single-consumer ring buffer. The producer delivers frames at
+// increasing input positions, starting at position zero. The consumer specifies each grain and
+// reads it as a contiguous, non-interleaved view. Storage for the first maxInputFrameCount frames
+// of the ring is mirrored after its end, so no grain view wraps and no audio is moved after
+// delivery. Frames before the current grain are released for reuse by the producer.
+//
+struct RingBuffer
+{
+	RingBuffer(int capacity, int maxInputFrameCount, int channelCount) :
+		capacity(capacity),
+		maxInputFrameCount(maxInputFrameCount),
+		channelCount(channelCount),
+		vector((capacity + maxInputFrameCount) * channelCount)
+	{
+		assert(maxInputFrameCount <= capacity);
+	}
+
+	// Producer: number of frames that may be delivered now
+	int inputFrameCountMax() const
+	{
+		return capacity - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+	}
+
+	// Producer: copies frameCount frames from non-interleaved channel pointers, or delivers silence if channels is nullptr
+	void deliver(const float *const *channels, int frameCount)
+	{
+		assert(frameCount >= 0);
+		assert(frameCount <= inputFrameCountMax());
+
+		const int position = head.load(std::memory_order_relaxed);
+		for (int done = 0; done < frameCount;)
+		{
+			const int offset = index(position + done);
+			const int n = std::min(frameCount - done, capacity - offset);
+			for (int c = 0; c < channelCount; ++c)
+			{
+				float *const p = &vector[c * stride()];
+				if (channels)
+					std::copy(channels[c] + done, channels[c] + done + n, p + offset);
+				else
+					std::fill(p + offset, p + offset + n, 0.f);
+
+				const int mirrored = std::min(offset + n, maxInputFrameCount) - offset;
+				if (mirrored > 0)
+					std::copy(p + offset, p + offset + mirrored, p + capacity + offset);
+			}
+			done += n;
+		}
+
+		head.store(position + frameCount, std::memory_order_release);
+	}
+
+	// Consumer: specifies the next grain and releases frames before it
+	void grain(const InputChunk &inputChunk)
+	{
+		assert(inputChunk.end - inputChunk.begin <= maxInputFrameCount);
+
+		this->inputChunk = inputChunk;
+
+		const int released = std::clamp(inputChunk.begin, tail.load(std::memory_order_relaxed), head.load(std::memory_order_acquire));
+		tail.store(released, std::memory_order_release);
+	}
+
+	// Consumer: number of frames that must still be delivered before the current grain is complete
+	int inputFrameCountRequired() const
+	{
+		return std::max(0, inputChunk.end - head.load(std::memory_order_acquire));
+	}
+
+	// Consumer: frames at the start of the grain that precede position zero
+	int muteFrameCountHead() const
+	{
+		return std::clamp(-inputChunk.begin, 0, inputChunk.end - inputChunk.begin);
+	}
+
+	// Consumer: the current grain's audio, for Stretcher::analyseGrain with stride()
+	const float *outputData() const
+	{
+		return &vector[index(inputChunk.begin)];
+	}
+
+	int stride() const
+	{
+		return capacity + maxInputFrameCount;
+	}
+
+private:
+	const int capacity;
+	const int maxInputFrameCount;
+	const int channelCount;
+	std::vector<float> vector;
+	InputChunk inputChunk{};
+
+	// Input positions: frames [tail, head) are delivered and not yet released
+	alignas(64) std::atomic<int> head{0};
+	alignas(64) std::atomic<int> tail{0};
+
+	int index(int position) const
+	{
+		const int i = position % capacity;
+		return i < 0 ? i + capacity : i;
+	}
+};
+
 } // namespace Bungee::Push
@@ -5,7 +5,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
 #include <span>
+#include <vector>
 
 #pragma once
 
@@ -26,57 +29,89 @@ class Stream
 	{
 		const int channelStride;
 		const int channelCount;
-		std::vector<float> buffer;
+		std::vector<float, AllocatorAdapter<float>> buffer;
 		int begin = 0;
 		int end = 0;
 
+		// Frames [bufferedEnd, end) have not yet been copied and are still in the caller's buffers
+		int bufferedEnd = 0;
+		const float *const *callerPointers = nullptr;
+		int callerFrameCount = 0;
+		int callerStride = 0;
+
 	public:
 		Stretcher<Implementation> &stretcher;
 		InputChunk inputChunk{};
 
-		InputBuffer(Stretcher<Implementation> &stretcher, int maxFrameCount, int channelCount) :
+		InputBuffer(Stretcher<Implementation> &stretcher, int maxFrameCount, int channelCount, const Allocator &allocator) :
 			channelStride(maxFrameCount),
 			channelCount(channelCount),
-			buffer(channelStride * channelCount),
+			buffer(channelStride * channelCount, AllocatorAdapter<float>(allocator)),
 			stretcher(stretcher)
 		{
 		}
 
+		// Refers to the caller's input, which must remain valid until release()
 		void append(int inputFrameCount, const float *const *inputPointers)
 		{
+			assert(bufferedEnd == end);
+
+			callerPointers = inputPointers;
+			callerFrameCount = inputFrameCount;
+			end += inputFrameCount;
+
+			// Grains can be analysed in place when the caller's channels are equally spaced
+			callerStride = 0;
+			if (inputPointers)
+			{
+				const auto stride = channelCount > 1 ? inputPointers[1] - inputPointers[0] : 0;
+				bool equallySpaced = stride >= 0 && stride <= std::numeric_limits<int>::max();
+				for (int c = 2; c < channelCount && equallySpaced; ++c)
+					equallySpaced = inputPointers[c] == inputPointers[0] + c * stride;
+				if (equallySpaced)
+					callerStride = channelCount > 1 ? (int)stride : inputFrameCount;
+			}
+		}
+
+		// Copies input still held in the caller's buffers that the current or later grains need
+		void release()
+		{
+			if (bufferedEnd == end)
+				return;
+
 			int discard = 0;
 
-			if (inputChunk.begin < end)
+			if (inputChunk.begin < bufferedEnd)
 			{
 				if (begin < inputChunk.begin)
 				{
 					for (int x = 0; x < (int)buffer.size(); x += channelStride)
 						std::move(
 							&buffer[x + inputChunk.begin - begin],
-							&buffer[x + end - begin],
+							&buffer[x + bufferedEnd - begin],
 							&buffer[x]);
 					begin = inputChunk.begin;
 				}
 			}
 			else
 			{
-				discard = std::min(inputChunk.begin - begin, inputFrameCount);
-				begin = end;
+				discard = std::min(inputChunk.begin, end) - bufferedEnd;
+				begin = bufferedEnd + discard;
 			}
 
+			const int callerBegin = end - callerFrameCount;
 			for (int c = 0; c < channelCount; ++c)
-				if (inputPointers)
+				if (callerPointers)
 					std::copy(
-						&inputPointers[c][discard],
-						&inputPointers[c][inputFrameCount],
-						&buffer[(end - begin) + c * channelStride]);
+						&callerPointers[c][bufferedEnd + discard - callerBegin],
+						&callerPointers[c][callerFrameCount],
+						&buffer[(bufferedEnd + discard - begin) + c * channelStride]);
 				else
 					std::fill(
+						&buffer[(bufferedEnd + discard - begin) + c * channelStride],
 						&buffer[(end - begin) + c * channelStride],
-						&buffer[(end - begin) + c * channelStride + (inputFrameCount - discard)],
 						0.f);
-			begin += discard;
-			end += inputFrameCount;
+			bufferedEnd = end;
 			assert(end >= begin);
 			assert(end - begin <= channelStride);
 		}
@@ -86,8 +121,17 @@ class Stream
 			return end;
 		}
 
-		void analyseGrain() const
+		void analyseGrain()
 		{
+			const int callerBegin = end - callerFrameCount;
+			if (callerStride && inputChunk.begin >= callerBegin && inputChunk.end <= end)
+			{
+				stretcher.analyseGrain(callerPointers[0] + (inputChunk.begin - callerBegin), callerStride, 0, 0);
+				return;
+			}
+
+			release();
+
 			const int muteHead = begin - inputChunk.begin;
 			const int muteTail = inputChunk.end - end;
 			assert(muteHead >= (inputChunk.end - inputChunk.begin) || muteTail <= 0);
@@ -114,8 +158,22 @@ public:
 	 * @param channelCount Number of channels
 	 */
 	Stream(Stretcher<Implementation> &stretcher, int maxInputFrameCount, int channelCount) :
+		Stream(stretcher, maxInputFrameCount, channelCount, Allocator{})
+	{
+	}
+
+	/**
+	 * @brief Construct a Stream whose input buffer is allocated by allocator, as a stretcher's buffers are.
+	 * @param stretcher Reference to the stretcher
+	 * @param maxInputFrameCount Maximum number of input frames per process
+	 * @param channelCount Number of channels
+	 * @param allocator Functions that allocate the input buffer, once, here, and free it when the Stream is destroyed;
+	 * their context must remain valid until then
+	 * @throws std::bad_alloc if allocator.allocate returns null.
+	 */
+	Stream(Stretcher<Implementation> &stretcher, int maxInputFrameCount, int channelCount, const Allocator &allocator) :
 		channelCount(channelCount),
-		inputBuffer(stretcher, stretcher.maxInputFrameCount() + maxInputFrameCount, channelCount)
+		inputBuffer(stretcher, stretcher.maxInputFrameCount() + maxInputFrameCount, channelCount, allocator)
 	{
 		request.position = std::numeric_limits<double>::quiet_NaN();
 	}
@@ -125,6 +183,9 @@ public:
 	 *
 	 * Renders output samples to outputPointers. The number of samples is set by dithering to floor or ceil of outputFrameCount.
 	 *
+	 * When the input channels are equally spaced in memory (for example, a non-interleaved block with a fixed channel stride),
+	 * grains that lie entirely within this call's input are analysed in place and only the final lap is copied internally.
+	 *
 	 * @param inputPointers Array of pointers to input audio (per channel), nullptr for mute input
 	 * @param outputPointers Array of pointers to output audio (per channel)
 	 * @param inputFrameCount Number of input audio samples to process
@@ -185,6 +246,8 @@ public:
 			}
 		}
 
+		inputBuffer.release();
+
 		assert(frameCounter == std::floor(outputFrameCount) || frameCounter == std::ceil(outputFrameCount));
 		framesNeeded -= frameCounter;
 		return frameCounter;
@@ -0,0 +1,1255 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+// Bungee benchmark: sweeps stretcher configurations over synthetic audio and reports, as JSON,
+// throughput and the time spent in each stage of the granular API.
+//
+// The executable is built from the library sources so that it can time the stages within
+// analyseGrain() and synthesiseGrain():
+//   analyseInput       - input resampling, analysis window and forward FFT
+//   analyseSpectrum    - energy and phase of each bin and enumeration of partials
+//   synthesiseSpectrum - phase synthesis, rotation and inverse FFT
+//   synthesiseOutput   - synthesis window, overlap-add and output resampling
+// Finer phases within the stages are reported from Stretcher::getStats().
+//
+// With --real-time, stretchers run in real-time mode and the benchmark counts any allocations, locks and system
+// calls made during grains (see interpose.h), failing if there are any.
+//
+// With --golden and --record, the output and throughput of each configuration are written to a directory of golden
+// files. With --golden alone, each configuration is instead compared with its golden file: the benchmark fails if
+// its output's signal-to-noise ratio or log-spectral distance against the golden output is outside tolerance, or if
+// grains per second, averaged geometrically over all configurations, have fallen too far. Record goldens with a trusted build and then check changes, such as a new SIMD path or
+// compiler flags, on the same machine.
+//
+// With --check, the benchmark instead runs behavioural checks of the stretcher, such as that muted input renders as
+// zeros would, reporting each as JSON and failing if any fails.
+
+#include "interpose.h"
+#include "bungee/Pull.h"
+#include "src/Stretcher.h"
+
+#define CXXOPTS_NO_EXCEPTIONS
+#include "cxxopts.hpp"
+#undef CXXOPTS_NO_EXCEPTIONS
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numbers>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using namespace Bungee;
+
+static void fail(const std::string &message)
+{
+	std::cerr << "Fatal error: " << message << "\n";
+	exit(1);
+}
+
+template <typename T>
+static std::vector<T> parseList(const std::string &name, const std::string &text)
+{
+	std::vector<T> list;
+	std::istringstream in(text);
+	for (std::string item; std::getline(in, item, ',');)
+	{
+		std::istringstream itemIn(item);
+		T value;
+		if (!(itemIn >> value) || !itemIn.eof())
+			fail("could not parse --" + name + " value '" + item + "'");
+		list.push_back(value);
+	}
+	if (list.empty())
+		fail("no values given for --" + name);
+	return list;
+}
+
+enum Stage
+{
+	specifyGrain,
+	analyseInput,
+	analyseSpectrum,
+	synthesiseSpectrum,
+	synthesiseOutput,
+	stageCount,
+};
+
+static const char *const stageNames[stageCount] = {"specifyGrain", "analyseInput", "analyseSpectrum", "synthesiseSpectrum", "synthesiseOutput"};
+
+enum Signal
+{
+	tones,
+	sine,
+	chirp,
+	speech,
+	transients,
+	signalCount,
+};
+
+static const char *const signalNames[signalCount] = {"tones", "sine", "chirp", "speech", "transients"};
+
+struct Configuration
+{
+	Signal signal;
+	int sampleRate;
+	int channelCount;
+	int log2SynthesisHopAdjust;
+	double speed;
+	double semitones;
+	ResampleMode resampleMode;
+	InterpolationMode interpolationMode;
+	FftBackend fftBackend;
+	bool partialTracking = false;
+};
+
+struct Result
+{
+	int grainCount = 0;
+	int64_t outputFrameCount = 0;
+	double seconds = 0.;
+	double stageSeconds[stageCount]{};
+	Stats stats;
+	FftBackend fftBackend;
+	Interpose::Counts realTime{};
+};
+
+// Deterministic test signals, differing per channel:
+//   tones      - a few harmonic tones with gliding pitch plus low-level noise
+//   sine       - a steady sine
+//   chirp      - an exponential sweep from 50 Hz to near the Nyquist frequency
+//   speech     - a pulse train with intonation through the formant resonances of changing vowels, in syllables
+//   transients - drum-like hits: falling-pitch kicks alternating with decaying noise bursts
+static std::vector<float> synthesiseInput(Signal signal, int sampleRate, int channelCount, int frameCount)
+{
+	std::vector<float> audio(size_t(channelCount) * frameCount);
+	uint32_t state = 1;
+	const auto noise = [&]() {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.f / (1 << 24)) - 0.5f;
+	};
+
+	for (int c = 0; c < channelCount; ++c)
+	{
+		float *x = &audio[size_t(c) * frameCount];
+		double phase = 0.;
+
+		if (signal == tones)
+			for (int i = 0; i < frameCount; ++i)
+			{
+				const double t = double(i) / sampleRate;
+				phase += 2 * std::numbers::pi * (220. * (c + 1) * (1. + 0.1 * std::sin(2 * std::numbers::pi * 0.5 * t))) / sampleRate;
+
+				x[i] = 0.f;
+				for (int h = 1; h <= 4; ++h)
+					x[i] += float(0.15 / h * std::sin(h * phase));
+
+				x[i] += 0.01f * noise();
+			}
+		else if (signal == sine)
+			for (int i = 0; i < frameCount; ++i)
+				x[i] = float(0.5 * std::sin(2 * std::numbers::pi * 440. * (1. + 0.25 * c) * i / sampleRate));
+		else if (signal == chirp)
+			for (int i = 0; i < frameCount; ++i)
+			{
+				phase += 2 * std::numbers::pi * 50. * std::pow(0.45 * sampleRate / 50., double(i) / frameCount) / sampleRate;
+				x[i] = float(0.3 * std::sin(phase + 0.5 * c));
+			}
+		else if (signal == speech)
+		{
+			// Formants, Hz, of the vowels a, i and u, each held for a syllable of a quarter second
+			static const double formants[3][3] = {{730., 1090., 2440.}, {270., 2290., 3010.}, {300., 870., 2240.}};
+			const double r = std::exp(-std::numbers::pi * 80. / sampleRate); // 80 Hz bandwidth
+			double resonators[3][2]{};
+			for (int i = 0; i < frameCount; ++i)
+			{
+				const double t = double(i) / sampleRate;
+				const double previous = phase;
+				phase += (110. + 10. * c) * (1. + 0.15 * std::sin(2 * std::numbers::pi * 0.7 * t)) / sampleRate;
+				const double pulse = std::floor(phase) != std::floor(previous);
+
+				const int syllable = int(t * 4);
+				const double envelope = std::pow(std::sin(std::numbers::pi * (t * 4 - syllable)), 2);
+
+				double y = 0.;
+				for (int k = 0; k < 3; ++k)
+				{
+					const double w = 2 * std::numbers::pi * formants[(syllable + c) % 3][k] / sampleRate;
+					const double v = pulse + 2 * r * std::cos(w) * resonators[k][0] - r * r * resonators[k][1];
+					resonators[k][1] = resonators[k][0];
+					resonators[k][0] = v;
+					y += v * std::sin(w) / (k + 1);
+				}
+				x[i] = float(0.2 * envelope * y) + 0.002f * noise();
+			}
+		}
+		else
+		{
+			const int period = sampleRate / 8;
+			for (int i = 0; i < frameCount; ++i)
+			{
+				const double u = double(i % period) / sampleRate;
+				if ((i / period + c) % 2)
+					x[i] = float(0.8 * std::exp(-u / 0.03)) * noise();
+				else
+				{
+					phase = i % period ? phase + 2 * std::numbers::pi * (50. + 100. * std::exp(-u / 0.03)) / sampleRate : 0.;
+					x[i] = float(0.6 * std::exp(-u / 0.08) * std::sin(phase));
+				}
+			}
+		}
+	}
+	return audio;
+}
+
+// Golden output of one configuration, as recorded by --record: its grains per second and interleaved output samples
+struct Golden
+{
+	double grainsPerSecond = 0.;
+	std::vector<float> output;
+
+	static constexpr uint32_t magic = 0x646c6742; // "Bgld" when little endian
+
+	bool read(const std::string &filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		uint32_t m = 0;
+		uint64_t size = 0;
+		file.read(reinterpret_cast<char *>(&m), sizeof(m));
+		file.read(reinterpret_cast<char *>(&grainsPerSecond), sizeof(grainsPerSecond));
+		file.read(reinterpret_cast<char *>(&size), sizeof(size));
+		if (!file || m != magic || size > (1ull << 32))
+			return false;
+		output.resize(size);
+		return bool(file.read(reinterpret_cast<char *>(output.data()), size * sizeof(float)));
+	}
+
+	bool write(const std::string &filename) const
+	{
+		std::ofstream file(filename, std::ios::binary);
+		const uint64_t size = output.size();
+		file.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+		file.write(reinterpret_cast<const char *>(&grainsPerSecond), sizeof(grainsPerSecond));
+		file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+		file.write(reinterpret_cast<const char *>(output.data()), size * sizeof(float));
+		return bool(file.flush());
+	}
+};
+
+// Signal-to-noise ratio, in dB, of output as an approximation to golden over their common length: at most 999 dB,
+// reported when they are identical
+static double signalToNoise(const std::vector<float> &output, const std::vector<float> &golden)
+{
+	double signal = 0., noise = 0.;
+	for (size_t i = 0; i < std::min(output.size(), golden.size()); ++i)
+	{
+		const double e = double(output[i]) - golden[i];
+		signal += double(golden[i]) * golden[i];
+		noise += e * e;
+	}
+	return noise ? std::min(10 * std::log10(signal / noise), 999.) : 999.;
+}
+
+// Root-mean-square difference, in dB, between the short-time power spectra of interleaved output and golden over
+// their common length, taken over the bins of each channel's Hann-windowed frames where either exceeds -100 dBFS
+static double spectralDistance(const std::vector<float> &output, const std::vector<float> &golden, int channelCount)
+{
+	constexpr int log2Length = 11;
+	constexpr int length = 1 << log2Length;
+
+	Fourier::Transforms transforms;
+	transforms.prepareForward(log2Length);
+
+	Eigen::ArrayXXf t(length, 2);
+	Eigen::ArrayXXcf f;
+	Fourier::resize<true>(log2Length, 2, f);
+
+	const auto floor = 1e-10 * (length / 4.) * (length / 4.);
+	const auto frameCount = std::ptrdiff_t(std::min(output.size(), golden.size()) / channelCount);
+
+	double sum = 0.;
+	int64_t count = 0;
+	for (int c = 0; c < channelCount; ++c)
+		for (std::ptrdiff_t begin = 0; begin < frameCount; begin += length / 2)
+		{
+			for (int i = 0; i < length; ++i)
+			{
+				const auto window = float(0.5 - 0.5 * std::cos(2 * std::numbers::pi * i / length));
+				const bool inside = begin + i < frameCount;
+				t(i, 0) = inside ? window * output[(begin + i) * channelCount + c] : 0.f;
+				t(i, 1) = inside ? window * golden[(begin + i) * channelCount + c] : 0.f;
+			}
+
+			transforms.forward(log2Length, t, f);
+
+			for (int k = 0; k < Fourier::binCount(log2Length); ++k)
+			{
+				const double a = std::norm(f(k, 0)), b = std::norm(f(k, 1));
+				if (a > floor || b > floor)
+				{
+					const double d = 10 * std::log10((a + floor) / (b + floor));
+					sum += d * d;
+					++count;
+				}
+			}
+		}
+	return count ? std::sqrt(sum / count) : 0.;
+}
+
+// Runs a configuration, appending its interleaved output to any output vector
+static Result run(const Configuration &configuration, const std::vector<float> &input, int inputFrameCount, bool realTime, std::vector<float> *output = nullptr)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	Internal::Stretcher stretcher({configuration.sampleRate, configuration.sampleRate}, configuration.channelCount, configuration.log2SynthesisHopAdjust);
+	stretcher.transforms.select(configuration.fftBackend);
+	stretcher.enableRealTime(realTime);
+	stretcher.partialTracking = configuration.partialTracking;
+	stretcher.interpolationMode = configuration.interpolationMode;
+
+	Request request{};
+	request.speed = configuration.speed;
+	request.pitch = std::pow(2., configuration.semitones / 12);
+	request.resampleMode = configuration.resampleMode;
+	request.position = configuration.speed < 0 ? inputFrameCount - 1 : 0.;
+	stretcher.preroll(request);
+
+	Result result;
+	result.fftBackend = stretcher.fftBackend();
+	auto time = Clock::now();
+	const auto start = time;
+	const auto lap = [&](Stage stage) {
+		const auto now = Clock::now();
+		result.stageSeconds[stage] += std::chrono::duration<double>(now - time).count();
+		time = now;
+	};
+
+	Interpose::take();
+	while (configuration.speed < 0 ? request.position >= 0 : request.position < inputFrameCount)
+	{
+		const Interpose::Scope scope(realTime);
+
+		const auto inputChunk = stretcher.specifyGrain(request, 0.);
+		lap(specifyGrain);
+
+		const auto muteFrameCountHead = std::max(0, -inputChunk.begin);
+		const auto muteFrameCountTail = std::max(0, inputChunk.end - inputFrameCount);
+
+		// Calls the stages as Internal::Stretcher::analyseGrain() and synthesiseGrain() do
+		{
+			Internal::Instrumentation::Call call(stretcher, 1);
+
+			stretcher.analyseInput(input.data() + inputChunk.begin, sampleFormat_float32, inputFrameCount, 1, muteFrameCountHead, muteFrameCountTail);
+			lap(analyseInput);
+
+			stretcher.analyseSpectrum();
+			lap(analyseSpectrum);
+		}
+
+		OutputChunk outputChunk;
+		{
+			Internal::Instrumentation::Call call(stretcher, 2);
+
+			stretcher.synthesiseSpectrum();
+			lap(synthesiseSpectrum);
+
+			stretcher.synthesiseOutput(outputChunk);
+			lap(synthesiseOutput);
+		}
+
+		if (output)
+			for (int i = 0; i < outputChunk.frameCount; ++i)
+				for (int c = 0; c < configuration.channelCount; ++c)
+					output->push_back(outputChunk.data[i + c * outputChunk.channelStride]);
+
+		stretcher.next(request);
+
+		++result.grainCount;
+		result.outputFrameCount += outputChunk.frameCount;
+	}
+
+	result.realTime = Interpose::take();
+	result.seconds = std::chrono::duration<double>(time - start).count();
+	stretcher.getStats(result.stats);
+	return result;
+}
+
+template <typename Mode>
+static const char *modeName(Mode mode)
+{
+#define X_BEGIN(Type, type) \
+	if constexpr (std::is_same_v<Mode, Type##Mode>) \
+	{
+#define X_ITEM(Type, type, mode_, description) \
+		if (mode == type##Mode_##mode_) \
+			return #mode_;
+#define X_END(Type, type) \
+	}
+
+	BUNGEE_MODES
+
+#undef X_BEGIN
+#undef X_ITEM
+#undef X_END
+	return "?";
+}
+
+// Output of a mono stretcher at the given speed, prepared by enable, when the frames beyond input are muted or, for
+// comparison, passed as zeros; counts grains of short transforms whose tail mute reaches into their first half
+static std::vector<float> renderMuted(void (*enable)(Internal::Stretcher &), const std::vector<float> &input, double speed, bool mute, int &shortMutedCount)
+{
+	const int sampleRate = 44100;
+	const int inputFrameCount = (int)input.size();
+
+	Internal::Stretcher stretcher({sampleRate, sampleRate}, 1, 0);
+	enable(stretcher);
+
+	Request request{};
+	request.speed = speed;
+	request.pitch = 1.;
+	stretcher.preroll(request);
+
+	std::vector<float> output, buffer;
+	while (request.position < inputFrameCount + sampleRate / 2)
+	{
+		const auto inputChunk = stretcher.specifyGrain(request, 0.);
+
+		buffer.assign(inputChunk.end - inputChunk.begin, 0.f);
+		for (int i = std::max(inputChunk.begin, 0); i < std::min(inputChunk.end, inputFrameCount); ++i)
+			buffer[i - inputChunk.begin] = input[i];
+		const auto muteFrameCountHead = mute ? std::clamp(-inputChunk.begin, 0, (int)buffer.size()) : 0;
+		const auto muteFrameCountTail = mute ? std::clamp(inputChunk.end - inputFrameCount, 0, (int)buffer.size()) : 0;
+
+		stretcher.analyseGrain(buffer.data(), sampleFormat_float32, (std::ptrdiff_t)buffer.size(), 1, muteFrameCountHead, muteFrameCountTail);
+
+		const auto &grain = stretcher.grains[0];
+		if (grain.valid() && grain.log2TransformLength < stretcher.log2SynthesisHop + 3 && 2 * muteFrameCountTail > (int)buffer.size())
+			++shortMutedCount;
+
+		OutputChunk outputChunk;
+		stretcher.synthesiseGrain(outputChunk);
+		output.insert(output.end(), outputChunk.data, outputChunk.data + outputChunk.frameCount);
+
+		stretcher.next(request);
+	}
+	return output;
+}
+
+// Outcome of a behavioural check: any values it measured, for the JSON report, and a description of any failure
+struct Report
+{
+	std::vector<std::pair<std::string, double>> measured;
+	std::string failure;
+
+	void fail(const std::string &description)
+	{
+		failure += (failure.empty() ? "" : "; ") + description;
+	}
+};
+
+// Muted input must render exactly as zeros would, so that the output falls to zero after the end of input
+static void checkMute(Report &report, void (*enable)(Internal::Stretcher &), const std::vector<float> &input)
+{
+	int shortMutedCount = 0;
+	for (double speed : {0.7, 1., 1.4})
+	{
+		int unused = 0;
+		const auto muted = renderMuted(enable, input, speed, true, shortMutedCount);
+		const auto zeroed = renderMuted(enable, input, speed, false, unused);
+
+		float difference = 0.f, tail = 0.f;
+		for (size_t i = 0; i < std::min(muted.size(), zeroed.size()); ++i)
+			difference = std::max(difference, std::abs(muted[i] - zeroed[i]));
+		for (size_t i = muted.size() - std::min<size_t>(muted.size(), 4096); i < muted.size(); ++i)
+			tail = std::max(tail, std::abs(muted[i]));
+
+		if (muted.size() != zeroed.size() || difference || tail)
+		{
+			std::ostringstream failure;
+			failure << "speed " << speed << ": " << muted.size() << " muted and " << zeroed.size() << " zeroed frames differ by up to " << difference << ", tail peak " << tail;
+			report.fail(failure.str());
+		}
+	}
+	if (!shortMutedCount)
+		report.fail("no short grain had a tail mute into its first half");
+}
+
+// A quiet tone that ends during a noise burst, so that multi-resolution mode analyses its final grains with short transforms
+static std::vector<float> burstAtEnd()
+{
+	std::vector<float> input(30000);
+	uint32_t state = 1;
+	for (int i = 0; i < (int)input.size(); ++i)
+	{
+		state = state * 1664525u + 1013904223u;
+		input[i] = 0.02f * std::sin(0.05f * i);
+		if (i >= (int)input.size() - 1500)
+			input[i] += 0.8f * ((state >> 8) * (1.f / (1 << 24)) - 0.5f);
+	}
+	return input;
+}
+
+// Pull::InputCache must supply exactly the frames of each grain's input chunk while fetching, after the first grain, at
+// most the frames outside the previous grain's chunk: an eighth of a naive fetch at unit speed and nothing when frozen.
+// Reports the fraction of a naive fetch's frames that the cache fetched.
+static void checkPull(Report &report, double (*speed)(int grain))
+{
+	const int channelCount = 2;
+	const auto source = [](int position, int c) { return float(position % 65536) + 0.5f * c; };
+
+	Stretcher<Basic> stretcher({44100, 44100}, channelCount);
+	Pull::InputCache cache(stretcher.maxInputFrameCount(), channelCount);
+
+	Request request{};
+	request.position = 1 << 20;
+	request.speed = speed(0);
+	request.pitch = 1.;
+	stretcher.preroll(request);
+
+	long long naive = 0, bound = 0;
+	bool exact = true;
+	InputChunk previous{};
+	for (int g = 0; g < 2000; ++g)
+	{
+		request.speed = speed(g);
+		const auto inputChunk = stretcher.specifyGrain(request);
+
+		cache.grain(inputChunk, [&](float *data, int channelStride, int position, int frameCount) {
+			for (int c = 0; c < channelCount; ++c)
+				for (int i = 0; i < frameCount; ++i)
+					data[c * channelStride + i] = source(position + i, c);
+		});
+
+		for (int c = 0; c < channelCount; ++c)
+			for (int i = inputChunk.begin; i < inputChunk.end; ++i)
+				exact = exact && cache.outputData()[c * cache.stride() + i - inputChunk.begin] == source(i, c);
+
+		naive += inputChunk.end - inputChunk.begin;
+		if (g)
+			bound += std::min<long long>(inputChunk.end - inputChunk.begin, std::max(0, previous.begin - inputChunk.begin) + std::max(0, inputChunk.end - previous.end));
+		else
+			bound += inputChunk.end - inputChunk.begin;
+		previous = inputChunk;
+
+		stretcher.analyseGrain(cache.outputData(), cache.stride());
+		OutputChunk outputChunk;
+		stretcher.synthesiseGrain(outputChunk);
+		stretcher.next(request);
+	}
+
+	report.measured.emplace_back("fetchedFraction", double(cache.fetchedFrameCount()) / naive);
+	if (!exact)
+		report.fail("cached input differs from the source");
+	if (cache.fetchedFrameCount() > bound)
+		report.fail("fetched " + std::to_string(cache.fetchedFrameCount()) + " frames, more than the " + std::to_string(bound) + " outside previous grains");
+}
+
+// Amplitude envelope of a synthetic vowel: three formant resonances over a floor
+static double vowelEnvelope(double frequency)
+{
+	static const double formants[3][3] = {{700., 110., 1.}, {1220., 120., 0.5}, {2600., 170., 0.25}}; // Hz, bandwidth Hz, gain
+	double a = 0.003;
+	for (const auto &[centre, bandwidth, gain] : formants)
+		a += gain / std::sqrt(1. + std::pow((frequency - centre) / (bandwidth / 2), 2));
+	return a;
+}
+
+// RMS level, in dB, of the harmonics of a vowel of fundamental f0 pitch-shifted by the given semitones, relative to the
+// vowel's envelope at their new frequencies after removing the mean difference: low when formants are preserved
+static double formantDeviation(double f0, double semitones, ResampleMode resampleMode, bool preserve)
+{
+	const int sampleRate = 44100, frameCount = 2 * sampleRate;
+	std::vector<float> input(frameCount);
+	for (int k = 1; k * f0 < 8000.; ++k)
+		for (int i = 0; i < frameCount; ++i)
+			input[i] += float(0.05 * vowelEnvelope(k * f0) * std::sin(2 * std::numbers::pi * k * f0 * i / sampleRate + k * k));
+
+	Stretcher<Basic> stretcher({sampleRate, sampleRate}, 1);
+	stretcher.enableFormantPreservation(preserve);
+
+	Request request{};
+	request.speed = 1.;
+	request.pitch = std::pow(2., semitones / 12);
+	request.resampleMode = resampleMode;
+	stretcher.preroll(request);
+
+	std::vector<float> output, buffer;
+	while (request.position < frameCount)
+	{
+		const auto inputChunk = stretcher.specifyGrain(request);
+		buffer.assign(inputChunk.end - inputChunk.begin, 0.f);
+		for (int i = std::max(inputChunk.begin, 0); i < std::min(inputChunk.end, frameCount); ++i)
+			buffer[i - inputChunk.begin] = input[i];
+		stretcher.analyseGrain(buffer.data(), (intptr_t)buffer.size());
+
+		OutputChunk outputChunk;
+		stretcher.synthesiseGrain(outputChunk);
+		output.insert(output.end(), outputChunk.data, outputChunk.data + outputChunk.frameCount);
+		stretcher.next(request);
+	}
+
+	// Levels of the shifted harmonics over a steady, Hann-windowed second
+	std::vector<double> difference;
+	double mean = 0.;
+	for (int k = 1; k * f0 * request.pitch < 4000.; ++k)
+	{
+		const double frequency = k * f0 * request.pitch;
+		std::complex<double> sum;
+		for (int i = 0; i < sampleRate; ++i)
+		{
+			const double window = 0.5 - 0.5 * std::cos(2 * std::numbers::pi * i / sampleRate);
+			sum += window * output[sampleRate / 2 + i] * std::polar(1., 2 * std::numbers::pi * frequency * i / sampleRate);
+		}
+		difference.push_back(20 * std::log10(std::abs(sum) + 1e-12) - 20 * std::log10(vowelEnvelope(frequency)));
+		mean += difference.back();
+	}
+	mean /= difference.size();
+
+	double sumSquares = 0.;
+	for (auto d : difference)
+		sumSquares += (d - mean) * (d - mean);
+	return std::sqrt(sumSquares / difference.size());
+}
+
+// Formant preservation must keep the harmonics of pitch-shifted vowels near their original envelope, in both resample
+// modes. Reports the greatest deviation with preservation and the least without it.
+static void checkFormants(Report &report)
+{
+	double preserved = 0., uncorrected = std::numeric_limits<double>::infinity();
+	for (double f0 : {140., 220.})
+		for (double semitones : {-7., -4., 4., 7.})
+			for (auto resampleMode : {resampleMode_autoOut, resampleMode_forceIn})
+			{
+				const auto on = formantDeviation(f0, semitones, resampleMode, true);
+				const auto off = formantDeviation(f0, semitones, resampleMode, false);
+				preserved = std::max(preserved, on);
+				uncorrected = std::min(uncorrected, off);
+				if (!(on <= 3.) || !(on < off))
+				{
+					std::ostringstream failure;
+					failure << "f0 " << f0 << " Hz shifted " << semitones << " semitones (" << modeName(resampleMode) << "): " << on << " dB from envelope with preservation, " << off << " dB without";
+					report.fail(failure.str());
+				}
+			}
+	report.measured.emplace_back("preservedDbMax", preserved);
+	report.measured.emplace_back("uncorrectedDbMin", uncorrected);
+}
+
+static const char *fftBackendName(FftBackend backend)
+{
+#define X_FFT(backend_, description) \
+	if (backend == fftBackend_##backend_) \
+		return #backend_;
+	BUNGEE_FFT_BACKENDS
+#undef X_FFT
+	return "fastest";
+}
+
+// Planar output of a stretcher of the given channel groups for planar input of channels [begin, end)
+static std::vector<float> renderGroups(const std::vector<float> &input, int inputFrameCount, int begin, int end, const std::vector<int> &groups, Request request, bool preserveFormants, FftBackend fftBackend)
+{
+	const int channelCount = end - begin;
+	Stretcher<Basic> stretcher({44100, 44100}, channelCount);
+	stretcher.setFftBackend(fftBackend);
+	stretcher.enableFormantPreservation(preserveFormants);
+	if (!stretcher.setChannelGroups(groups.data(), (int)groups.size()))
+		fail("could not set channel groups");
+	stretcher.preroll(request);
+
+	std::vector<std::vector<float>> output(channelCount);
+	std::vector<float> buffer;
+	while (request.speed < 0 ? request.position >= 0 : request.position < inputFrameCount)
+	{
+		const auto inputChunk = stretcher.specifyGrain(request);
+		const int frameCount = inputChunk.end - inputChunk.begin;
+		buffer.assign(size_t(frameCount) * channelCount, 0.f);
+		for (int c = 0; c < channelCount; ++c)
+			for (int i = std::max(inputChunk.begin, 0); i < std::min(inputChunk.end, inputFrameCount); ++i)
+				buffer[size_t(c) * frameCount + i - inputChunk.begin] = input[size_t(begin + c) * inputFrameCount + i];
+		stretcher.analyseGrain(buffer.data(), frameCount);
+
+		OutputChunk outputChunk;
+		stretcher.synthesiseGrain(outputChunk);
+		for (int c = 0; c < channelCount; ++c)
+			for (int i = 0; i < outputChunk.frameCount; ++i)
+				output[c].push_back(outputChunk.data[i + c * outputChunk.channelStride]);
+		stretcher.next(request);
+	}
+
+	std::vector<float> planar;
+	for (const auto &channel : output)
+		planar.insert(planar.end(), channel.begin(), channel.end());
+	return planar;
+}
+
+// Each channel group must render bit-exactly as a stretcher of just its channels would, whether stretching, shifting
+// pitch, reversing or preserving formants, and whether the FFT backend transforms channels one by one or in lanes
+static void checkChannelGroups(Report &report)
+{
+	const int channelCount = 4, inputFrameCount = 44100;
+	const auto input = synthesiseInput(tones, 44100, channelCount, inputFrameCount);
+
+	for (auto fftBackend : {fftBackend_pffft, fftBackend_lanes})
+		for (const auto &groups : {std::vector<int>{2, 2}, std::vector<int>{1, 1, 1, 1}, std::vector<int>{1, 3}})
+			for (int variant = 0; variant < 4; ++variant)
+			{
+				Request request{};
+				request.speed = variant == 2 ? -0.8 : 0.75;
+				request.pitch = variant ? std::pow(2., 3. / 12) : 1.;
+				request.position = request.speed < 0 ? inputFrameCount - 1 : 0.;
+				const bool preserveFormants = variant == 3;
+
+				const auto grouped = renderGroups(input, inputFrameCount, 0, channelCount, groups, request, preserveFormants, fftBackend);
+
+				std::vector<float> separate;
+				for (int g = 0, begin = 0; g < (int)groups.size(); begin += groups[g++])
+				{
+					const auto part = renderGroups(input, inputFrameCount, begin, begin + groups[g], {}, request, preserveFormants, fftBackend);
+					separate.insert(separate.end(), part.begin(), part.end());
+				}
+
+				if (grouped != separate)
+				{
+					std::ostringstream failure;
+					failure << fftBackendName(fftBackend) << ", groups";
+					for (auto count : groups)
+						failure << " " << count;
+					failure << ", speed " << request.speed << ", pitch " << request.pitch << (preserveFormants ? ", preserving formants" : "") << ": output differs from separate stretchers";
+					report.fail(failure.str());
+				}
+			}
+}
+
+// Tracked partials must render as enumerated partials do, to within the difference another FFT backend makes, and must
+// cost less than enumeration where the spectrum is sparse and stationary
+static void checkPartialTracking(Report &report)
+{
+	const int sampleRate = 44100, inputFrameCount = 4 * sampleRate;
+	for (auto signal : {sine, tones, speech, transients})
+	{
+		const auto input = synthesiseInput(signal, sampleRate, 2, inputFrameCount);
+		Configuration configuration{signal, sampleRate, 2, 0, 0.75, 3., resampleMode_autoOut, interpolationMode_bilinear, fftBackend_pffft};
+
+		std::vector<float> enumerated, tracked, lanes;
+		const auto full = run(configuration, input, inputFrameCount, false, &enumerated);
+		configuration.partialTracking = true;
+		const auto incremental = run(configuration, input, inputFrameCount, false, &tracked);
+		configuration.partialTracking = false;
+		configuration.fftBackend = fftBackend_lanes;
+		run(configuration, input, inputFrameCount, false, &lanes);
+
+		const auto partialNanoseconds = [](const Result &result) {
+			const auto &phases = result.stats.phases;
+			return double(phases[statsPhase_enumeratePartials].totalNanoseconds + phases[statsPhase_suppressTransientPartials].totalNanoseconds) / result.grainCount;
+		};
+
+		const auto name = std::string(signalNames[signal]);
+		const double trackedDb = spectralDistance(tracked, enumerated, 2);
+		const double lanesDb = spectralDistance(lanes, enumerated, 2);
+		report.measured.emplace_back(name + "EnumeratedNs", partialNanoseconds(full));
+		report.measured.emplace_back(name + "TrackedNs", partialNanoseconds(incremental));
+		report.measured.emplace_back(name + "TrackedDb", trackedDb);
+		report.measured.emplace_back(name + "LanesDb", lanesDb);
+
+		if (trackedDb > std::max(2 * lanesDb, 0.1))
+			report.fail(name + " tracked " + std::to_string(trackedDb) + " dB from enumerated output");
+		if (signal == sine && !(partialNanoseconds(incremental) * 4 < partialNanoseconds(full)))
+			report.fail("sine partials tracked less than four times faster than enumerated");
+	}
+}
+
+// A stretcher restored from a snapshot taken mid-stream must continue byte-identically to an uninterrupted stretcher,
+// with or without pipelining, and restore() must reject truncated or corrupted snapshots without changing any state
+static void checkSnapshot(Report &report)
+{
+	const int sampleRate = 44100, channelCount = 2, inputFrameCount = 4 * sampleRate;
+	const int grainCount = 300, snapshotGrainCount = 120;
+	const auto input = synthesiseInput(tones, sampleRate, channelCount, inputFrameCount);
+
+	std::vector<float> buffer;
+	const auto grain = [&](Stretcher<Basic> &stretcher, Request &request, std::vector<float> &output) {
+		const auto inputChunk = stretcher.specifyGrain(request);
+		const int frameCount = inputChunk.end - inputChunk.begin;
+		buffer.assign(size_t(frameCount) * channelCount, 0.f);
+		for (int c = 0; c < channelCount; ++c)
+			for (int i = std::max(inputChunk.begin, 0); i < std::min(inputChunk.end, inputFrameCount); ++i)
+				buffer[size_t(c) * frameCount + i - inputChunk.begin] = input[size_t(c) * inputFrameCount + i];
+		stretcher.analyseGrain(buffer.data(), frameCount);
+
+		OutputChunk outputChunk;
+		stretcher.synthesiseGrain(outputChunk);
+		for (int i = 0; i < outputChunk.frameCount; ++i)
+			for (int c = 0; c < channelCount; ++c)
+				output.push_back(outputChunk.data[i + c * outputChunk.channelStride]);
+		stretcher.next(request);
+	};
+
+	const auto identical = [](const std::vector<float> &a, const std::vector<float> &b) {
+		return a.size() == b.size() && !std::memcmp(a.data(), b.data(), a.size() * sizeof(float));
+	};
+
+	for (bool pipelined : {false, true})
+	{
+		const std::string name = pipelined ? "pipelined" : "plain";
+		const SampleRates sampleRates{sampleRate, 48000};
+		Stretcher<Basic> uninterrupted(sampleRates, channelCount), interrupted(sampleRates, channelCount), restored(sampleRates, channelCount);
+		for (auto *stretcher : {&uninterrupted, &interrupted, &restored})
+			stretcher->enablePipelining(pipelined);
+
+		Request request{};
+		request.position = 0.;
+		request.speed = 0.75;
+		request.pitch = std::pow(2., 3. / 12);
+		request.resampleMode = resampleMode_autoOut;
+
+		std::vector<float> expected;
+		{
+			auto r = request;
+			uninterrupted.preroll(r);
+			for (int g = 0; g < grainCount; ++g)
+				grain(uninterrupted, r, expected);
+		}
+
+		std::vector<float> head;
+		interrupted.preroll(request);
+		for (int g = 0; g < snapshotGrainCount; ++g)
+			grain(interrupted, request, head);
+
+		std::vector<std::byte> snapshot(interrupted.snapshot(nullptr, 0));
+		interrupted.snapshot(snapshot.data(), snapshot.size());
+		report.measured.emplace_back(name + "SnapshotBytes", double(snapshot.size()));
+
+		// The header is the snapshot's first words: a magic number and the format version
+		std::vector<std::byte> truncated(snapshot.begin(), snapshot.end() - 1), badMagic(snapshot), badFormat(snapshot);
+		badMagic[0] ^= std::byte{1};
+		badFormat[4] ^= std::byte{1};
+		for (const auto *bad : {&truncated, &badMagic, &badFormat})
+			if (interrupted.restore(bad->data(), bad->size()))
+				report.fail(name + ": restored a " + (bad == &truncated ? "truncated" : "corrupted") + " snapshot");
+
+		std::vector<std::byte> after(snapshot.size());
+		if (interrupted.snapshot(after.data(), after.size()) != (intptr_t)snapshot.size() || after != snapshot)
+			report.fail(name + ": rejected snapshots changed the stretcher's state");
+
+		if (!restored.restore(snapshot.data(), snapshot.size()))
+			report.fail(name + ": could not restore a snapshot into a fresh stretcher");
+
+		// Both continue with the request that followed the snapshot
+		auto continuing = head, resumed = head;
+		{
+			auto r = request;
+			for (int g = snapshotGrainCount; g < grainCount; ++g)
+				grain(interrupted, r, continuing);
+		}
+		for (int g = snapshotGrainCount; g < grainCount; ++g)
+			grain(restored, request, resumed);
+
+		if (!identical(resumed, expected))
+			report.fail(name + ": restored output differs from uninterrupted output");
+		if (!identical(continuing, expected))
+			report.fail(name + ": output after rejected snapshots differs from uninterrupted output");
+	}
+}
+
+// Behavioural checks, run by --check in place of the sweep
+struct Check
+{
+	const char *name;
+	void (*function)(Report &report);
+};
+
+static const Check checks[] = {
+	{"mute-multi-resolution", [](Report &r) { checkMute(r, [](Internal::Stretcher &s) { s.enableMultiResolution(true); }, burstAtEnd()); }},
+	{"mute-low-latency", [](Report &r) { checkMute(r, [](Internal::Stretcher &s) { s.enableLowLatency(true); }, burstAtEnd()); }},
+	{"pull-forward", [](Report &r) { checkPull(r, [](int) { return 1.; }); }},
+	{"pull-reverse", [](Report &r) { checkPull(r, [](int) { return -1.; }); }},
+	{"pull-freeze", [](Report &r) { checkPull(r, [](int) { return 0.; }); }},
+	{"pull-scrub", [](Report &r) { checkPull(r, [](int g) { return 2. * std::sin(0.01 * g); }); }},
+	{"formant-preservation", checkFormants},
+	{"channel-groups", checkChannelGroups},
+	{"partial-tracking", checkPartialTracking},
+	{"snapshot", checkSnapshot},
+};
+
+} // namespace
+
+int main(int argc, const char *argv[])
+{
+	cxxopts::Options options("bungee_benchmark", "Bungee benchmark: sweeps stretcher configurations and reports performance as JSON\n");
+
+	std::vector<std::string> helpGroups;
+	options.add_options(helpGroups.emplace_back("Sweep")) //
+		("signal", "comma-separated synthetic input signals [tones|sine|chirp|speech|transients]", cxxopts::value<std::string>()->default_value("tones")) //
+		("rate", "comma-separated sample rates, Hz", cxxopts::value<std::string>()->default_value("44100,48000")) //
+		("channels", "comma-separated channel counts", cxxopts::value<std::string>()->default_value("1,2")) //
+		("grain", "comma-separated grain duration adjustments", cxxopts::value<std::string>()->default_value("-1,0,1")) //
+		("speed", "comma-separated speeds", cxxopts::value<std::string>()->default_value("0.5,1,1.5")) //
+		("pitch", "comma-separated pitch shifts in semitones", cxxopts::value<std::string>()->default_value("0,4")) //
+		("resample", "comma-separated resample modes", cxxopts::value<std::string>()->default_value("autoOut,forceIn")) //
+		("interpolation", "comma-separated interpolation modes", cxxopts::value<std::string>()->default_value("bilinear")) //
+		("fft", "comma-separated FFT backends, including 'fastest'", cxxopts::value<std::string>()->default_value("pffft")) //
+		;
+	options.add_options(helpGroups.emplace_back("Benchmark")) //
+		("duration", "duration of synthetic input audio, seconds", cxxopts::value<double>()->default_value("2")) //
+		("repeat", "number of timed runs of each configuration, of which the fastest is reported", cxxopts::value<int>()->default_value("3")) //
+		("output", "JSON output filename, or - for standard output", cxxopts::value<std::string>()->default_value("-")) //
+		("real-time", "enable real-time mode and fail if grains allocate, lock or make system calls (Linux only)") //
+		;
+	options.add_options(helpGroups.emplace_back("Regression")) //
+		("golden", "directory of golden outputs with which to compare each configuration", cxxopts::value<std::string>()) //
+		("record", "write the golden outputs and throughput of each configuration to the --golden directory instead") //
+		("min-snr", "least signal-to-noise ratio of output against golden output, dB", cxxopts::value<double>()->default_value("60")) //
+		("max-spectral-distance", "greatest log-spectral distance of output from golden output, dB", cxxopts::value<double>()->default_value("0.5")) //
+		("max-slowdown", "greatest fall in grains per second from golden throughput, over all configurations, as a fraction", cxxopts::value<double>()->default_value("0.1")) //
+		("check", "comma-separated behavioural checks to run instead of the sweep, or 'all'", cxxopts::value<std::string>()) //
+		;
+	options.add_options(helpGroups.emplace_back("Help")) //
+		("h,help", "display this message") //
+		;
+
+	const auto parameters = options.parse(argc, argv);
+
+	if (parameters.count("help"))
+	{
+		std::cout << options.help(helpGroups) << std::endl;
+		return 0;
+	}
+
+	if (!parameters.unmatched().empty())
+		fail("unrecognised command parameter(s)");
+
+	if (parameters.count("check"))
+	{
+		std::vector<const Check *> selected;
+		std::string item;
+		for (std::istringstream in(parameters["check"].as<std::string>()); std::getline(in, item, ',');)
+		{
+			const auto count = selected.size();
+			for (const auto &check : checks)
+				if (item == "all" || item == check.name)
+					selected.push_back(&check);
+			if (selected.size() == count)
+				fail("unrecognised value for --check: " + item);
+		}
+
+		int failureCount = 0;
+		std::cout << "{\n\t\"edition\": \"" << Stretcher<Basic>::edition() << "\",\n";
+		std::cout << "\t\"version\": \"" << Stretcher<Basic>::version() << "\",\n";
+		std::cout << "\t\"checks\": [";
+		const char *separator = "\n";
+		for (const auto *check : selected)
+		{
+			Report report;
+			check->function(report);
+			if (!report.failure.empty())
+			{
+				std::cerr << check->name << ": " << report.failure << "\n";
+				++failureCount;
+			}
+			std::cout << separator << "\t\t{\"name\": \"" << check->name << "\", \"pass\": " << (report.failure.empty() ? "true" : "false");
+			for (const auto &[name, value] : report.measured)
+				std::cout << ", \"" << name << "\": " << value;
+			std::cout << "}";
+			separator = ",\n";
+		}
+		std::cout << "\n\t]\n}\n";
+
+		if (failureCount)
+			fail(std::to_string(failureCount) + " checks failed");
+		return 0;
+	}
+
+	std::vector<Signal> signals;
+	{
+		std::string item;
+		for (std::istringstream in(parameters["signal"].as<std::string>()); std::getline(in, item, ',');)
+		{
+			int k = 0;
+			while (k < signalCount && item != signalNames[k])
+				++k;
+			if (k == signalCount)
+				fail("unrecognised value for --signal: " + item);
+			signals.push_back(Signal(k));
+		}
+	}
+
+	const auto sampleRates = parseList<int>("rate", parameters["rate"].as<std::string>());
+	const auto channelCounts = parseList<int>("channels", parameters["channels"].as<std::string>());
+	const auto grains = parseList<int>("grain", parameters["grain"].as<std::string>());
+	const auto speeds = parseList<double>("speed", parameters["speed"].as<std::string>());
+	const auto pitches = parseList<double>("pitch", parameters["pitch"].as<std::string>());
+
+	std::vector<ResampleMode> resampleModes;
+	std::vector<InterpolationMode> interpolationModes;
+	{
+		std::string item;
+
+#define X_BEGIN(Type, type) \
+	for (std::istringstream in(parameters[#type].as<std::string>()); std::getline(in, item, ',');) \
+	{ \
+		if (false) \
+		{ \
+		}
+#define X_ITEM(Type, type, mode, description) \
+		else if (item == #mode) \
+		{ \
+			type##Modes.push_back(type##Mode_##mode); \
+		}
+#define X_END(Type, type) \
+		else \
+		{ \
+			fail("unrecognised value for --" #type ": " + item); \
+		} \
+	}
+
+		BUNGEE_MODES
+
+#undef X_BEGIN
+#undef X_ITEM
+#undef X_END
+	}
+
+	std::vector<FftBackend> fftBackends;
+	{
+		std::string item;
+		for (std::istringstream in(parameters["fft"].as<std::string>()); std::getline(in, item, ',');)
+		{
+			int b = 0;
+			while (b <= fftBackend_fastest && item != fftBackendName(FftBackend(b)))
+				++b;
+			if (b > fftBackend_fastest)
+				fail("unrecognised value for --fft: " + item);
+			const auto backend = FftBackend(b);
+			if (!Fourier::Transforms().select(backend))
+				fail("FFT backend not included in this build: " + item);
+			fftBackends.push_back(backend);
+		}
+	}
+
+	for (auto sampleRate : sampleRates)
+		if (sampleRate < 8000 || sampleRate > 192000)
+			fail("rate is outside of the range 8000 to 192000");
+	for (auto channelCount : channelCounts)
+		if (channelCount < 1 || channelCount > 64)
+			fail("channels is outside of the range 1 to 64");
+	for (auto grain : grains)
+		if (std::abs(grain) > 1)
+			fail("grain is outside of the range -1 to +1");
+	for (auto speed : speeds)
+		if (!speed || std::abs(speed) > 100.)
+			fail("speed must be non-zero and within the range -100 to +100");
+	for (auto semitones : pitches)
+		if (semitones < -48. || semitones > +48.)
+			fail("pitch is outside of the range -48 to +48");
+
+	const auto duration = parameters["duration"].as<double>();
+	if (!(duration > 0.) || duration > 600.)
+		fail("duration is outside of the range 0 to 600 seconds");
+
+	const int repeatCount = parameters["repeat"].as<int>();
+	if (repeatCount < 1)
+		fail("repeat must be at least 1");
+
+	const bool realTime = parameters.count("real-time");
+	if (realTime && !Interpose::supported)
+		fail("--real-time needs C library interposition, which this platform does not support");
+	uint64_t realTimeViolations = 0;
+
+	const std::string goldenDirectory = parameters.count("golden") ? parameters["golden"].as<std::string>() : "";
+	const bool record = parameters.count("record");
+	if (record && goldenDirectory.empty())
+		fail("--record needs a --golden directory");
+	if (record)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(goldenDirectory, error);
+		if (error)
+			fail("could not create the --golden directory");
+	}
+	const auto minSnr = parameters["min-snr"].as<double>();
+	const auto maxSpectralDistance = parameters["max-spectral-distance"].as<double>();
+	const auto maxSlowdown = parameters["max-slowdown"].as<double>();
+	int goldenFailures = 0;
+
+	// Throughput is gated over all configurations, by the geometric mean of their speedups, as one configuration's
+	// timing is too noisy to gate alone
+	double sumLogSpeedup = 0.;
+	int speedupCount = 0;
+
+	std::ofstream outputFile;
+	std::ostream *output = &std::cout;
+	if (parameters["output"].as<std::string>() != "-")
+	{
+		outputFile.open(parameters["output"].as<std::string>());
+		if (!outputFile)
+			fail("could not open the output file");
+		output = &outputFile;
+	}
+
+	auto &json = *output;
+	json.precision(9);
+	json << "{\n";
+	json << "\t\"edition\": \"" << Stretcher<Basic>::edition() << "\",\n";
+	json << "\t\"version\": \"" << Stretcher<Basic>::version() << "\",\n";
+	json << "\t\"durationSeconds\": " << duration << ",\n";
+	json << "\t\"repeat\": " << repeatCount << ",\n";
+	json << "\t\"units\": \"stages and phases in nanoseconds per grain\",\n";
+	json << "\t\"results\": [";
+
+	const char *separator = "\n";
+	for (auto signal : signals)
+		for (auto sampleRate : sampleRates)
+			for (auto channelCount : channelCounts)
+			{
+				const int inputFrameCount = (int)std::round(duration * sampleRate);
+				const auto input = synthesiseInput(signal, sampleRate, channelCount, inputFrameCount);
+
+				for (auto grain : grains)
+					for (auto speed : speeds)
+						for (auto semitones : pitches)
+							for (auto resampleMode : resampleModes)
+								for (auto interpolationMode : interpolationModes)
+									for (auto fftBackend : fftBackends)
+									{
+										const Configuration configuration{signal, sampleRate, channelCount, grain, speed, semitones, resampleMode, interpolationMode, fftBackend};
+
+										// An untimed run warms caches and shared kernels, and captures output for any golden comparison
+										std::vector<float> output;
+										run(configuration, input, inputFrameCount, realTime, goldenDirectory.empty() ? nullptr : &output);
+
+										Result best;
+										for (int r = 0; r < repeatCount; ++r)
+										{
+											const auto result = run(configuration, input, inputFrameCount, realTime);
+											if (r == 0 || result.seconds < best.seconds)
+												best = result;
+											if (result.realTime.total())
+											{
+												if (!realTimeViolations)
+													std::cerr << "Real-time violation: grain called " << result.realTime.first << "()\n";
+												realTimeViolations += result.realTime.total();
+												best.realTime = result.realTime;
+											}
+										}
+
+										const auto outputSeconds = double(best.outputFrameCount) / sampleRate;
+
+										std::ostringstream name;
+										name << signalNames[signal] << "-" << sampleRate << "-" << channelCount << "ch-grain" << grain << "-speed" << speed << "-pitch" << semitones;
+										name << "-" << modeName(resampleMode) << "-" << modeName(interpolationMode) << "-" << fftBackendName(fftBackend);
+										const auto goldenFilename = goldenDirectory + "/" + name.str() + ".golden";
+
+										Golden golden;
+										bool goldenRead = false;
+										double snr = 0., distance = 0.;
+										bool pass = false;
+										if (record)
+										{
+											golden.grainsPerSecond = best.grainCount / best.seconds;
+											golden.output = output;
+											if (!golden.write(goldenFilename))
+												fail("could not write golden output " + goldenFilename);
+										}
+										else if (!goldenDirectory.empty())
+										{
+											goldenRead = golden.read(goldenFilename);
+											if (goldenRead)
+											{
+												snr = signalToNoise(output, golden.output);
+												distance = spectralDistance(output, golden.output, channelCount);
+												sumLogSpeedup += std::log(best.grainCount / best.seconds / golden.grainsPerSecond);
+												++speedupCount;
+											}
+											pass = goldenRead && output.size() == golden.output.size() && snr >= minSnr && distance <= maxSpectralDistance;
+											if (!pass)
+											{
+												++goldenFailures;
+												std::cerr << name.str() << ": ";
+												if (!goldenRead)
+													std::cerr << "no golden output\n";
+												else
+													std::cerr << "output outside tolerance: " << output.size() << " samples against " << golden.output.size() << ", SNR " << snr << " dB, spectral distance " << distance << " dB\n";
+											}
+										}
+
+										json << separator;
+										json << "\t\t{\"signal\": \"" << signalNames[signal] << "\"";
+										json << ", \"sampleRate\": " << sampleRate;
+										json << ", \"channelCount\": " << channelCount;
+										json << ", \"grain\": " << grain;
+										json << ", \"speed\": " << speed;
+										json << ", \"pitch\": " << semitones;
+										json << ", \"resample\": \"" << modeName(resampleMode) << "\"";
+										json << ", \"interpolation\": \"" << modeName(interpolationMode) << "\"";
+										json << ", \"fft\": \"" << fftBackendName(fftBackend) << "\"";
+										json << ", \"fftSelected\": \"" << fftBackendName(best.fftBackend) << "\"";
+										json << ", \"grainCount\": " << best.grainCount;
+										json << ", \"seconds\": " << best.seconds;
+										json << ", \"grainsPerSecond\": " << best.grainCount / best.seconds;
+										json << ", \"realtimeFactor\": " << outputSeconds / best.seconds;
+										if (!record && !goldenDirectory.empty())
+										{
+											json << ", \"golden\": {\"found\": " << (goldenRead ? "true" : "false");
+											if (goldenRead)
+											{
+												json << ", \"snrDb\": " << snr;
+												json << ", \"spectralDistanceDb\": " << distance;
+												json << ", \"grainsPerSecond\": " << golden.grainsPerSecond;
+												json << ", \"speedup\": " << best.grainCount / best.seconds / golden.grainsPerSecond;
+											}
+											json << ", \"pass\": " << (pass ? "true" : "false") << "}";
+										}
+										if (realTime)
+										{
+											json << ", \"realTime\": {\"allocations\": " << best.realTime.allocations;
+											json << ", \"locks\": " << best.realTime.locks;
+											json << ", \"systemCalls\": " << best.realTime.systemCalls << "}";
+										}
+										json << ", \"stages\": {";
+										for (int s = 0; s < stageCount; ++s)
+											json << (s ? ", \"" : "\"") << stageNames[s] << "\": " << 1e9 * best.stageSeconds[s] / best.grainCount;
+										json << "}, \"phases\": {";
+										const char *comma = "";
+#define X_PHASE(phase, description) \
+	json << comma << "\"" #phase "\": " << double(best.stats.phases[statsPhase_##phase].totalNanoseconds) / best.grainCount; \
+	comma = ", ";
+										BUNGEE_STATS_PHASES
+#undef X_PHASE
+										json << "}}";
+										separator = ",\n";
+									}
+			}
+
+	json << "\n\t]";
+	const double speedup = speedupCount ? std::exp(sumLogSpeedup / speedupCount) : 1.;
+	if (speedupCount)
+		json << ",\n\t\"goldenSpeedup\": " << speedup;
+	json << "\n}\n";
+
+	if (!json.flush())
+		fail("could not write the output");
+
+	if (goldenFailures)
+		fail(std::to_string(goldenFailures) + " configurations are outside tolerance of their golden outputs");
+
+	if (speedup < 1. - maxSlowdown)
+		fail("throughput is " + std::to_string(speedup) + " times that of the golden outputs");
+
+	if (realTimeViolations)
+		fail(std::to_string(realTimeViolations) + " allocations, locks or system calls were made by grains in real-time mode");
+
+	return 0;
+}
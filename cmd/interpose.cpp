@@ -0,0 +1,190 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#include "interpose.h"
+
+#include <atomic>
+#include <cstdarg>
+#include <cerrno>
+#include <cstddef>
+
+#if defined(__GLIBC__)
+#	include <dlfcn.h>
+#	include <malloc.h>
+#	include <pthread.h>
+#	include <sched.h>
+#	include <semaphore.h>
+#	include <stdio.h>
+#	include <stdlib.h>
+#	include <time.h>
+#	include <unistd.h>
+#endif
+
+namespace Interpose {
+
+namespace {
+
+thread_local bool counting;
+thread_local Counts counts;
+
+inline void count(uint64_t Counts::*kind, const char *name)
+{
+	if (counting)
+	{
+		++(counts.*kind);
+		if (!counts.first)
+			counts.first = name;
+	}
+}
+
+} // namespace
+
+Scope::Scope(bool armed) :
+	armed(armed)
+{
+	if (armed)
+		counting = true;
+}
+
+Scope::~Scope()
+{
+	if (armed)
+		counting = false;
+}
+
+Counts take()
+{
+	const auto taken = counts;
+	counts = {};
+	return taken;
+}
+
+#if defined(__GLIBC__)
+
+const bool supported = true;
+
+namespace {
+
+// The next definition of a function, that of the C library, resolved on first use
+template <class F>
+static F next(std::atomic<F> &f, const char *name)
+{
+	auto p = f.load(std::memory_order_relaxed);
+	if (!p)
+		f.store(p = reinterpret_cast<F>(dlsym(RTLD_NEXT, name)), std::memory_order_relaxed);
+	return p;
+}
+
+} // namespace
+
+} // namespace Interpose
+
+using Interpose::count;
+using Interpose::Counts;
+
+// Allocation forwards to glibc's own allocator entry points, rather than to functions found by dlsym(), which may allocate
+extern "C" {
+
+void *__libc_malloc(size_t size) __THROW;
+void *__libc_calloc(size_t count, size_t size) __THROW;
+void *__libc_realloc(void *p, size_t size) __THROW;
+void *__libc_memalign(size_t alignment, size_t size) __THROW;
+void __libc_free(void *p) __THROW;
+
+void *malloc(size_t size) __THROW
+{
+	count(&Counts::allocations, "malloc");
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) __THROW
+{
+	count(&Counts::allocations, "calloc");
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) __THROW
+{
+	count(&Counts::allocations, "realloc");
+	return __libc_realloc(p, size);
+}
+
+void *memalign(size_t alignment, size_t size) __THROW
+{
+	count(&Counts::allocations, "memalign");
+	return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) __THROW
+{
+	count(&Counts::allocations, "aligned_alloc");
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **p, size_t alignment, size_t size) __THROW
+{
+	count(&Counts::allocations, "posix_memalign");
+	*p = __libc_memalign(alignment, size);
+	return *p ? 0 : ENOMEM;
+}
+
+void free(void *p) __THROW
+{
+	if (p)
+		count(&Counts::allocations, "free");
+	__libc_free(p);
+}
+
+#	define BUNGEE_INTERPOSE(kind, result, name, parameters, arguments, ...) \
+		result name parameters __VA_ARGS__ \
+		{ \
+			static std::atomic<result(*) parameters> f; \
+			count(&Counts::kind, #name); \
+			return Interpose::next(f, #name) arguments; \
+		}
+
+BUNGEE_INTERPOSE(locks, int, pthread_mutex_lock, (pthread_mutex_t * mutex), (mutex), __THROWNL)
+BUNGEE_INTERPOSE(locks, int, pthread_mutex_trylock, (pthread_mutex_t * mutex), (mutex), __THROWNL)
+BUNGEE_INTERPOSE(locks, int, pthread_rwlock_rdlock, (pthread_rwlock_t * lock), (lock), __THROWNL)
+BUNGEE_INTERPOSE(locks, int, pthread_rwlock_wrlock, (pthread_rwlock_t * lock), (lock), __THROWNL)
+BUNGEE_INTERPOSE(locks, int, pthread_cond_wait, (pthread_cond_t * condition, pthread_mutex_t * mutex), (condition, mutex))
+BUNGEE_INTERPOSE(locks, int, sem_wait, (sem_t * semaphore), (semaphore))
+
+BUNGEE_INTERPOSE(systemCalls, ssize_t, write, (int fd, const void *data, size_t size), (fd, data, size))
+BUNGEE_INTERPOSE(systemCalls, size_t, fwrite, (const void *data, size_t size, size_t n, FILE *file), (data, size, n, file))
+BUNGEE_INTERPOSE(systemCalls, int, fputs, (const char *s, FILE *file), (s, file))
+BUNGEE_INTERPOSE(systemCalls, int, vfprintf, (FILE * file, const char *format, va_list args), (file, format, args))
+BUNGEE_INTERPOSE(systemCalls, int, sched_yield, (), (), __THROW)
+
+int fprintf(FILE *file, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	const int result = vfprintf(file, format, args);
+	va_end(args);
+	return result;
+}
+
+// Takes as many arguments as any system call may have
+long syscall(long number, ...) __THROW
+{
+	static std::atomic<long (*)(long, ...)> f;
+	va_list args;
+	va_start(args, number);
+	long a[6];
+	for (auto &x : a)
+		x = va_arg(args, long);
+	va_end(args);
+	count(&Counts::systemCalls, "syscall");
+	return Interpose::next(f, "syscall")(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+} // extern "C"
+
+#else
+
+const bool supported = false;
+
+} // namespace Interpose
+
+#endif
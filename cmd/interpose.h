@@ -0,0 +1,41 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <cstdint>
+
+// Counts calls that real-time code must not make, by interposing the C library functions that make them.
+// Only calls by a thread within a Scope are counted. Interposition is supported on Linux with glibc, where it
+// catches calls from the program and its libraries, but not calls within the C library itself. Reads of the
+// clock are not counted, as they are served in user space by the vDSO.
+namespace Interpose {
+
+struct Counts
+{
+	uint64_t allocations; // malloc(), free() and relatives, which operator new and delete also call
+	uint64_t locks; // locks of mutexes and read-write locks, and waits on condition variables and semaphores
+	uint64_t systemCalls; // syscall(), by which the C++ library waits for and wakes threads, writes and yields
+	const char *first; // name of the first function counted
+
+	inline uint64_t total() const
+	{
+		return allocations + locks + systemCalls;
+	}
+};
+
+extern const bool supported;
+
+// Counts calls of the current thread during its lifetime, if armed
+struct Scope
+{
+	const bool armed;
+
+	Scope(bool armed);
+	~Scope();
+};
+
+// Returns and clears the counts of the current thread
+Counts take();
+
+} // namespace Interpose
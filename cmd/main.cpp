@@ -3,6 +3,7 @@
 
 #include <bungee/Bungee.h>
 #include <bungee/CommandLine.h>
+#include <bungee/Offline.h>
 #include <bungee/Stream.h>
 
 int main(int argc, const char *argv[])
@@ -20,14 +21,66 @@ int main(int argc, const char *argv[])
 
 	CommandLine::Options options{"<bungee-command>", helpString};
 	CommandLine::Parameters parameters{options, argc, argv, request};
+
+	if (!Bungee::Stretcher<Edition>::setDefaultFftBackend(parameters.fftBackend))
+		CommandLine::fail("the FFT backend selected by --fft is not included in this build");
+
+	const auto configure = [&](Bungee::Stretcher<Edition> &stretcher) {
+		stretcher.enableInstrumentation(parameters["instrumentation"].count() != 0);
+		stretcher.enableMultiResolution(parameters["multi-resolution"].count() != 0);
+		stretcher.enableLowLatency(parameters["low-latency"].count() != 0);
+		stretcher.enableFormantPreservation(parameters["preserve-formants"].count() != 0);
+		stretcher.enablePartialTracking(parameters["track-partials"].count() != 0);
+		stretcher.setInterpolationMode(parameters.interpolationMode);
+		if (!stretcher.setChannelGroups(parameters.channelGroups.data(), (int)parameters.channelGroups.size()))
+			CommandLine::fail("the channel counts of --channel-groups do not sum to the input's channel count");
+	};
+
+	if (parameters.piped())
+	{
+		// This code demonstrates `Bungee::Stream` as a stage of a pipeline, for example between two FFmpeg processes,
+		// with reading and writing on their own threads so that throughput is limited by stretching, not by I/O.
+
+		CommandLine::Pipe pipe{parameters};
+
+		std::cerr << "Using Bungee::Stream in a pipeline with " << pipe.blockFrameCount << " frame blocks\n";
+
+		Bungee::Stretcher<Edition> stretcher(pipe.sampleRates, pipe.channelCount, parameters["grain"].as<int>());
+		configure(stretcher);
+		pipe.run(stretcher, request);
+
+		return 0;
+	}
+
 	CommandLine::Processor processor{parameters, request};
 
 	Bungee::Stretcher<Edition> stretcher(processor.sampleRates, processor.channelCount, parameters["grain"].as<int>());
+	configure(stretcher);
 
-	stretcher.enableInstrumentation(parameters["instrumentation"].count() != 0);
-
+	const int threadCount = parameters["threads"].as<int>();
 	const int pushSampleCount = parameters["push"].as<int>();
-	if (pushSampleCount)
+	if (threadCount > 1)
+	{
+		// This code demonstrates `Bungee::Offline::Renderer`, which renders a whole file in segments on several threads.
+
+		std::cerr << "Using Bungee::Offline::Renderer with " << threadCount << " threads\n";
+
+		const int outputFrameCount = processor.outputFrameCount;
+
+		CommandLine::Processor::OutputChunkBuffer outputChunkBuffer(outputFrameCount, processor.channelCount);
+
+		Offline::Renderer<Edition> renderer(processor.sampleRates, processor.channelCount, parameters["grain"].as<int>());
+		renderer.multiResolution = parameters["multi-resolution"].count() != 0;
+		renderer.lowLatency = parameters["low-latency"].count() != 0;
+		renderer.formantPreservation = parameters["preserve-formants"].count() != 0;
+		renderer.partialTracking = parameters["track-partials"].count() != 0;
+		renderer.interpolationMode = parameters.interpolationMode;
+		renderer.channelGroups = parameters.channelGroups;
+		renderer.render(request, threadCount, processor.inputBuffer.data(), processor.inputChannelStride, processor.inputFrameCount, outputChunkBuffer.audio.data(), outputChunkBuffer.channelStride, outputFrameCount);
+
+		processor.writeChunk(outputChunkBuffer.outputChunk(outputFrameCount, 0., processor.inputFrameCount));
+	}
+	else if (pushSampleCount)
 	{
 		// This code demonstrates the usage of the easier to use, positive-speed-only `Bungee::Stream` API.
 		// See the `else` branch for equivalent usage of the granular `Bungee::Stretcher` API.
@@ -35,9 +88,9 @@ int main(int argc, const char *argv[])
 		const auto maxSpeed = request.speed;
 
 		if (pushSampleCount < 0)
-			std::cout << "Using Bungee::Stream::process randomly with between 1 and " << -pushSampleCount << " samples per call\n";
+			std::cerr << "Using Bungee::Stream::process randomly with between 1 and " << -pushSampleCount << " samples per call\n";
 		else
-			std::cout << "Using Bungee::Stream::process with " << pushSampleCount << " samples per call\n";
+			std::cerr << "Using Bungee::Stream::process with " << pushSampleCount << " samples per call\n";
 
 		const int maxInputFrameCount = std::abs(pushSampleCount);
 		const int maxOutputSampleCount = std::ceil((maxInputFrameCount * processor.sampleRates.output) / (maxSpeed * processor.sampleRates.input));
@@ -72,7 +125,7 @@ int main(int argc, const char *argv[])
 			const auto outputFrameCountActual = stream.process(inputChannelPointers[0] ? inputChannelPointers.data() : nullptr, outputChunkBuffer.channelPointers.data(), inputSampleCount, outputFrameCountIdeal, request.pitch);
 
 			if (false)
-				std::cout << "current latency is " << stream.latency() / processor.sampleRates.input << "seconds\n";
+				std::cerr << "current latency is " << stream.latency() / processor.sampleRates.input << "seconds\n";
 
 			const auto positionEnd = stream.outputPosition();
 			const auto positionBegin = positionEnd - outputFrameCountActual * (request.speed * processor.sampleRates.input / (processor.sampleRates.output));
@@ -97,7 +150,9 @@ int main(int argc, const char *argv[])
 			const auto muteFrameCountHead = std::max(0, -inputChunk.begin);
 			const auto muteFrameCountTail = std::max(0, inputChunk.end - processor.inputFrameCount);
 
-			stretcher.analyseGrain(processor.getInputAudio(inputChunk), processor.inputChannelStride, muteFrameCountHead, muteFrameCountTail);
+			// When streaming, input audio is read from file only now, so get it before its channel stride
+			const float *inputAudio = processor.getInputAudio(inputChunk, stretcher.maxInputFrameCount());
+			stretcher.analyseGrain(inputAudio, processor.inputChannelStride, muteFrameCountHead, muteFrameCountTail);
 
 			OutputChunk outputChunk;
 			stretcher.synthesiseGrain(outputChunk);
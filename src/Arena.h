@@ -0,0 +1,146 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include "Assert.h"
+#include "bungee/Bungee.h"
+
+#include <Eigen/Core>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace Bungee {
+
+// An Eigen array whose storage is in an Arena: empty until allocated, and rebound rather than reallocated
+template <class Array>
+struct Mapped :
+	Eigen::Map<Array, Eigen::AlignedMax>
+{
+	typedef Eigen::Map<Array, Eigen::AlignedMax> Base;
+
+	Mapped() :
+		Base(nullptr, Array::RowsAtCompileTime == 1, Array::ColsAtCompileTime == 1)
+	{
+	}
+
+	Mapped(typename Array::Scalar *data, Eigen::Index rows, Eigen::Index cols) :
+		Base(data, rows, cols)
+	{
+	}
+
+	Mapped(const Mapped &) = default;
+
+	using Base::operator=;
+
+	inline Mapped &operator=(const Mapped &other)
+	{
+		Base::operator=(other);
+		return *this;
+	}
+
+	inline void rebind(typename Array::Scalar *data, Eigen::Index rows, Eigen::Index cols)
+	{
+		this->~Mapped();
+		new (this) Mapped(data, rows, cols);
+	}
+
+	// Exchanges storage, not elements
+	friend inline void swap(Mapped &a, Mapped &b)
+	{
+		Mapped t = a;
+		a.rebind(b.data(), b.rows(), b.cols());
+		b.rebind(t.data(), t.rows(), t.cols());
+	}
+};
+
+// A single aligned allocation holding all fixed-size buffers of a stretcher. The same code lays out the buffers
+// twice: first while measuring, when buffers are bound to null, and then into the allocated block, which comes
+// from the user's allocator if one was given.
+class Arena
+{
+	struct Free
+	{
+		Allocator allocator;
+		std::size_t size;
+
+		void operator()(std::byte *p) const
+		{
+			if (allocator.deallocate)
+				allocator.deallocate(allocator.context, p, size, alignment);
+			else
+				::operator delete[](p, std::align_val_t(alignment));
+		}
+	};
+
+	const Allocator allocator{};
+	std::unique_ptr<std::byte[], Free> block{nullptr, Free{}};
+	std::size_t size{};
+	std::size_t used{};
+
+public:
+	// Each buffer starts on its own cache line
+	static constexpr std::size_t alignment = 64;
+
+	// Uses allocator only if it provides both functions
+	explicit Arena(const Allocator *allocator = nullptr) :
+		allocator(allocator && allocator->allocate && allocator->deallocate ? *allocator : Allocator{})
+	{
+	}
+
+	inline bool measuring() const
+	{
+		return !block;
+	}
+
+	inline std::size_t bytes() const
+	{
+		return measuring() ? used : size;
+	}
+
+	// Ends measuring with the single allocation, after which the layout must be repeated
+	void allocate()
+	{
+		BUNGEE_ASSERT1(measuring());
+		size = used;
+		used = 0;
+		if (allocator.allocate)
+		{
+			const auto p = static_cast<std::byte *>(allocator.allocate(allocator.context, size, alignment));
+			if (!p)
+				throw std::bad_alloc();
+			BUNGEE_ASSERT1(reinterpret_cast<std::uintptr_t>(p) % alignment == 0);
+			block = decltype(block)(p, Free{allocator, size});
+		}
+		else
+			block.reset(new (std::align_val_t(alignment)) std::byte[size]);
+	}
+
+	// Binds array to the next rows by cols elements of the arena
+	template <class Array>
+	void allocate(Mapped<Array> &array, Eigen::Index rows, Eigen::Index cols = 1)
+	{
+		typedef typename Array::Scalar Scalar;
+		const std::size_t n = (rows * cols * sizeof(Scalar) + alignment - 1) / alignment * alignment;
+		BUNGEE_ASSERT1(measuring() || used + n <= size);
+		array.rebind(measuring() ? nullptr : reinterpret_cast<Scalar *>(block.get() + used), rows, cols);
+		used += n;
+	}
+
+	// Returns storage for n objects of trivial type T, or null while measuring
+	template <class T>
+	T *allocate(std::size_t n)
+	{
+		const std::size_t bytes = (n * sizeof(T) + alignment - 1) / alignment * alignment;
+		BUNGEE_ASSERT1(measuring() || used + bytes <= size);
+		T *p = measuring() ? nullptr : reinterpret_cast<T *>(block.get() + used);
+		used += bytes;
+		return p;
+	}
+};
+
+} // namespace Bungee
@@ -0,0 +1,67 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#include "Formant.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Bungee {
+
+namespace {
+// Energy below this is treated as this, so that silent bins do not pull the envelope to minus infinity
+static constexpr float floorEnergy = 1e-24f;
+
+// Corrections stay within ±24 dB, so that deep envelope nulls do not produce extreme gains
+static constexpr float maxLogGain = 2.77f;
+} // namespace
+
+void Formant::analyse(const Grain &grain, int group, double pitch)
+{
+	const int n = grain.validBinCount;
+	if (n < 2)
+	{
+		gain.head(n).setOnes();
+		return;
+	}
+
+	// Half width, in bins, of windows spanning about 170 Hz each side, whatever the transform length and sample rate
+	const int halfWidth = 1 << std::max(grain.log2TransformLength - 8, 0);
+
+	const auto &energy = grain.groups[group].energy;
+	for (int m = 0; m < n; ++m)
+		envelope[m] = std::log(energy[m] + floorEnergy);
+
+	// Upper hull: after these passes, envelope[m] is the maximum of log energy over bins [m, m + 2 * halfWidth)
+	for (int span = 1; span < 2 * halfWidth; span *= 2)
+		for (int m = 0; m + span < n; ++m)
+			envelope[m] = std::max(envelope[m], envelope[m + span]);
+
+	// Maximum over bins [m - halfWidth, m + halfWidth], which bridges the troughs between harmonics
+	for (int m = 0; m < n; ++m)
+		gain[m] = std::max(envelope[std::max(m - halfWidth, 0)], envelope[std::max(m - halfWidth + 1, 0)]);
+
+	// Smoothed over the same width, so that the hull's corners leave no ripple
+	sum[0] = 0.f;
+	for (int m = 0; m < n; ++m)
+		sum[m + 1] = sum[m] + gain[m];
+	for (int m = 0; m < n; ++m)
+	{
+		const int begin = std::max(m - halfWidth, 0);
+		const int end = std::min(m + halfWidth + 1, n);
+		envelope[m] = (sum[end] - sum[begin]) / (end - begin);
+	}
+
+	// Bin m will sound at the frequency of bin m * pitch, where it should have the envelope found there
+	const float last = float(n - 1);
+	for (int m = 0; m < n; ++m)
+	{
+		const float x = std::min(float(m * pitch), last);
+		const int i = std::min(int(x), n - 2);
+		const float f = x - i;
+		const float shifted = envelope[i] + f * (envelope[i + 1] - envelope[i]);
+		gain[m] = std::exp(std::clamp(0.5f * (shifted - envelope[m]), -maxLogGain, maxLogGain));
+	}
+}
+
+} // namespace Bungee
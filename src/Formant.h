@@ -0,0 +1,36 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include "Arena.h"
+#include "Fourier.h"
+#include "Grain.h"
+
+#include <Eigen/Core>
+
+namespace Bungee {
+
+// Formant preservation: a gain for each bin that moves a pitch-shifted grain's spectral envelope back to where it was.
+// The envelope is the smoothed upper hull of the grain's analysed energy, so costs no transforms.
+struct Formant
+{
+	// Log energy envelope of a grain, and running sums for smoothing it
+	Mapped<Eigen::ArrayXf> envelope;
+	Mapped<Eigen::ArrayXf> sum;
+
+	// Amplitude gain of each bin
+	Mapped<Eigen::ArrayXf> gain;
+
+	inline void allocate(Arena &arena, int log2TransformLength)
+	{
+		Fourier::allocate<true>(arena, log2TransformLength, 1, envelope);
+		Fourier::allocate<true>(arena, log2TransformLength, 1, sum, 1);
+		Fourier::allocate<true>(arena, log2TransformLength, 1, gain);
+	}
+
+	// Sets the first grain.validBinCount gains for a channel group of a grain whose frequencies will be multiplied by pitch
+	void analyse(const Grain &grain, int group, double pitch);
+};
+
+} // namespace Bungee
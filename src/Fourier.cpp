@@ -4,19 +4,84 @@
 #include "Fourier.h"
 #include "Assert.h"
 
-#include "../submodules/pffft/pffft.h"
-namespace Bungee::Fourier {
+#include <atomic>
+#include <bit>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+#include <type_traits>
 
 #ifndef BUNGEE_USE_PFFFT
 #	define BUNGEE_USE_PFFFT 1
 #endif
 
+#ifndef BUNGEE_USE_FFTW
+#	define BUNGEE_USE_FFTW 0
+#endif
+
+#ifndef BUNGEE_USE_VDSP
+#	ifdef __APPLE__
+#		define BUNGEE_USE_VDSP 1
+#	else
+#		define BUNGEE_USE_VDSP 0
+#	endif
+#endif
+
+#ifndef BUNGEE_USE_IPP
+#	define BUNGEE_USE_IPP 0
+#endif
+
+#ifndef BUNGEE_USE_KISSFFT
+#	define BUNGEE_USE_KISSFFT 0
+#endif
+
 #if BUNGEE_USE_PFFFT
+#	include "../submodules/pffft/pffft.h"
+#endif
+#if BUNGEE_USE_FFTW
+#	include <fftw3.h>
+#endif
+#if BUNGEE_USE_VDSP
+#	include <Accelerate/Accelerate.h>
+#endif
+#if BUNGEE_USE_IPP
+#	include <ipp.h>
+#endif
+#if BUNGEE_USE_KISSFFT
+#	include <kiss_fftr.h>
+#endif
+
+namespace Bungee::Fourier {
 
 namespace {
 
-struct Pffft
+// Every backend's transforms match PFFFT's: unscaled in both directions, with bins 0 to N/2 of the real
+// transform in f[0] to f[N/2] and the imaginary parts of the DC and Nyquist bins zero.
+
+template <FftBackend>
+struct Backend
+{
+	static constexpr bool available = false;
+
+	struct Kernel
+	{
+		Kernel(int) {}
+		void forward(int, float *, std::complex<float> *) const {}
+		void inverse(int, float *, std::complex<float> *) const {}
+	};
+
+	typedef Kernel Forward;
+	typedef Kernel Inverse;
+};
+
+#if BUNGEE_USE_PFFFT
+
+template <>
+struct Backend<fftBackend_pffft>
 {
+	static constexpr bool available = true;
+
 	struct Kernel
 	{
 		void *p;
@@ -32,17 +97,17 @@ struct Pffft
 	typedef Kernel Inverse;
 };
 
-Pffft::Kernel::Kernel(int log2TransformLength) :
+Backend<fftBackend_pffft>::Kernel::Kernel(int log2TransformLength) :
 	p(pffft_new_setup(1 << log2TransformLength, PFFFT_REAL))
 {
 }
 
-Pffft::Kernel::~Kernel()
+Backend<fftBackend_pffft>::Kernel::~Kernel()
 {
 	pffft_destroy_setup((PFFFT_Setup *)p);
 }
 
-void Pffft::Kernel::forward(int log2TransformLength, float *t, std::complex<float> *f) const
+void Backend<fftBackend_pffft>::Kernel::forward(int log2TransformLength, float *t, std::complex<float> *f) const
 {
 	pffft_transform_ordered((PFFFT_Setup *)p, t, (float *)f, nullptr, PFFFT_FORWARD);
 	const auto transformLength = 1 << log2TransformLength;
@@ -50,7 +115,7 @@ void Pffft::Kernel::forward(int log2TransformLength, float *t, std::complex<floa
 	f[0].imag(0.f);
 }
 
-void Pffft::Kernel::inverse(int log2TransformLength, float *t, std::complex<float> *f) const
+void Backend<fftBackend_pffft>::Kernel::inverse(int log2TransformLength, float *t, std::complex<float> *f) const
 {
 	const auto transformLength = 1 << log2TransformLength;
 	const auto backup = f[0].imag();
@@ -59,9 +124,609 @@ void Pffft::Kernel::inverse(int log2TransformLength, float *t, std::complex<floa
 	f[0].imag(backup);
 }
 
+#endif
+
+#if BUNGEE_USE_FFTW
+
+template <>
+struct Backend<fftBackend_fftw>
+{
+	static constexpr bool available = true;
+
+	// FFTW's planner is not thread safe: plans are made and destroyed under this lock
+	static inline std::mutex planner;
+
+	struct Kernel
+	{
+		fftwf_plan f, i;
+
+		Kernel(int log2TransformLength)
+		{
+			const auto transformLength = 1 << log2TransformLength;
+			const std::lock_guard lock(planner);
+
+			// Planning with FFTW_MEASURE overwrites its arrays, so plans are made on scratch arrays and executed on others
+			auto t = fftwf_alloc_real(transformLength);
+			auto c = fftwf_alloc_complex(transformLength / 2 + 1);
+			f = fftwf_plan_dft_r2c_1d(transformLength, t, c, FFTW_MEASURE | FFTW_UNALIGNED);
+			i = fftwf_plan_dft_c2r_1d(transformLength, c, t, FFTW_MEASURE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+			fftwf_free(c);
+			fftwf_free(t);
+			BUNGEE_ASSERT1(f && i);
+		}
+
+		~Kernel()
+		{
+			const std::lock_guard lock(planner);
+			fftwf_destroy_plan(i);
+			fftwf_destroy_plan(f);
+		}
+
+		void forward(int, float *t, std::complex<float> *f) const
+		{
+			fftwf_execute_dft_r2c(this->f, t, reinterpret_cast<fftwf_complex *>(f));
+		}
+
+		void inverse(int, float *t, std::complex<float> *f) const
+		{
+			fftwf_execute_dft_c2r(i, reinterpret_cast<fftwf_complex *>(f), t);
+		}
+	};
+
+	typedef Kernel Forward;
+	typedef Kernel Inverse;
+};
+
+#endif
+
+#if BUNGEE_USE_VDSP
+
+template <>
+struct Backend<fftBackend_vdsp>
+{
+	static constexpr bool available = true;
+
+	struct Kernel
+	{
+		FFTSetup setup;
+
+		Kernel(int log2TransformLength) :
+			setup(vDSP_create_fftsetup(log2TransformLength, kFFTRadix2))
+		{
+			BUNGEE_ASSERT1(setup);
+		}
+
+		~Kernel()
+		{
+			vDSP_destroy_fftsetup(setup);
+		}
+
+		// Split-complex working storage of the calling thread for channelCount signals of half the transform length
+		static DSPSplitComplex split(int log2TransformLength, int channelCount)
+		{
+			thread_local std::vector<float> buffer;
+			const auto size = channelCount << log2TransformLength;
+			if ((int)buffer.size() < size)
+				buffer.resize(size);
+			return {buffer.data(), buffer.data() + size / 2};
+		}
+
+		// All channels are transformed by one call of vDSP_fftm_zrip, which shares its passes over the twiddle factors
+		void forward(int log2TransformLength, int channelCount, float *t, std::ptrdiff_t tStride, std::complex<float> *f, std::ptrdiff_t fStride) const
+		{
+			const auto halfLength = 1 << (log2TransformLength - 1);
+			const auto s = split(log2TransformLength, channelCount);
+			for (int c = 0; c < channelCount; ++c)
+			{
+				DSPSplitComplex channel{s.realp + c * halfLength, s.imagp + c * halfLength};
+				vDSP_ctoz(reinterpret_cast<const DSPComplex *>(t + c * tStride), 2, &channel, 1, halfLength);
+			}
+
+			vDSP_fftm_zrip(setup, &s, 1, halfLength, log2TransformLength, channelCount, FFT_FORWARD);
+
+			// vDSP's forward transform is scaled by two and packs the Nyquist bin into bin zero
+			const float half = 0.5f;
+			for (int c = 0; c < channelCount; ++c)
+			{
+				const DSPSplitComplex channel{s.realp + c * halfLength, s.imagp + c * halfLength};
+				auto fc = f + c * fStride;
+				vDSP_ztoc(&channel, 1, reinterpret_cast<DSPComplex *>(fc), 2, halfLength);
+				vDSP_vsmul(reinterpret_cast<const float *>(fc), 1, &half, reinterpret_cast<float *>(fc), 1, 2 * halfLength);
+				fc[halfLength] = fc[0].imag();
+				fc[0].imag(0.f);
+			}
+		}
+
+		void inverse(int log2TransformLength, int channelCount, float *t, std::ptrdiff_t tStride, std::complex<float> *f, std::ptrdiff_t fStride) const
+		{
+			const auto halfLength = 1 << (log2TransformLength - 1);
+			const auto s = split(log2TransformLength, channelCount);
+			for (int c = 0; c < channelCount; ++c)
+			{
+				DSPSplitComplex channel{s.realp + c * halfLength, s.imagp + c * halfLength};
+				const auto fc = f + c * fStride;
+				vDSP_ctoz(reinterpret_cast<const DSPComplex *>(fc), 2, &channel, 1, halfLength);
+				channel.imagp[0] = fc[halfLength].real();
+			}
+
+			vDSP_fftm_zrip(setup, &s, 1, halfLength, log2TransformLength, channelCount, FFT_INVERSE);
+
+			for (int c = 0; c < channelCount; ++c)
+			{
+				const DSPSplitComplex channel{s.realp + c * halfLength, s.imagp + c * halfLength};
+				vDSP_ztoc(&channel, 1, reinterpret_cast<DSPComplex *>(t + c * tStride), 2, halfLength);
+			}
+		}
+	};
+
+	typedef Kernel Forward;
+	typedef Kernel Inverse;
+};
+
+#endif
+
+#if BUNGEE_USE_IPP
+
+template <>
+struct Backend<fftBackend_ipp>
+{
+	static constexpr bool available = true;
+
+	struct Kernel
+	{
+		IppsFFTSpec_R_32f *spec{};
+		Ipp8u *specBuffer{};
+		int workSize{};
+
+		Kernel(int log2TransformLength)
+		{
+			int specSize{}, initSize{};
+			ippsFFTGetSize_R_32f(log2TransformLength, IPP_FFT_NODIV_BY_ANY, ippAlgHintNone, &specSize, &initSize, &workSize);
+			specBuffer = ippsMalloc_8u(specSize);
+			Ipp8u *initBuffer = initSize ? ippsMalloc_8u(initSize) : nullptr;
+			[[maybe_unused]] const auto status = ippsFFTInit_R_32f(&spec, log2TransformLength, IPP_FFT_NODIV_BY_ANY, ippAlgHintNone, specBuffer, initBuffer);
+			BUNGEE_ASSERT1(status == ippStsNoErr);
+			ippsFree(initBuffer);
+		}
+
+		~Kernel()
+		{
+			ippsFree(specBuffer);
+		}
+
+		// Working storage of the calling thread, which grows on first use at each length
+		Ipp8u *work() const
+		{
+			thread_local std::vector<Ipp8u> buffer;
+			if ((int)buffer.size() < workSize)
+				buffer.resize(workSize);
+			return buffer.data();
+		}
+
+		// IPP's CCS format is the layout of f
+		void forward(int, float *t, std::complex<float> *f) const
+		{
+			ippsFFTFwd_RToCCS_32f(t, reinterpret_cast<Ipp32f *>(f), spec, work());
+		}
+
+		void inverse(int, float *t, std::complex<float> *f) const
+		{
+			ippsFFTInv_CCSToR_32f(reinterpret_cast<const Ipp32f *>(f), t, spec, work());
+		}
+	};
+
+	typedef Kernel Forward;
+	typedef Kernel Inverse;
+};
+
+#endif
+
+#if BUNGEE_USE_KISSFFT
+
+static_assert(std::is_same_v<kiss_fft_scalar, float>, "KissFFT must be built with float samples");
+
+template <>
+struct Backend<fftBackend_kissfft>
+{
+	static constexpr bool available = true;
+
+	// KissFFT plans forward and inverse transforms separately
+	template <bool isInverse>
+	struct Kernel
+	{
+		kiss_fftr_cfg cfg;
+
+		Kernel(int log2TransformLength) :
+			cfg(kiss_fftr_alloc(1 << log2TransformLength, isInverse, nullptr, nullptr))
+		{
+			BUNGEE_ASSERT1(cfg);
+		}
+
+		~Kernel()
+		{
+			kiss_fftr_free(cfg);
+		}
+
+		void forward(int, float *t, std::complex<float> *f) const
+		{
+			kiss_fftr(cfg, t, reinterpret_cast<kiss_fft_cpx *>(f));
+		}
+
+		void inverse(int, float *t, std::complex<float> *f) const
+		{
+			kiss_fftri(cfg, reinterpret_cast<const kiss_fft_cpx *>(f), t);
+		}
+	};
+
+	typedef Kernel<false> Forward;
+	typedef Kernel<true> Inverse;
+};
+
+#endif
+
+// Channels in SIMD lanes: each vector holds one sample or bin of as many channels as it has lanes, so that the
+// butterflies of all those channels share one pass over the data and one load of each twiddle factor. Every lane
+// undergoes the same operations, so a channel's result does not depend on how many channels accompany it.
+template <>
+struct Backend<fftBackend_lanes>
+{
+	static constexpr bool available = true;
+
+	// Four lanes, the width of SSE and NEON vectors. Eight, to fill an AVX vector, were slower per channel at usual
+	// transform lengths because the working storage of eight channels no longer fits in L1 cache.
+	static constexpr int lanes = 4;
+	typedef Eigen::Array<float, lanes, 1> Lane;
+	typedef Eigen::Map<Lane, Eigen::Aligned16> Ref;
+
+	// Complex values of lanes channels: the real parts of all lanes, then their imaginary parts
+	struct Complex
+	{
+		float *p;
+
+		inline Ref re() const
+		{
+			return Ref(p);
+		}
+
+		inline Ref im() const
+		{
+			return Ref(p + lanes);
+		}
+	};
+
+	struct Kernel
+	{
+		// The real transform is a complex transform of half the length, of even samples as real and odd samples as
+		// imaginary parts, followed by a split into the bins of the real transform
+		std::vector<int> reversed; // bit-reversed order of each complex sample
+		std::vector<std::complex<float>> passTwiddles; // of forward radix-2 passes of span 2, 4, ..., in turn
+		std::vector<std::complex<float>> splitTwiddles; // of forward real bins 0 to half the transform length
+
+		Kernel(int log2TransformLength)
+		{
+			const int log2HalfLength = log2TransformLength - 1;
+			const int halfLength = 1 << log2HalfLength;
+
+			reversed.resize(halfLength);
+			for (int i = 0; i < halfLength; ++i)
+				for (int b = 0; b < log2HalfLength; ++b)
+					reversed[i] |= ((i >> b) & 1) << (log2HalfLength - 1 - b);
+
+			for (int span = 2; span <= halfLength; span *= 2)
+				for (int j = 0; j < span / 2; ++j)
+					passTwiddles.emplace_back(std::polar(1., -2 * std::numbers::pi * j / span));
+
+			for (int k = 0; k <= halfLength; ++k)
+				splitTwiddles.emplace_back(std::polar(1., -std::numbers::pi * k / halfLength));
+		}
+
+		// Working storage of the calling thread for two arrays of complex values, of halfLength and halfLength + 1 entries
+		static std::pair<float *, float *> scratch(int halfLength)
+		{
+			thread_local Eigen::ArrayXf buffer;
+			const auto size = 2 * lanes * (2 * halfLength + 1);
+			if (buffer.size() < size)
+				buffer.resize(size);
+			return {buffer.data(), buffer.data() + 2 * lanes * halfLength};
+		}
+
+		static inline Complex at(float *array, int i)
+		{
+			return {array + 2 * lanes * i};
+		}
+
+		// Lanes (re + i im) * w, where w is a twiddle factor or its conjugate
+		template <bool conjugate>
+		static inline std::pair<Lane, Lane> rotated(const Lane &re, const Lane &im, std::complex<float> w)
+		{
+			const float wIm = conjugate ? -w.imag() : w.imag();
+			return {re * w.real() - im * wIm, re * wIm + im * w.real()};
+		}
+
+		// In-place decimation-in-time transform of halfLength complex values in bit-reversed order: a radix-2 pass when
+		// the number of passes is odd, then radix-4 passes, each of which does the work of two radix-2 passes
+		template <bool isInverse>
+		void transform(float *z, int halfLength) const
+		{
+			int quarter = 1;
+			if (std::countr_zero((unsigned)halfLength) % 2)
+			{
+				for (int i = 0; i < halfLength; i += 2)
+				{
+					const auto a = at(z, i), b = at(z, i + 1);
+					const Lane re = a.re() - b.re(), im = a.im() - b.im();
+					a.re() += b.re();
+					a.im() += b.im();
+					b.re() = re;
+					b.im() = im;
+				}
+				quarter = 2;
+			}
+
+			for (; 4 * quarter <= halfLength; quarter *= 4)
+				for (int i = 0; i < halfLength; i += 4 * quarter)
+					for (int j = 0; j < quarter; ++j)
+					{
+						const auto x0 = at(z, i + j), x1 = at(z, i + j + quarter), x2 = at(z, i + j + 2 * quarter), x3 = at(z, i + j + 3 * quarter);
+
+						// Radix-2 butterflies of span 2 * quarter...
+						const auto w1 = passTwiddles[quarter - 1 + j];
+						const auto [r1, i1] = rotated<isInverse>(x1.re(), x1.im(), w1);
+						const auto [r3, i3] = rotated<isInverse>(x3.re(), x3.im(), w1);
+						const Lane y0Re = x0.re() + r1, y0Im = x0.im() + i1, y1Re = x0.re() - r1, y1Im = x0.im() - i1;
+						const Lane y2Re = x2.re() + r3, y2Im = x2.im() + i3, y3Re = x2.re() - r3, y3Im = x2.im() - i3;
+
+						// ...then of span 4 * quarter, whose second twiddle factor is the first times -i (or i, inverse)
+						const auto w2 = passTwiddles[2 * quarter - 1 + j];
+						const auto [r2, i2] = rotated<isInverse>(y2Re, y2Im, w2);
+						const auto [s3, j3] = rotated<isInverse>(y3Re, y3Im, w2);
+						const Lane u3Re = isInverse ? -j3 : j3, u3Im = isInverse ? s3 : -s3;
+						x0.re() = y0Re + r2;
+						x0.im() = y0Im + i2;
+						x2.re() = y0Re - r2;
+						x2.im() = y0Im - i2;
+						x1.re() = y1Re + u3Re;
+						x1.im() = y1Im + u3Im;
+						x3.re() = y1Re - u3Re;
+						x3.im() = y1Im - u3Im;
+					}
+		}
+
+		void forward(int log2TransformLength, int channelCount, float *t, std::ptrdiff_t tStride, std::complex<float> *f, std::ptrdiff_t fStride) const
+		{
+			const int halfLength = 1 << (log2TransformLength - 1);
+			const auto [z, x] = scratch(halfLength);
+
+			for (int first = 0; first < channelCount; first += lanes)
+			{
+				const int count = std::min(lanes, channelCount - first);
+				if (count < lanes)
+					Eigen::Map<Eigen::ArrayXf>(z, 2 * lanes * halfLength).setZero();
+
+				for (int l = 0; l < count; ++l)
+				{
+					const auto tl = t + (first + l) * tStride;
+					for (int n = 0; n < halfLength; ++n)
+					{
+						const auto zn = at(z, reversed[n]);
+						zn.p[l] = tl[2 * n];
+						zn.p[lanes + l] = tl[2 * n + 1];
+					}
+				}
+
+				transform<false>(z, halfLength);
+
+				// Bin k of the real transform is (Z[k] + conj(Z[-k])) / 2 - i w^k (Z[k] - conj(Z[-k])) / 2
+				for (int k = 0; k <= halfLength; ++k)
+				{
+					const auto zk = at(z, k & (halfLength - 1)), zm = at(z, (halfLength - k) & (halfLength - 1)), xk = at(x, k);
+					const Lane sumRe = zk.re() + zm.re(), sumIm = zk.im() - zm.im();
+					const Lane differenceRe = zk.re() - zm.re(), differenceIm = zk.im() + zm.im();
+					const float wRe = splitTwiddles[k].real(), wIm = splitTwiddles[k].imag();
+					xk.re() = 0.5f * (sumRe + differenceIm * wRe + differenceRe * wIm);
+					xk.im() = 0.5f * (sumIm + differenceIm * wIm - differenceRe * wRe);
+				}
+				at(x, 0).im().setZero();
+				at(x, halfLength).im().setZero();
+
+				for (int l = 0; l < count; ++l)
+				{
+					const auto fl = f + (first + l) * fStride;
+					for (int k = 0; k <= halfLength; ++k)
+					{
+						const auto xk = at(x, k);
+						fl[k] = {xk.p[l], xk.p[lanes + l]};
+					}
+				}
+			}
+		}
+
+		void inverse(int log2TransformLength, int channelCount, float *t, std::ptrdiff_t tStride, std::complex<float> *f, std::ptrdiff_t fStride) const
+		{
+			const int halfLength = 1 << (log2TransformLength - 1);
+			const auto [z, x] = scratch(halfLength);
+
+			for (int first = 0; first < channelCount; first += lanes)
+			{
+				const int count = std::min(lanes, channelCount - first);
+				if (count < lanes)
+					Eigen::Map<Eigen::ArrayXf>(x, 2 * lanes * (halfLength + 1)).setZero();
+
+				for (int l = 0; l < count; ++l)
+				{
+					const auto fl = f + (first + l) * fStride;
+					for (int k = 0; k <= halfLength; ++k)
+					{
+						const auto xk = at(x, k);
+						xk.p[l] = fl[k].real();
+						xk.p[lanes + l] = fl[k].imag();
+					}
+				}
+				at(x, 0).im().setZero();
+				at(x, halfLength).im().setZero();
+
+				// Z[k] is (X[k] + conj(X[N/2 - k])) + i conj(w^k) (X[k] - conj(X[N/2 - k])), which scales the
+				// result of the inverse complex transform to match the unscaled inverse real transform
+				for (int k = 0; k < halfLength; ++k)
+				{
+					const auto xk = at(x, k), xm = at(x, halfLength - k), zk = at(z, reversed[k]);
+					const Lane sumRe = xk.re() + xm.re(), sumIm = xk.im() - xm.im();
+					const Lane differenceRe = xk.re() - xm.re(), differenceIm = xk.im() + xm.im();
+					const float wRe = splitTwiddles[k].real(), wIm = -splitTwiddles[k].imag();
+					zk.re() = sumRe - (differenceRe * wIm + differenceIm * wRe);
+					zk.im() = sumIm + (differenceRe * wRe - differenceIm * wIm);
+				}
+
+				transform<true>(z, halfLength);
+
+				for (int l = 0; l < count; ++l)
+				{
+					const auto tl = t + (first + l) * tStride;
+					for (int n = 0; n < halfLength; ++n)
+					{
+						const auto zn = at(z, n);
+						tl[2 * n] = zn.p[l];
+						tl[2 * n + 1] = zn.p[lanes + l];
+					}
+				}
+			}
+		}
+	};
+
+	typedef Kernel Forward;
+	typedef Kernel Inverse;
+};
+
+constexpr int log2MaxTransformLength = 16;
+
+constexpr bool available(FftBackend backend)
+{
+	switch (backend)
+	{
+#define X_FFT(backend, description) \
+	case fftBackend_##backend: \
+		return Backend<fftBackend_##backend>::available;
+		BUNGEE_FFT_BACKENDS
+#undef X_FFT
+	case fftBackend_fastest:
+		return true;
+	}
+	return false;
+}
+
+std::atomic<FftBackend> defaultBackend{BUNGEE_USE_PFFFT ? fftBackend_pffft : fftBackend_fastest};
+
+// Time taken by one round trip at the given length, best of a few trials
+template <class B>
+double roundTripSeconds(int log2TransformLength)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	Cache<B, log2MaxTransformLength> cache;
+	cache.prepareForward(log2TransformLength);
+	cache.prepareInverse(log2TransformLength);
+
+	const auto n = transformLength(log2TransformLength);
+	Eigen::ArrayXXf t = Eigen::ArrayXf::LinSpaced(n, 0.f, n - 1.f).sin();
+	Eigen::ArrayXXcf f(n / 2 + 1, 1);
+
+	const int repeatCount = std::max(4, (1 << 18) >> log2TransformLength);
+	auto best = std::numeric_limits<double>::infinity();
+	for (int trial = 0; trial < 3; ++trial)
+	{
+		const auto start = Clock::now();
+		for (int r = 0; r < repeatCount; ++r)
+		{
+			cache.forward(log2TransformLength, t, f);
+			cache.inverse(log2TransformLength, t, f);
+			t *= 1.f / n;
+		}
+		best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count() / repeatCount);
+	}
+	return best;
+}
+
+// Fastest compiled backend at the given length, timed on first use in the process
+FftBackend fastest(int log2TransformLength)
+{
+	static std::mutex mutex;
+	static std::array<FftBackend, log2MaxTransformLength + 1> measured = [] {
+		std::array<FftBackend, log2MaxTransformLength + 1> a;
+		a.fill(fftBackend_fastest);
+		return a;
+	}();
+
+	const std::lock_guard lock(mutex);
+	auto &backend = measured[log2TransformLength];
+	if (backend == fftBackend_fastest)
+	{
+		auto bestSeconds = std::numeric_limits<double>::infinity();
+#define X_FFT(backend_, description) \
+	if (Backend<fftBackend_##backend_>::available) \
+	{ \
+		const auto seconds = roundTripSeconds<Backend<fftBackend_##backend_>>(log2TransformLength); \
+		if (seconds < bestSeconds) \
+		{ \
+			bestSeconds = seconds; \
+			backend = fftBackend_##backend_; \
+		} \
+	}
+		BUNGEE_FFT_BACKENDS
+#undef X_FFT
+	}
+	return backend;
+}
+
+struct Implementation
+{
+#define X_FFT(backend, description) Cache<Backend<fftBackend_##backend>, log2MaxTransformLength> backend;
+	BUNGEE_FFT_BACKENDS
+#undef X_FFT
+
+	FftBackend requested = defaultBackend;
+	std::array<FftBackend, log2MaxTransformLength + 1> selected{};
+	std::bitset<log2MaxTransformLength + 1> forwardPrepared, inversePrepared;
+
+	// Calls f with the kernel cache of a compiled backend
+	template <class Self, class F>
+	static inline void visit(Self &self, FftBackend backend, F f)
+	{
+		switch (backend)
+		{
+#define X_FFT(backend_, description) \
+	case fftBackend_##backend_: \
+		if constexpr (Backend<fftBackend_##backend_>::available) \
+			f(self.backend_); \
+		break;
+			BUNGEE_FFT_BACKENDS
+#undef X_FFT
+		default:
+			BUNGEE_ASSERT1(false);
+		}
+	}
+
+	void prepare(int log2TransformLength)
+	{
+		auto &backend = selected[log2TransformLength];
+		backend = requested == fftBackend_fastest ? fastest(log2TransformLength) : requested;
+		visit(*this, backend, [&](auto &cache) {
+			if (forwardPrepared[log2TransformLength])
+				cache.prepareForward(log2TransformLength);
+			if (inversePrepared[log2TransformLength])
+				cache.prepareInverse(log2TransformLength);
+		});
+	}
+};
+
 } // namespace
 
-typedef Cache<Pffft, 16> Implementation;
+bool setDefaultBackend(FftBackend backend)
+{
+	if (!available(backend))
+		return false;
+	defaultBackend = backend;
+	return true;
+}
 
 Transforms::Transforms()
 {
@@ -73,26 +738,64 @@ Transforms::~Transforms()
 	delete reinterpret_cast<Implementation *>(p);
 }
 
+bool Transforms::select(FftBackend backend)
+{
+	if (!available(backend))
+		return false;
+
+	auto &implementation = *reinterpret_cast<Implementation *>(p);
+	implementation.requested = backend;
+	for (int log2TransformLength = 0; log2TransformLength <= log2MaxTransformLength; ++log2TransformLength)
+		if (implementation.forwardPrepared[log2TransformLength] || implementation.inversePrepared[log2TransformLength])
+			implementation.prepare(log2TransformLength);
+	return true;
+}
+
+FftBackend Transforms::selected(int log2TransformLength) const
+{
+	return reinterpret_cast<const Implementation *>(p)->selected[log2TransformLength];
+}
+
+bool Transforms::batchedForward(int log2TransformLength) const
+{
+	const auto &implementation = *reinterpret_cast<const Implementation *>(p);
+	bool batched = false;
+	Implementation::visit(implementation, implementation.selected[log2TransformLength], [&](auto &cache) { batched = cache.batchedForward; });
+	return batched;
+}
+
+bool Transforms::batchedInverse(int log2TransformLength) const
+{
+	const auto &implementation = *reinterpret_cast<const Implementation *>(p);
+	bool batched = false;
+	Implementation::visit(implementation, implementation.selected[log2TransformLength], [&](auto &cache) { batched = cache.batchedInverse; });
+	return batched;
+}
+
 void Transforms::prepareForward(int log2TransformLength)
 {
-	reinterpret_cast<Implementation *>(p)->prepareForward(log2TransformLength);
+	auto &implementation = *reinterpret_cast<Implementation *>(p);
+	implementation.forwardPrepared[log2TransformLength] = true;
+	implementation.prepare(log2TransformLength);
 }
 
 void Transforms::prepareInverse(int log2TransformLength)
 {
-	reinterpret_cast<Implementation *>(p)->prepareInverse(log2TransformLength);
+	auto &implementation = *reinterpret_cast<Implementation *>(p);
+	implementation.inversePrepared[log2TransformLength] = true;
+	implementation.prepare(log2TransformLength);
 }
 
 void Transforms::forward(int log2TransformLength, const Eigen::Ref<const Eigen::ArrayXXf> &t, Eigen::Ref<Eigen::ArrayXXcf> f)
 {
-	reinterpret_cast<Implementation *>(p)->forward(log2TransformLength, t, f);
+	auto &implementation = *reinterpret_cast<Implementation *>(p);
+	Implementation::visit(implementation, implementation.selected[log2TransformLength], [&](auto &cache) { cache.forward(log2TransformLength, t, f); });
 }
 
 void Transforms::inverse(int log2TransformLength, Eigen::Ref<Eigen::ArrayXXf> t, const Eigen::Ref<const Eigen::ArrayXXcf> &f)
 {
-	reinterpret_cast<Implementation *>(p)->inverse(log2TransformLength, t, f);
+	auto &implementation = *reinterpret_cast<Implementation *>(p);
+	Implementation::visit(implementation, implementation.selected[log2TransformLength], [&](auto &cache) { cache.inverse(log2TransformLength, t, f); });
 }
 
-#endif
-
 } // namespace Bungee::Fourier
@@ -3,13 +3,19 @@
 
 #pragma once
 
+#include "Arena.h"
 #include "Assert.h"
+#include "bungee/Bungee.h"
 
 #include <Eigen/Core>
 
 #include <algorithm>
+#include <array>
 #include <complex>
+#include <cstddef>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -50,115 +56,127 @@ constexpr std::complex<float> uninitialisedValue<std::complex<float>>()
 	return {uninitialisedValue<float>(), uninitialisedValue<float>()};
 }
 
-template <bool frequencyDomain, class T>
-inline void resize(int log2TransformLength, int channelCount, T &array, int extra = 0)
+// Rows of a time-domain array or, padded for alignment, of a frequency-domain array
+template <bool frequencyDomain, class Scalar>
+inline int rows(int log2TransformLength, int extra = 0)
 {
-	typedef typename T::Scalar Scalar;
 	if constexpr (frequencyDomain)
 	{
 		auto pad = std::max<int>(1, EIGEN_DEFAULT_ALIGN_BYTES / std::min<int>(4, sizeof(Scalar)));
-		array.resize(binCount(log2TransformLength) - 1 + pad + extra, channelCount);
+		return binCount(log2TransformLength) - 1 + pad + extra;
 	}
 	else
 	{
-		array.resize(transformLength(log2TransformLength) + extra, channelCount);
+		return transformLength(log2TransformLength) + extra;
 	}
+}
+
+template <bool frequencyDomain, class T>
+inline void resize(int log2TransformLength, int channelCount, T &array, int extra = 0)
+{
+	typedef typename T::Scalar Scalar;
+	array.resize(rows<frequencyDomain, Scalar>(log2TransformLength, extra), channelCount);
 
 	if constexpr (Assert::level)
 		array.setConstant(uninitialisedValue<Scalar>());
 }
 
+// As resize(), for an array in an arena
+template <bool frequencyDomain, class T>
+inline void allocate(Arena &arena, int log2TransformLength, int channelCount, Mapped<T> &array, int extra = 0)
+{
+	typedef typename T::Scalar Scalar;
+	arena.allocate(array, rows<frequencyDomain, Scalar>(log2TransformLength, extra), channelCount);
+
+	if constexpr (Assert::level)
+		if (!arena.measuring())
+			array.setConstant(uninitialisedValue<Scalar>());
+}
+
+// Forward and inverse FFTs of each prepared length, by the selected backend
 struct Transforms
 {
 	void *p;
 	Transforms();
 	~Transforms();
+
+	// Re-prepares every length already prepared with backend, returning false and changing nothing if backend
+	// is not compiled in. Allocates, and with fftBackend_fastest may time each backend the first time a length is seen.
+	bool select(FftBackend backend);
+
+	// Backend used for transforms of the given length, once prepared
+	FftBackend selected(int log2TransformLength) const;
+
+	// True when that backend transforms the channels of a multichannel array together, rather than one by one,
+	// in forward or in inverse transforms respectively
+	bool batchedForward(int log2TransformLength) const;
+	bool batchedInverse(int log2TransformLength) const;
+
 	void prepareForward(int log2TransformLength);
 	void prepareInverse(int log2TransformLength);
 	void forward(int log2TransformLength, const Eigen::Ref<const Eigen::ArrayXXf> &t, Eigen::Ref<Eigen::ArrayXXcf> f);
 	void inverse(int log2TransformLength, Eigen::Ref<Eigen::ArrayXXf> t, const Eigen::Ref<const Eigen::ArrayXXcf> &f);
 };
 
-// General case when an FFT implementation has different states for forward and reverse transforms of same size.
+// Backend selected by Transforms constructed afterwards, returning false and changing nothing if backend is not compiled in
+bool setDefaultBackend(FftBackend backend);
+
+// Kernels are immutable once constructed and depend only on transform length, so a process-wide,
+// thread-safe registry shares one reference-counted kernel of each length between all users.
+template <class Kernel>
+std::shared_ptr<const Kernel> sharedKernel(int log2TransformLength)
+{
+	static std::mutex mutex;
+	static std::array<std::weak_ptr<const Kernel>, 32> registry;
+
+	const std::lock_guard lock(mutex);
+	auto kernel = registry[log2TransformLength].lock();
+	if (!kernel)
+		registry[log2TransformLength] = kernel = std::make_shared<const Kernel>(log2TransformLength);
+	return kernel;
+}
+
+// Forward and inverse kernels of one transform length. When an FFT implementation uses the same state
+// for forward and inverse transforms (F and I are the same type), both refer to the same shared kernel.
 template <class F, class I>
 class KernelPair
 {
-	F *f{};
-	I *i{};
-
-	KernelPair(const KernelPair &) = delete;
-	KernelPair &operator=(const KernelPair &) = delete;
+	std::shared_ptr<const F> f;
+	std::shared_ptr<const I> i;
 
 public:
-	KernelPair() = default;
-	~KernelPair()
+	inline const F *forward() const
 	{
-		if (f)
-			delete f;
-		if (i)
-			delete i;
+		return f.get();
 	}
 
-	inline F *forward() const
+	inline const I *inverse() const
 	{
-		return f;
+		return i.get();
 	}
 
-	inline I *inverse() const
-	{
-		return i;
-	}
 	void make_forward(int log2TransformLength)
 	{
 		if (!f)
-			f = new F(log2TransformLength);
+			f = sharedKernel<F>(log2TransformLength);
 	}
 
 	void make_inverse(int log2TransformLength)
 	{
 		if (!i)
-			i = new I(log2TransformLength);
+			i = sharedKernel<I>(log2TransformLength);
 	}
 };
 
-// Special case when an FFT implementation can use the same state for forward and reverse transforms of same size.
-template <class T>
-class KernelPair<T, T>
-{
-	T *t{};
-
-	KernelPair(const KernelPair &) = delete;
-	KernelPair &operator=(const KernelPair &) = delete;
-
-public:
-	KernelPair() = default;
-	~KernelPair()
-	{
-		if (t)
-			delete t;
-	}
-
-	inline T *forward() const
-	{
-		return t;
-	}
-
-	inline T *inverse() const
-	{
-		return t;
-	}
-
-	void make_forward(int log2TransformLength)
-	{
-		if (!t)
-			t = new T(log2TransformLength);
-	}
+// Kernels that transform several channels in one call, where their implementation shares work between them
+template <class Kernel>
+concept BatchedForward = requires(const Kernel &kernel, float *t, std::complex<float> *f, std::ptrdiff_t stride) {
+	kernel.forward(0, 0, t, stride, f, stride);
+};
 
-	void make_inverse(int log2TransformLength)
-	{
-		if (!t)
-			t = new T(log2TransformLength);
-	}
+template <class Kernel>
+concept BatchedInverse = requires(const Kernel &kernel, float *t, std::complex<float> *f, std::ptrdiff_t stride) {
+	kernel.inverse(0, 0, t, stride, f, stride);
 };
 
 template <class K, int log2MaxSize>
@@ -167,6 +185,9 @@ struct Cache
 	typedef KernelPair<typename K::Forward, typename K::Inverse> Entry;
 	typedef std::array<Entry, log2MaxSize + 1> Table;
 
+	static constexpr bool batchedForward = BatchedForward<typename K::Forward>;
+	static constexpr bool batchedInverse = BatchedInverse<typename K::Inverse>;
+
 	Table table;
 
 	inline void prepareForward(int log2TransformLength)
@@ -189,8 +210,11 @@ struct Cache
 
 		const auto transformLength = 1 << log2TransformLength;
 		const auto &kernel = *table[log2TransformLength].forward();
-		for (int c = 0; c < f.cols(); ++c)
-			kernel.forward(log2TransformLength, (float *)t.col(c).topRows(transformLength).data(), f.col(c).topRows(transformLength / 2 + 1).data());
+		if constexpr (batchedForward)
+			kernel.forward(log2TransformLength, (int)f.cols(), (float *)t.data(), t.colStride(), f.data(), f.colStride());
+		else
+			for (int c = 0; c < f.cols(); ++c)
+				kernel.forward(log2TransformLength, (float *)t.col(c).topRows(transformLength).data(), f.col(c).topRows(transformLength / 2 + 1).data());
 	}
 
 	inline void inverse(int log2TransformLength, Eigen::Ref<Eigen::ArrayXXf> t, const Eigen::Ref<const Eigen::ArrayXXcf> &f) const
@@ -203,8 +227,11 @@ struct Cache
 
 		const auto transformLength = 1 << log2TransformLength;
 		const auto &kernel = *table[log2TransformLength].inverse();
-		for (int c = 0; c < f.cols(); ++c)
-			kernel.inverse(log2TransformLength, t.col(c).topRows(transformLength).data(), (std::complex<float> *)f.col(c).topRows(transformLength / 2 + 1).data());
+		if constexpr (batchedInverse)
+			kernel.inverse(log2TransformLength, (int)f.cols(), t.data(), t.colStride(), (std::complex<float> *)f.data(), f.colStride());
+		else
+			for (int c = 0; c < f.cols(); ++c)
+				kernel.inverse(log2TransformLength, t.col(c).topRows(transformLength).data(), (std::complex<float> *)f.col(c).topRows(transformLength / 2 + 1).data());
 	}
 };
 
@@ -15,27 +15,32 @@ using namespace Internal;
 
 Grain::Grain(int log2SynthesisHop, int channelCount) :
 	channelCount(channelCount),
-	log2TransformLength(log2SynthesisHop + 3)
+	log2TransformLength(log2SynthesisHop + 3),
+	groups(channelCount)
 {
 	request.position = request.speed = std::numeric_limits<float>::quiet_NaN();
 	request.pitch = 1.;
-	Fourier::resize<true>(log2TransformLength, 1, energy);
-	Fourier::resize<true>(log2TransformLength, 1, rotation);
-	partials.reserve(1 << log2TransformLength);
 }
 
-InputChunk Grain::specify(const Request &r, Grain &previous, SampleRates sampleRates, int log2SynthesisHop, double bufferStartPosition, Internal::Instrumentation &instrumentation)
+InputChunk Grain::specify(const Request &r, InterpolationMode interpolationMode, double pitchMidpoint, Grain &previous, SampleRates sampleRates, int log2SynthesisHop, int log2TransformLength, double bufferStartPosition, Internal::Instrumentation &instrumentation)
 {
 	request = r;
 	BUNGEE_ASSERT1(request.pitch > 0.);
 
 	const Assert::FloatingPointExceptions floatingPointExceptions(FE_INEXACT);
-	const auto unitHop = (1 << log2SynthesisHop) * resampleOperations.setup(sampleRates, request.pitch, request.resampleMode);
+	const auto unitHop = (1 << log2SynthesisHop) * resampleOperations.setup(sampleRates, request.pitch, request.resampleMode, interpolationMode);
+
+	// Output resampling can follow a pitch curve from the previous grain, unless input resampling shifts pitch instead
+	resampleOperations.output.midpointRatio = 0.;
+	if (pitchMidpoint > 0. && !resampleOperations.input.function)
+		resampleOperations.output.midpointRatio = resampleOperations.output.ratio * pitchMidpoint / request.pitch;
 
 	requestHop = request.position - previous.request.position;
+	inputCopyFrameCount = 0;
+	flux = 0.f;
 
 	if (instrumentation.firstGrain)
-		instrumentation.log("Stretcher: sampleRates=[%d, %d] channelCount=%d  synthesisHop=%d", sampleRates.input, sampleRates.output, inputCopy.cols(), 1 << log2TransformLength >> 3);
+		instrumentation.log("Stretcher: sampleRates=[%d, %d] channelCount=%d  synthesisHop=%d", sampleRates.input, sampleRates.output, channelCount, 1 << log2SynthesisHop);
 	instrumentation.firstGrain = false;
 
 	if (!request.reset && !std::isnan(request.speed) && !std::isnan(requestHop) && std::abs(request.speed * unitHop - requestHop) > 1.)
@@ -67,12 +72,10 @@ InputChunk Grain::specify(const Request &r, Grain &previous, SampleRates sampleR
 			passthrough = 0;
 	}
 
-	log2TransformLength = log2SynthesisHop + 3;
+	this->log2TransformLength = log2TransformLength;
 
 	{
-		int halfInputFrameCount = 1 << log2TransformLength >> 1;
-		if (resampleOperations.input.ratio != 1.f)
-			halfInputFrameCount = int(std::ceil(halfInputFrameCount / resampleOperations.input.ratio)) + 2;
+		const int halfInputFrameCount = Grain::halfInputFrameCount(log2TransformLength, resampleOperations.input.ratio);
 
 		inputChunk.begin = -halfInputFrameCount;
 		inputChunk.end = +halfInputFrameCount;
@@ -88,31 +91,44 @@ InputChunk Grain::specify(const Request &r, Grain &previous, SampleRates sampleR
 	}
 }
 
-void Grain::overlapCheck(Eigen::Ref<Eigen::ArrayXXf> input, int muteFrameCountHead, int muteFrameCountTail, const Grain &previous, Internal::Instrumentation &instrumentation)
+void Grain::selectTransformLength(const Grain &previous, int log2SynthesisHop)
+{
+	// Short transforms resolve transients in time, so follow a grain of high flux until the analysis has moved half a
+	// long transform beyond it; long transforms resolve tones in frequency everywhere else
+	constexpr float transientFlux = 0.5f; // fudge: lower constant helps transients, higher helps tones
+	const int hop = std::abs(analysis.hop);
+	if (!continuous || passthrough)
+		transientDistance = std::numeric_limits<int>::max();
+	else if (previous.flux > transientFlux)
+		transientDistance = hop;
+	else
+		transientDistance = std::min(previous.transientDistance, std::numeric_limits<int>::max() - hop) + hop;
+
+	log2TransformLength = log2SynthesisHop + 3 - (transientDistance < 4 << log2SynthesisHop);
+}
+
+void Grain::overlapCheck(Resample::StridedRef input, int muteFrameCountHead, int muteFrameCountTail, const Grain &previous, Internal::Instrumentation &instrumentation)
 {
 	const auto frameCount = inputChunk.end - inputChunk.begin;
 	const auto activeRows = frameCount - muteFrameCountHead - muteFrameCountTail;
 
-#ifdef EIGEN_RUNTIME_NO_MALLOC
-	Eigen::internal::set_is_malloc_allowed(true);
-#endif
-	inputCopy.resize(frameCount, input.cols());
-#ifdef EIGEN_RUNTIME_NO_MALLOC
-	Eigen::internal::set_is_malloc_allowed(false);
-#endif
+	if (inputCopy.rows() < frameCount)
+		return; // no storage for the copy (see Grains::allocateInputCopies())
 
-	inputCopy.topRows(muteFrameCountHead).setZero();
-	inputCopy.middleRows(muteFrameCountHead, activeRows) = input.middleRows(muteFrameCountHead, activeRows);
-	inputCopy.bottomRows(muteFrameCountTail).setZero();
+	auto copy = inputCopy.topRows(frameCount);
+	copy.topRows(muteFrameCountHead).setZero();
+	copy.middleRows(muteFrameCountHead, activeRows) = input.middleRows(muteFrameCountHead, activeRows);
+	copy.bottomRows(muteFrameCountTail).setZero();
+	inputCopyFrameCount = frameCount;
 
-	if (!inputCopy.isFinite().all())
+	if (!copy.isFinite().all())
 		instrumentation.log("BAD INPUT: input audio is not all finite samples");
 
 	const auto overlapStart = std::max(inputChunk.begin, previous.inputChunk.begin);
 	const auto overlapEnd = std::min(inputChunk.end, previous.inputChunk.end);
 	const auto overlapFrames = overlapEnd - overlapStart;
 
-	if (overlapFrames > 0 && previous.inputCopy.rows() > 0)
+	if (overlapFrames > 0 && previous.inputCopyFrameCount)
 	{
 		const auto overlapCurrent = inputCopy.middleRows(overlapStart - inputChunk.begin, overlapFrames);
 		const auto overlapPrevious = previous.inputCopy.middleRows(overlapStart - previous.inputChunk.begin, overlapFrames);
@@ -128,10 +144,12 @@ void Grain::overlapCheck(Eigen::Ref<Eigen::ArrayXXf> input, int muteFrameCountHe
 	}
 }
 
-Eigen::Ref<Eigen::ArrayXXf> Grain::resampleInput(Eigen::Ref<Eigen::ArrayXXf> input, int log2WindowLength, int &muteFrameCountHead, int &muteFrameCountTail, Resample::Internal &resampled)
+Resample::StridedRef Grain::resampleInput(Resample::StridedRef input, int log2WindowLength, int &muteFrameCountHead, int &muteFrameCountTail, Resample::Internal &resampled, Internal::Instrumentation &instrumentation)
 {
 	if (resampleOperations.input.function)
 	{
+		const Internal::Instrumentation::Timer timer(instrumentation, statsPhase_inputResample);
+
 		BUNGEE_ASSERT1(input.rows() % 2 == 0);
 
 		resampled.offset = inputPosition - request.position - input.rows() / 2;
@@ -140,7 +158,7 @@ Eigen::Ref<Eigen::ArrayXXf> Grain::resampleInput(Eigen::Ref<Eigen::ArrayXXf> inp
 		resampled.offset -= analysis.positionError;
 
 		Resample::External external(input, muteFrameCountHead, muteFrameCountTail);
-		resampleOperations.input.function(resampled, external, resampleOperations.input.ratio, resampleOperations.input.ratio, false);
+		resampleOperations.input.function(resampled, external, resampleOperations.input.ratio, resampleOperations.input.ratio, 0., false);
 
 		muteFrameCountHead = muteFrameCountTail = 0;
 
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "Arena.h"
 #include "Assert.h"
 #include "Fourier.h"
 #include "Instrumentation.h"
@@ -17,9 +18,11 @@
 #include <Eigen/Core>
 
 #include <array>
+#include <cmath>
 #include <complex>
 #include <memory>
 #include <numbers>
+#include <vector>
 
 namespace Bungee {
 
@@ -43,6 +46,10 @@ struct Grain
 	int validBinCount{};
 	int muteFrameCountHead{};
 	int muteFrameCountTail{};
+	bool silent{}; // spectrum is zero, so transforms are skipped
+	bool bypass{}; // passthrough grain whose windowed input is overlap-added without transforms
+	float flux{}; // energy flux at the grain's peaks, from Partials::suppressTransientPartials(), greatest of its groups
+	int transientDistance{}; // analysed frames since the latest grain of high flux, in multi-resolution mode
 
 	Resample::Operations resampleOperations{};
 
@@ -50,15 +57,41 @@ struct Grain
 	InputChunk inputChunk{};
 	Analysis analysis{};
 
-	Eigen::ArrayX<Phase::Type> phase;
-	Eigen::ArrayXf energy;
-	Eigen::ArrayX<Phase::Type> rotation;
-	std::vector<Partials::Partial> partials;
-	Eigen::ArrayXXf inputCopy;
+	// The channels of a group share phase, energy, rotation and partials, so that they stay coherent
+	struct Group
+	{
+		Mapped<Eigen::ArrayX<Phase::Type>> phase;
+		Mapped<Eigen::ArrayXf> energy;
+		Mapped<Eigen::ArrayX<Phase::Type>> rotation;
+		Partials::List partials;
+	};
+
+	// Buffers of the most recent grains, bound by Grains to storage in the stretcher's arena: one group
+	// for each channel, of which the stretcher's channel groups use the first
+	std::vector<Group> groups;
+	Mapped<Eigen::ArrayXXf> windowedInput; // of a bypass grain
+
+	// Input checked by overlapCheck(), bound by Grains only while instrumentation or self test needs it
+	Mapped<Eigen::ArrayXXf> inputCopy;
+	int inputCopyFrameCount{};
 
 	Grain(int log2SynthesisHop, int channelCount);
 
-	InputChunk specify(const Request &request, Grain &previous, SampleRates sampleRates, int log2SynthesisHop, double bufferStartPosition, Internal::Instrumentation &instrumentation);
+	// Analysis uses a transform of length 2^log2TransformLength, unless selectTransformLength() shortens it
+	InputChunk specify(const Request &request, InterpolationMode interpolationMode, double pitchMidpoint, Grain &previous, SampleRates sampleRates, int log2SynthesisHop, int log2TransformLength, double bufferStartPosition, Internal::Instrumentation &instrumentation);
+
+	// Input frames either side of a grain's position that its analysis reads: enough for a transform of the given length,
+	// whatever selectTransformLength() chooses, before input resampling by inputRatio
+	static inline int halfInputFrameCount(int log2TransformLength, double inputRatio)
+	{
+		int halfInputFrameCount = 1 << (log2TransformLength - 1);
+		if (inputRatio != 1.f)
+			halfInputFrameCount = int(std::ceil(halfInputFrameCount / inputRatio)) + 2;
+		return halfInputFrameCount;
+	}
+
+	// Multi-resolution mode: chooses between transforms of 4 and 8 synthesis hops from the flux of previous grains
+	void selectTransformLength(const Grain &previous, int log2SynthesisHop);
 
 	bool reverse() const
 	{
@@ -72,7 +105,7 @@ struct Grain
 
 	void applyEnvelope();
 
-	auto inputChunkMap(const float *data, std::ptrdiff_t stride, int &muteFrameCountHead, int &muteFrameCountTail, const Grain &previous, Internal::Instrumentation &instrumentation)
+	void clampMuteFrameCounts(const void *data, int &muteFrameCountHead, int &muteFrameCountTail) const
 	{
 		const auto frameCount = inputChunk.end - inputChunk.begin;
 
@@ -82,13 +115,20 @@ struct Grain
 			muteFrameCountTail = 0;
 		}
 
-		typedef Eigen::OuterStride<Eigen::Dynamic> Stride;
-		typedef Eigen::Map<Eigen::ArrayXXf, 0, Stride> Map;
-
 		muteFrameCountHead = std::clamp<int>(muteFrameCountHead, 0, frameCount);
 		muteFrameCountTail = std::clamp<int>(muteFrameCountTail, 0, frameCount);
+	}
+
+	auto inputChunkMap(const float *data, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int &muteFrameCountHead, int &muteFrameCountTail, const Grain &previous, Internal::Instrumentation &instrumentation)
+	{
+		const auto frameCount = inputChunk.end - inputChunk.begin;
+
+		clampMuteFrameCounts(data, muteFrameCountHead, muteFrameCountTail);
+
+		typedef Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic> Stride;
+		typedef Eigen::Map<Eigen::ArrayXXf, 0, Stride> Map;
 
-		Map m((float *)data, frameCount, channelCount, Stride(stride));
+		Map m((float *)data, frameCount, channelCount, Stride(channelStride, frameStride));
 		BUNGEE_ASSERT2(!m.middleRows(muteFrameCountHead, m.rows() - muteFrameCountHead - muteFrameCountTail).hasNaN());
 
 		if (instrumentation.enabled || Bungee::Assert::level)
@@ -98,9 +138,9 @@ struct Grain
 		return m;
 	}
 
-	void overlapCheck(Eigen::Ref<Eigen::ArrayXXf> input, int muteFrameCountHead, int muteFrameCountTail, const Grain &previous, Internal::Instrumentation &instrumentation);
+	void overlapCheck(Resample::StridedRef input, int muteFrameCountHead, int muteFrameCountTail, const Grain &previous, Internal::Instrumentation &instrumentation);
 
-	Eigen::Ref<Eigen::ArrayXXf> resampleInput(Eigen::Ref<Eigen::ArrayXXf> input, int log2WindowLength, int &muteFrameCountHead, int &muteFrameCountTail, Resample::Internal &resampled);
+	Resample::StridedRef resampleInput(Resample::StridedRef input, int log2WindowLength, int &muteFrameCountHead, int &muteFrameCountTail, Resample::Internal &resampled, Internal::Instrumentation &instrumentation);
 };
 
 } // namespace Bungee
@@ -5,6 +5,8 @@
 
 #include "log2.h"
 
+#include <new>
+
 namespace Bungee {
 
 bool Grains::flushed() const
@@ -15,19 +17,86 @@ bool Grains::flushed() const
 	return true;
 }
 
+void Grains::allocate(Arena &arena, int log2TransformLength, int channelCount)
+{
+	Fourier::allocate<true>(arena, log2TransformLength, maxBufferedCount * channelCount, phase);
+	Fourier::allocate<true>(arena, log2TransformLength, maxBufferedCount * channelCount, energy);
+	Fourier::allocate<true>(arena, log2TransformLength, maxBufferedCount * channelCount, rotation);
+	Fourier::allocate<false>(arena, log2TransformLength, maxBufferedCount * channelCount, windowedInput);
+	partials = arena.allocate<Partials::Partial>((maxBufferedCount * channelCount) << log2TransformLength);
+}
+
 void Grains::prepare()
 {
 	const auto log2TransformLength = (*this)[0].log2TransformLength;
+	const auto channelCount = (*this)[0].channelCount;
+
+	// Only the first bufferedCount grains need these buffers.
+	BUNGEE_ASSERT1(bufferedCount <= maxBufferedCount && bufferedCount < vector.size());
+	for (int i = 0; i < vector.size(); ++i)
+	{
+		auto &grain = (*this)[i];
+		const bool buffered = i < bufferedCount;
+
+		const auto bind = [&](auto &array, auto &storage, int col, int cols) {
+			array.rebind(buffered ? storage.col(col).data() : nullptr, buffered ? storage.rows() : 0, cols);
+		};
+		const auto capacity = 1 << log2TransformLength;
+		for (int g = 0; g < channelCount; ++g)
+		{
+			auto &group = grain.groups[g];
+			const int col = i * channelCount + g;
+			bind(group.phase, phase, col, 1);
+			bind(group.energy, energy, col, 1);
+			bind(group.rotation, rotation, col, 1);
+			group.partials = buffered ? Partials::List(partials + col * capacity, capacity) : Partials::List();
+		}
+		bind(grain.windowedInput, windowedInput, i * channelCount, channelCount);
+		if (inputCopies.size())
+			bind(grain.inputCopy, inputCopies, i * channelCount, channelCount);
+		grain.inputCopyFrameCount = 0;
+	}
+
+	if constexpr (Assert::level)
+	{
+		phase.setConstant(Fourier::uninitialisedValue<Phase::Type>());
+		energy.setConstant(Fourier::uninitialisedValue<float>());
+		rotation.setConstant(Fourier::uninitialisedValue<Phase::Type>());
+		windowedInput.setConstant(Fourier::uninitialisedValue<float>());
+	}
+}
+
+void Grains::allocateInputCopies(int frameCount)
+{
+	if (!inputCopyArena.measuring())
+	{
+		BUNGEE_ASSERT1(inputCopies.rows() >= frameCount);
+		return;
+	}
+
+	// Rows are padded so that each grain's copy is aligned
+	constexpr int align = EIGEN_MAX_ALIGN_BYTES / sizeof(float);
+	const int rows = (frameCount + align - 1) / align * align;
+	const int cols = maxBufferedCount * (*this)[0].channelCount;
+	inputCopyArena.allocate(inputCopies, rows, cols);
+	try
+	{
+		inputCopyArena.allocate();
+	}
+	catch (const std::bad_alloc &)
+	{
+		inputCopies.rebind(nullptr, 0, 0);
+		return;
+	}
+	inputCopyArena.allocate(inputCopies, rows, cols);
 
-	// Only grains 0 and 1 need these buffers.
-	Fourier::resize<true>(log2TransformLength, 1, (*this)[0].phase);
-	Fourier::resize<true>(log2TransformLength, 1, (*this)[1].phase);
-	Fourier::resize<true>(log2TransformLength, 1, (*this)[0].energy);
-	Fourier::resize<true>(log2TransformLength, 1, (*this)[1].energy);
-	Fourier::resize<true>(log2TransformLength, 1, (*this)[0].rotation);
-	Fourier::resize<true>(log2TransformLength, 1, (*this)[1].rotation);
-	(*this)[0].partials.reserve(1 << log2TransformLength);
-	(*this)[1].partials.reserve(1 << log2TransformLength);
+	for (int i = 0; i < vector.size(); ++i)
+	{
+		auto &grain = (*this)[i];
+		const bool buffered = i < bufferedCount;
+		grain.inputCopy.rebind(buffered ? inputCopies.col(i * grain.channelCount).data() : nullptr, buffered ? inputCopies.rows() : 0, grain.channelCount);
+		grain.inputCopyFrameCount = 0;
+	}
 }
 
 void Grains::rotate()
@@ -37,11 +106,10 @@ void Grains::rotate()
 		vector[i] = std::move(vector[i - 1]);
 	vector.front() = std::move(grain);
 
-	// Only grains 0 and 1 need these buffers. Swap them around to avoid reallocating.
-	std::swap((*this)[0].phase, (*this)[2].phase);
-	std::swap((*this)[0].energy, (*this)[2].energy);
-	std::swap((*this)[0].rotation, (*this)[2].rotation);
-	std::swap((*this)[0].partials, (*this)[2].partials);
+	// Only the first bufferedCount grains need these buffers. Swap them around to avoid reallocating.
+	std::swap((*this)[0].groups, (*this)[bufferedCount].groups);
+	swap((*this)[0].windowedInput, (*this)[bufferedCount].windowedInput);
+	swap((*this)[0].inputCopy, (*this)[bufferedCount].inputCopy);
 }
 
 } // namespace Bungee
@@ -14,13 +14,40 @@ struct Grains
 {
 	std::vector<std::unique_ptr<Grain>> vector;
 
-	Grains(size_t n) :
-		vector(n)
+	// Number of most recent grains that need phase, energy, rotation, partials and windowed input buffers
+	int bufferedCount = 2;
+
+	// As needed when pipelined
+	static constexpr int maxBufferedCount = 3;
+
+	// Storage for the buffers of each buffered grain, in the stretcher's arena: channelCount columns per grain, one
+	// for each possible channel group or, for windowed input, channel, so that state of the same kind for successive grains is adjacent
+	Mapped<Eigen::ArrayXX<Phase::Type>> phase;
+	Mapped<Eigen::ArrayXXf> energy;
+	Mapped<Eigen::ArrayXX<Phase::Type>> rotation;
+	Mapped<Eigen::ArrayXXf> windowedInput;
+	Partials::Partial *partials{};
+
+	// Copies of the input of buffered grains, for checks of instrumentation and self test, allocated on demand in an
+	// arena of their own, from the stretcher's allocator, because instrumentation may be enabled at any time
+	Arena inputCopyArena;
+	Mapped<Eigen::ArrayXXf> inputCopies;
+
+	Grains(size_t n, const Allocator *allocator = nullptr) :
+		vector(n),
+		inputCopyArena(allocator)
 	{
 	}
 
+	void allocate(Arena &arena, int log2TransformLength, int channelCount);
+
+	// Binds buffers to the first bufferedCount grains
 	void prepare();
 
+	// Allocates, unless already allocated, storage for copies of input chunks of up to frameCount frames, or leaves
+	// grains without copies, so unchecked, if allocation fails
+	void allocateInputCopies(int frameCount);
+
 	void rotate();
 
 	bool flushed() const;
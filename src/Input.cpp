@@ -4,6 +4,9 @@
 #include "Input.h"
 #include "Grain.h"
 #include "Instrumentation.h"
+#include "Samples.h"
+#include "Shape.h"
+#include "Window.h"
 #include "log2.h"
 
 #include <numbers>
@@ -15,51 +18,192 @@ using namespace Internal;
 namespace {
 static constexpr float pi = std::numbers::pi_v<float>;
 static constexpr float gain = (3 * pi) / (3 * pi + 8);
+
+// The short window's product with the synthesis window overlap-adds to 3/2 without correction
+static constexpr float shortGain = 2.f / 3;
+
+float silentEnergyOf(const Eigen::Ref<const Eigen::ArrayXf> &window, int channelCount)
+{
+	return channelCount * Input::silenceLevel * Input::silenceLevel * window.square().sum();
+}
 } // namespace
 
 Input::Input(int log2SynthesisHop, int channelCount, Fourier::Transforms &transforms) :
-	window(Window::fromFrequencyDomainCoefficients(transforms, log2SynthesisHop + 3, gain / (8 << log2SynthesisHop), {1.f, 0.5f})),
-	windowedInput{8 << log2SynthesisHop, channelCount},
-	resampled(8 << log2SynthesisHop, channelCount)
+	sharedWindow(Window::shared(log2SynthesisHop + 3, gain / (8 << log2SynthesisHop), {1.f, 0.5f})),
+	window(sharedWindow->data(), sharedWindow->rows()),
+	longSilentEnergy(silentEnergyOf(window, channelCount)),
+	silentEnergy(longSilentEnergy)
 {
-	windowedInput.setZero();
 	transforms.prepareForward(log2SynthesisHop + 3);
 	resampled.frameCount = 8 << log2SynthesisHop;
 }
 
-int Input::applyAnalysisWindow(const Eigen::Ref<const Eigen::ArrayXXf> &input, int muteFrameCountHead, int muteFrameCountTail)
+void Input::prepareShortWindow(int log2SynthesisHop, int channelCount, Fourier::Transforms &transforms)
 {
-	const int half = (int)window.rows() / 2;
-	BUNGEE_ASSERT1(input.rows() % 2 == 0);
-	const int unused = std::max<int>((int)input.rows() / 2 - half, 0);
-	muteFrameCountHead -= unused;
-	muteFrameCountTail -= unused;
+	if (shortWindow)
+		return;
+
+	shortWindow = Window::shared(log2SynthesisHop + 2, shortGain / (4 << log2SynthesisHop), {1.f, 0.5f});
+	shortWindowGain = shortWindow->sum() / window.sum();
+	shortSilentEnergy = silentEnergyOf(*shortWindow, channelCount);
+	transforms.prepareForward(log2SynthesisHop + 2);
+}
+
+void Input::allocate(Arena &arena, int log2SynthesisHop, int channelCount, int maxInputFrameCount)
+{
+	arena.allocate(windowedInput, 8 << log2SynthesisHop, channelCount);
+	resampled.allocate(arena, 8 << log2SynthesisHop, channelCount);
+	arena.allocate(converted, maxInputFrameCount, channelCount);
+	arena.allocate(channelEnergy, channelCount);
+
+	if (!arena.measuring())
+		windowedInput.setZero();
+}
 
+namespace {
+
+// Reads samples of a non-float format as Eigen expressions, converting them on the fly
+template <class Sample>
+struct Converted
+{
+	struct Column
 	{
-		// top half of window, bottom half of input -> top half of output
-		const int muteHead = std::clamp(muteFrameCountHead - half, 0, half);
-		const int muteTail = std::clamp(muteFrameCountTail, 0, half);
-		const int unmuted = half - muteHead - muteTail;
-
-		windowedInput.topRows(muteHead).setZero();
-		windowedInput.middleRows(muteHead, unmuted) = input.middleRows(input.rows() / 2 + muteHead, unmuted).colwise() * window.segment(muteHead, unmuted);
-		windowedInput.middleRows(half - muteTail, muteTail).setZero();
-	}
+		const Sample *data;
+		std::ptrdiff_t frameStride;
+		Eigen::Index frameCount;
+
+		Eigen::Index rows() const
+		{
+			return frameCount;
+		}
+
+		auto segment(Eigen::Index start, Eigen::Index length) const
+		{
+			return Eigen::ArrayXf::NullaryExpr(length, [p = data + start * frameStride, s = frameStride](Eigen::Index i) { return Samples::toFloat(p[i * s]); });
+		}
+	};
+
+	const Sample *data;
+	std::ptrdiff_t channelStride;
+	std::ptrdiff_t frameStride;
+	Eigen::Index frameCount;
 
+	Column col(Eigen::Index c) const
 	{
-		// bottom half of window , top half of input, -> bottom half of output
-		const int muteHead = std::clamp(muteFrameCountHead, 0, half);
-		const int muteTail = std::clamp(muteFrameCountTail - half, 0, half);
-		const int unmuted = half - muteHead - muteTail;
-
-		windowedInput.middleRows(half, muteHead).setZero();
-		windowedInput.middleRows(half + muteHead, unmuted) = input.middleRows(input.rows() / 2 - half + muteHead, unmuted).colwise() * window.segment(window.rows() - muteTail - unmuted, unmuted);
-		windowedInput.bottomRows(muteTail).setZero();
+		return Column{data + c * channelStride, frameStride, frameCount};
 	}
+};
+
+template <class Shape, class In>
+void windowChannels(const In &input, Eigen::Index inputFrameCount, Input &destination, const Eigen::Ref<const Eigen::ArrayXf> &window, int muteFrameCountHead, int muteFrameCountTail, Workers &workers, Input::Windowed windowed)
+{
+	auto &windowedInput = destination.windowedInput;
+	const int half = (int)window.rows() / 2;
+	BUNGEE_ASSERT1(inputFrameCount % 2 == 0);
+	const int unused = std::max<int>((int)inputFrameCount / 2 - half, 0);
+	muteFrameCountHead -= unused;
+	muteFrameCountTail -= unused;
+
+	const auto windowChannel = [&](int c) {
+		auto in = input.col(c);
+
+		if constexpr (Shape::fixedLog2SynthesisHop != 0)
+			if (muteFrameCountHead <= 0 && muteFrameCountTail <= 0 && half == 4 << Shape::fixedLog2SynthesisHop)
+			{
+				// Unmuted grain of the usual, long window: both halves with compile-time sizes
+				constexpr int n = 4 << Shape::fixedLog2SynthesisHop;
+				auto out = windowedInput.col(c);
+				out.template head<n>() = in.template segment<n>(in.rows() / 2) * window.template head<n>();
+				out.template tail<n>() = in.template segment<n>(in.rows() / 2 - n) * window.template tail<n>();
+				return;
+			}
+
+		// Only the rows of this window's transform, which are fewer than windowedInput's for a short window
+		auto out = windowedInput.col(c).head(window.rows());
+
+		{
+			// top half of window, bottom half of input -> top half of output
+			const int muteHead = std::clamp(muteFrameCountHead - half, 0, half);
+			const int muteTail = std::clamp(muteFrameCountTail, 0, half);
+			const int unmuted = half - muteHead - muteTail;
+
+			out.head(muteHead).setZero();
+			out.segment(muteHead, unmuted) = in.segment(in.rows() / 2 + muteHead, unmuted) * window.segment(muteHead, unmuted);
+			out.segment(half - muteTail, muteTail).setZero();
+		}
+
+		{
+			// bottom half of window , top half of input, -> bottom half of output
+			const int muteHead = std::clamp(muteFrameCountHead, 0, half);
+			const int muteTail = std::clamp(muteFrameCountTail - half, 0, half);
+			const int unmuted = half - muteHead - muteTail;
+
+			out.segment(half, muteHead).setZero();
+			out.segment(half + muteHead, unmuted) = in.segment(in.rows() / 2 - half + muteHead, unmuted) * window.segment(window.rows() - muteTail - unmuted, unmuted);
+			out.tail(muteTail).setZero();
+		}
+	};
+
+	workers.forEach(Shape::channelCount((int)windowedInput.cols()), [&](int c) {
+		windowChannel(c);
+		destination.channelEnergy[c] = windowedInput.col(c).head(window.rows()).square().sum();
+		if (windowed.function)
+			windowed.function(windowed.context, c);
+	});
+}
+
+} // namespace
+
+template <class Shape>
+int Input::applyAnalysisWindow(const Resample::StridedRef &input, const Eigen::Ref<const Eigen::ArrayXf> &window, int muteFrameCountHead, int muteFrameCountTail, Workers &workers, Windowed windowed)
+{
+	silentEnergy = window.rows() == this->window.rows() ? longSilentEnergy : shortSilentEnergy;
+
+	// Contiguous channels, the usual case, are windowed with vectorised expressions
+	if (input.rowStride() == 1)
+		windowChannels<Shape>(Eigen::Map<const Eigen::ArrayXXf, 0, Eigen::OuterStride<>>(input.data(), input.rows(), input.cols(), Eigen::OuterStride<>(input.colStride())), input.rows(), *this, window, muteFrameCountHead, muteFrameCountTail, workers, windowed);
+	else
+		windowChannels<DynamicShape>(input, input.rows(), *this, window, muteFrameCountHead, muteFrameCountTail, workers, windowed);
 
 	scale = window[0];
 
-	return Bungee::log2((int)windowedInput.rows());
+	if constexpr (Shape::fixedLog2SynthesisHop != 0)
+		return Shape::fixedLog2SynthesisHop + 3 - (window.rows() != 8 << Shape::fixedLog2SynthesisHop);
+	else
+		return Bungee::log2((int)window.rows());
+}
+
+#define X_SHAPE(c, h) template int Input::applyAnalysisWindow<Shape<c, h>>(const Resample::StridedRef &, const Eigen::Ref<const Eigen::ArrayXf> &, int, int, Workers &, Windowed);
+BUNGEE_SHAPES
+X_SHAPE(0, 0)
+#undef X_SHAPE
+
+int Input::applyAnalysisWindow(SampleFormat sampleFormat, const void *data, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int frameCount, const Eigen::Ref<const Eigen::ArrayXf> &window, int muteFrameCountHead, int muteFrameCountTail, Workers &workers, Windowed windowed)
+{
+	silentEnergy = window.rows() == this->window.rows() ? longSilentEnergy : shortSilentEnergy;
+
+	Samples::dispatch(sampleFormat, data, [&](auto *samples) {
+		typedef std::remove_cv_t<std::remove_pointer_t<decltype(samples)>> Sample;
+		windowChannels<DynamicShape>(Converted<Sample>{samples, channelStride, frameStride, frameCount}, frameCount, *this, window, muteFrameCountHead, muteFrameCountTail, workers, windowed);
+	});
+
+	scale = window[0];
+
+	return Bungee::log2((int)window.rows());
+}
+
+Resample::StridedRef Input::convert(SampleFormat sampleFormat, const void *data, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int frameCount, int muteFrameCountHead, int muteFrameCountTail)
+{
+	BUNGEE_ASSERT1(frameCount <= converted.rows());
+
+	const int unmuted = frameCount - muteFrameCountHead - muteFrameCountTail;
+	Samples::dispatch(sampleFormat, data, [&](auto *samples) {
+		for (int c = 0; c < converted.cols(); ++c)
+			for (int i = muteFrameCountHead; i < muteFrameCountHead + unmuted; ++i)
+				converted(i, c) = Samples::toFloat(samples[i * frameStride + c * channelStride]);
+	});
+
+	return converted.topRows(frameCount);
 }
 
 } // namespace Bungee
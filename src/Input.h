@@ -3,26 +3,87 @@
 
 #pragma once
 
+#include "Arena.h"
 #include "Assert.h"
 #include "Fourier.h"
 #include "Resample.h"
+#include "Workers.h"
 
 #include <Eigen/Core>
 
+#include <memory>
+
 namespace Bungee {
 
 struct Input
 {
-	Eigen::ArrayXf window;
-	Eigen::ArrayXXf windowedInput;
-	Eigen::ArrayXXf windowedInputPrevious;
+	const std::shared_ptr<const Eigen::ArrayXf> sharedWindow;
+	const Eigen::Map<const Eigen::ArrayXf, Eigen::AlignedMax> window;
+	Mapped<Eigen::ArrayXXf> windowedInput;
 	Resample::Internal resampled;
+	Mapped<Eigen::ArrayXXf> converted;
 	float scale;
 
+	// Window of half the length, for the short transforms of multi-resolution mode, once prepareShortWindow() is called
+	std::shared_ptr<const Eigen::ArrayXf> shortWindow;
+
+	// Ratio of the short window's sum to the long window's: that of the spectral peaks of a sinusoid
+	float shortWindowGain{};
+
+	// Windowed input energy at or below which a grain is treated as silent: that of a signal at silenceLevel on every
+	// channel, for the window that applyAnalysisWindow() last applied
+	static constexpr float silenceLevel = 1.f / (1 << 24);
+	const float longSilentEnergy;
+	float shortSilentEnergy{};
+	float silentEnergy;
+
+	// Energy of each channel of windowedInput
+	Mapped<Eigen::ArrayXf> channelEnergy;
+
+	// Called with each channel, on the thread that windowed it, as soon as the channel is windowed and its energy known
+	struct Windowed
+	{
+		void (*function)(const void *context, int c){};
+		const void *context{};
+
+		template <class F>
+		static inline Windowed of(const F &f)
+		{
+			return {[](const void *context, int c) { (*static_cast<const F *>(context))(c); }, &f};
+		}
+	};
+
 	Input(int log2SynthesisHop, int channelCount, Fourier::Transforms &transforms);
 
-	// returns transformLength
-	int applyAnalysisWindow(const Eigen::Ref<const Eigen::ArrayXXf> &input, int muteFrameCountHead, int muteFrameCountTail);
+	// Allocates, unless already prepared, the short window and its forward transform
+	void prepareShortWindow(int log2SynthesisHop, int channelCount, Fourier::Transforms &transforms);
+
+	// Analysis window for transforms of the given length
+	inline Eigen::Map<const Eigen::ArrayXf, Eigen::AlignedMax> windowFor(int log2TransformLength) const
+	{
+		if (shortWindow && Fourier::transformLength(log2TransformLength) == shortWindow->rows())
+			return {shortWindow->data(), shortWindow->rows()};
+		return window;
+	}
+
+	// lays out buffers in the stretcher's arena
+	void allocate(Arena &arena, int log2SynthesisHop, int channelCount, int maxInputFrameCount);
+
+	// returns log2 of the window length, which is the transform length; channels are windowed in parallel by workers
+	template <class Shape>
+	int applyAnalysisWindow(const Resample::StridedRef &input, const Eigen::Ref<const Eigen::ArrayXf> &window, int muteFrameCountHead, int muteFrameCountTail, Workers &workers, Windowed windowed);
+
+	// as above, converting samples of another format as the window is applied
+	int applyAnalysisWindow(SampleFormat sampleFormat, const void *data, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int frameCount, const Eigen::Ref<const Eigen::ArrayXf> &window, int muteFrameCountHead, int muteFrameCountTail, Workers &workers, Windowed windowed);
+
+	// converts the unmuted frames of a grain's input to float, for processing that needs float input
+	Resample::StridedRef convert(SampleFormat sampleFormat, const void *data, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int frameCount, int muteFrameCountHead, int muteFrameCountTail);
+
+	// true when windowedInput is too quiet to be heard, for example because the grain is muted or in a pause
+	inline bool silent() const
+	{
+		return channelEnergy.sum() <= silentEnergy;
+	}
 };
 
 } // namespace Bungee
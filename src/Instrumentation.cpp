@@ -13,33 +13,195 @@
 #	include <cstdio>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
 
 #include <Eigen/Core>
 
 namespace Bungee::Internal {
 
+#ifndef BUNGEE_NO_LOG
+namespace {
+
+static void write(const char *message)
+{
+#	if defined(__ANDROID__)
+	__android_log_print(ANDROID_LOG_DEBUG, "Bungee", "%s", message);
+#	elif defined(__APPLE__)
+	static const auto log = os_log_create("com.parabolaresearch.bungee", "diagnostics");
+	os_log_info(log, "%{public}s", message);
+#	else
+	fprintf(stderr, "Bungee: %s\n", message);
+#	endif
+}
+
+// Messages of real-time callers, formatted by the caller into a fixed ring of slots and written out by a background
+// thread. The ring is a bounded multi-producer queue: a producer claims a slot by compare-exchange of head and
+// publishes it by the slot's sequence number, so producers neither lock nor wait, and drop messages when it is full.
+struct Ring
+{
+	static constexpr int slotCount = 64;
+
+	struct Slot
+	{
+		std::atomic<uint32_t> sequence;
+		char message[512];
+	};
+
+	Slot slots[slotCount];
+	std::atomic<uint32_t> head{};
+	uint32_t tail{}; // read and written only by the background thread
+	std::atomic<uint32_t> dropped{};
+
+	std::once_flag started;
+	std::atomic<bool> stop{};
+	std::thread thread;
+
+	Ring()
+	{
+		for (int i = 0; i < slotCount; ++i)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~Ring()
+	{
+		if (thread.joinable())
+		{
+			stop.store(true, std::memory_order_relaxed);
+			thread.join();
+		}
+		drain();
+	}
+
+	void start()
+	{
+		std::call_once(started, [this]() { thread = std::thread(&Ring::run, this); });
+	}
+
+	void push(const char *format, va_list args)
+	{
+		auto position = head.load(std::memory_order_relaxed);
+		while (true)
+		{
+			auto &slot = slots[position % slotCount];
+			const auto difference = int32_t(slot.sequence.load(std::memory_order_acquire) - position);
+			if (difference < 0)
+			{
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			if (difference == 0 && head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				vsnprintf(slot.message, sizeof(slot.message), format, args);
+				slot.sequence.store(position + 1, std::memory_order_release);
+				return;
+			}
+
+			if (difference > 0)
+				position = head.load(std::memory_order_relaxed);
+		}
+	}
+
+	void drain()
+	{
+		for (;; ++tail)
+		{
+			auto &slot = slots[tail % slotCount];
+			if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+				break;
+			write(slot.message);
+			slot.sequence.store(tail + slotCount, std::memory_order_release);
+		}
+
+		if (const auto count = dropped.exchange(0, std::memory_order_relaxed))
+		{
+			char message[64];
+			snprintf(message, sizeof(message), "%u messages were dropped because the log ring was full", count);
+			write(message);
+		}
+	}
+
+	void run()
+	{
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			drain();
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+};
+
+// Constructed by enableRealTime(), so that the real-time callers of log() never run its initialisation
+static Ring &ring()
+{
+	static Ring ring;
+	return ring;
+}
+
+} // namespace
+#endif
+
 void Instrumentation::log(const char *format, ...)
 {
 #ifndef BUNGEE_NO_LOG
 	if (enabled)
 	{
-		char message[4096];
-
 		va_list args;
 		va_start(args, format);
-		vsnprintf(message, sizeof(message), format, args);
+		if (realTime)
+		{
+			ring().push(format, args);
+		}
+		else
+		{
+			char message[4096];
+			vsnprintf(message, sizeof(message), format, args);
+			write(message);
+		}
 		va_end(args);
+	}
+#endif
+}
 
-#	if defined(__ANDROID__)
-		__android_log_print(ANDROID_LOG_DEBUG, "Bungee", "%s", message);
-#	elif defined(__APPLE__)
-		static const auto log = os_log_create("com.parabolaresearch.bungee", "diagnostics");
-		os_log_info(log, "%{public}s", message);
-#	else
-		fprintf(stderr, "Bungee: %s\n", message);
-#	endif
+void Instrumentation::enableRealTime(bool enable)
+{
+#ifndef BUNGEE_NO_LOG
+	if (enable)
+		ring().start();
+#endif
+	realTime = enable;
+}
+
+#ifndef BUNGEE_NO_STATS
+void Instrumentation::Histogram::add(uint64_t nanoseconds)
+{
+	const auto bin = std::clamp<int>(std::bit_width(nanoseconds) - 1, 0, 31);
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	totalNanoseconds.store(totalNanoseconds.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+	bins[bin].store(bins[bin].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+#endif
+
+void Instrumentation::getStats(Stats &stats) const
+{
+	std::memset(&stats, 0, sizeof(stats));
+#ifndef BUNGEE_NO_STATS
+	for (int p = 0; p < statsPhase_count; ++p)
+	{
+		auto &phase = stats.phases[p];
+		phase.count = histograms[p].count.load(std::memory_order_relaxed);
+		phase.totalNanoseconds = histograms[p].totalNanoseconds.load(std::memory_order_relaxed);
+		for (int k = 0; k < 32; ++k)
+			phase.bins[k] = histograms[p].bins[k].load(std::memory_order_relaxed);
 	}
 #endif
 }
@@ -49,6 +211,7 @@ Instrumentation::Call::Call(Instrumentation &instrumentation, int sequence)
 	if (sequence != instrumentation.expected)
 	{
 		static const char *names[] = {"specifyGrain", "analyseGrain", "synthesiseGrain"};
+		instrumentation.realTime = false; // written directly, as the process is about to abort
 		instrumentation.log("FATAL: stretcher functions called in the wrong order: %s was called when expecting a call to %s", names[sequence], names[instrumentation.expected]);
 		std::abort();
 	}
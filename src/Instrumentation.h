@@ -3,6 +3,13 @@
 
 #pragma once
 
+#include "bungee/Bungee.h"
+
+#ifndef BUNGEE_NO_STATS
+#	include <atomic>
+#	include <chrono>
+#endif
+
 namespace Bungee::Internal {
 
 struct Instrumentation
@@ -13,16 +20,59 @@ struct Instrumentation
 		~Call();
 	};
 
+#ifndef BUNGEE_NO_STATS
+	// Written only by the thread processing the phase and read by getStats(), so relaxed loads and stores suffice
+	struct Histogram
+	{
+		std::atomic<uint64_t> count{};
+		std::atomic<uint64_t> totalNanoseconds{};
+		std::atomic<uint64_t> bins[32]{};
+
+		void add(uint64_t nanoseconds);
+	};
+
+	Histogram histograms[statsPhase_count];
+#endif
+
+	// Times one phase of grain processing for getStats(); compiles to nothing when BUNGEE_NO_STATS is defined
+	struct Timer
+	{
+#ifndef BUNGEE_NO_STATS
+		Histogram &histogram;
+		const std::chrono::steady_clock::time_point start;
+
+		inline Timer(Instrumentation &instrumentation, StatsPhase phase) :
+			histogram(instrumentation.histograms[phase]),
+			start(std::chrono::steady_clock::now())
+		{
+		}
+
+		inline ~Timer()
+		{
+			histogram.add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+#else
+		inline Timer(Instrumentation &, StatsPhase) {}
+#endif
+	};
+
 	bool enabled = false;
+	bool realTime = false; // messages are queued for a background thread rather than written by the caller
 	int expected = 0;
 	bool firstGrain = true;
 
+	// Never allocates, locks or makes system calls in real-time mode
 	void log(const char *format, ...);
 
+	void getStats(Stats &stats) const;
+
 	void enableInstrumentation(bool enable)
 	{
 		this->enabled = enable;
 	}
+
+	// Starts the thread that writes out queued messages, so allocates
+	void enableRealTime(bool enable);
 };
 
 } // namespace Bungee::Internal
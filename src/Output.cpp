@@ -2,70 +2,116 @@
 // SPDX-License-Identifier: MPL-2.0
 
 #include "Output.h"
-#include "Grains.h"
+#include "Grain.h"
+#include "Shape.h"
 #include "Window.h"
 
 namespace Bungee {
 
-Output::Output(Fourier::Transforms &transforms, int log2SynthesisHop, int channelCount, int maxOutputChunkSize, float windowGain, std::initializer_list<float> windowCoefficients) :
-	synthesisWindow{Window::fromFrequencyDomainCoefficients(transforms, log2SynthesisHop + 2, windowGain, windowCoefficients)},
-	inverseTransformed(8 << log2SynthesisHop, channelCount),
-	bufferResampled(maxOutputChunkSize, channelCount),
-	lappedSynthesisBuffer(1 << (log2SynthesisHop + 3), channelCount)
+Output::Output(Fourier::Transforms &transforms, int log2SynthesisHop, float windowGain, std::initializer_list<float> windowCoefficients) :
+	sharedSynthesisWindow(Window::shared(log2SynthesisHop + 2, windowGain, windowCoefficients)),
+	synthesisWindow(sharedSynthesisWindow->data(), sharedSynthesisWindow->rows())
 {
 	transforms.prepareInverse(log2SynthesisHop + 3);
-	lappedSynthesisBuffer.array.setZero();
 	lappedSynthesisBuffer.frameCount = 1 << log2SynthesisHop;
 }
 
-void Output::applySynthesisWindow(int log2SynthesisHop, Grains &grains, const Eigen::Ref<const Eigen::ArrayXf> &window)
+void Output::allocate(Arena &arena, int log2SynthesisHop, int channelCount, int maxOutputChunkSize)
 {
-	BUNGEE_ASSERT1(lappedSynthesisBuffer.frameCount == window.rows() / 4);
+	arena.allocate(inverseTransformed, 8 << log2SynthesisHop, channelCount);
+	arena.allocate(bufferResampled, maxOutputChunkSize, channelCount);
+	lappedSynthesisBuffer.allocate(arena, 1 << (log2SynthesisHop + 3), channelCount);
+
+	if (!arena.measuring())
+		lappedSynthesisBuffer.array.setZero();
+}
+
+template <class Shape>
+void Output::applySynthesisWindow(int log2SynthesisHop, const Grain &grain, const Eigen::Ref<const Eigen::ArrayXf> &window, Workers &workers)
+{
+	workers.forEach(Shape::channelCount((int)lappedSynthesisBuffer.array.cols()), [&](int c) {
+		applySynthesisWindow<Shape>(c, log2SynthesisHop, grain, window);
+	});
+}
 
-	lappedSynthesisBuffer.array.topRows(Bungee::Resample::Internal::padding) = lappedSynthesisBuffer.array.middleRows(window.rows() / 4, Bungee::Resample::Internal::padding);
+template <class Shape>
+void Output::applySynthesisWindow(int c, int log2SynthesisHop, const Grain &grain, const Eigen::Ref<const Eigen::ArrayXf> &window)
+{
+	BUNGEE_ASSERT1(lappedSynthesisBuffer.frameCount == window.rows() / 4);
 
+	constexpr auto padding = Bungee::Resample::Internal::padding;
+	log2SynthesisHop = Shape::log2SynthesisHop(log2SynthesisHop);
 	const auto quadrantSize = (int)window.rows() / 4;
-	const auto hopsPerTransform = 1 << (grains[0].log2TransformLength - log2SynthesisHop);
+	const auto hopsPerTransform = 1 << (grain.log2TransformLength - log2SynthesisHop);
+	const auto frameCount = lappedSynthesisBuffer.frameCount;
 
-	if (grains[0].valid())
+	auto lapped = lappedSynthesisBuffer.array.col(c);
+	lapped.head(padding) = lapped.segment(window.rows() / 4, padding);
+
+	auto unpadded = lapped.segment(padding, lapped.rows() - 2 * padding);
+	if (grain.valid())
 	{
+		// Quadrants have compile-time size when the hop is fixed
+		constexpr int n = Shape::fixedLog2SynthesisHop ? 1 << Shape::fixedLog2SynthesisHop : Eigen::Dynamic;
+		BUNGEE_ASSERT1(n == Eigen::Dynamic || n == quadrantSize);
+
 		for (int i = 0; i < 4; ++i)
 		{
-			auto windowSegment = window.segment(quadrantSize * (i ^ 2), quadrantSize);
+			auto windowSegment = window.template segment<n>(quadrantSize * (i ^ 2), quadrantSize);
 
 			auto j = (i + hopsPerTransform - 2) % hopsPerTransform;
-			auto inputSegment = inverseTransformed.middleRows(quadrantSize * j, quadrantSize);
+			auto inputSegment = inverseTransformed.col(c).template segment<n>(quadrantSize * j, quadrantSize);
 
 			if (i < 3)
-				lappedSynthesisBuffer.unpadded().middleRows(i * quadrantSize, quadrantSize) = inputSegment.colwise() * windowSegment + lappedSynthesisBuffer.unpadded().middleRows((i + 1) * quadrantSize, quadrantSize);
+				unpadded.template segment<n>(i * quadrantSize, quadrantSize) = inputSegment * windowSegment + unpadded.template segment<n>((i + 1) * quadrantSize, quadrantSize);
 			else
-				lappedSynthesisBuffer.unpadded().middleRows(i * quadrantSize, quadrantSize) = inputSegment.colwise() * windowSegment;
+				unpadded.template segment<n>(i * quadrantSize, quadrantSize) = inputSegment * windowSegment;
 		}
 	}
 	else
 	{
-		lappedSynthesisBuffer.unpadded().topRows(3 * lappedSynthesisBuffer.frameCount) = lappedSynthesisBuffer.unpadded().middleRows(lappedSynthesisBuffer.frameCount, 3 * lappedSynthesisBuffer.frameCount);
-		lappedSynthesisBuffer.unpadded().middleRows(3 * lappedSynthesisBuffer.frameCount, lappedSynthesisBuffer.frameCount).setZero();
+		unpadded.head(3 * frameCount) = unpadded.segment(frameCount, 3 * frameCount);
+		unpadded.segment(3 * frameCount, frameCount).setZero();
 	}
 }
 
-inline auto makeOutputChunk(Eigen::Ref<Eigen::ArrayXXf> ref)
+#define X_SHAPE(c, h) \
+	template void Output::applySynthesisWindow<Shape<c, h>>(int, const Grain &, const Eigen::Ref<const Eigen::ArrayXf> &, Workers &); \
+	template void Output::applySynthesisWindow<Shape<c, h>>(int, int, const Grain &, const Eigen::Ref<const Eigen::ArrayXf> &);
+BUNGEE_SHAPES
+X_SHAPE(0, 0)
+#undef X_SHAPE
+
+inline auto makeOutputChunk(Resample::StridedRef ref)
 {
 	OutputChunk outputChunk{};
 	outputChunk.data = ref.data();
 	outputChunk.frameCount = (int)ref.rows();
-	outputChunk.channelStride = ref.stride();
+	outputChunk.channelStride = ref.colStride();
 	return outputChunk;
 }
 
 OutputChunk Output::resample(Resample::Operation resampleOperationBegin, Resample::Operation resampleOperationEnd)
 {
+	typedef Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic> Stride;
+	const auto channelCount = bufferResampled.cols();
+	Resample::StridedRef destination = interleaved ? Resample::StridedRef(Eigen::Map<Eigen::ArrayXXf, 0, Stride>(bufferResampled.data(), bufferResampled.rows(), channelCount, Stride(1, channelCount))) : Resample::StridedRef(bufferResampled);
+
 	const auto resampleFunction = resampleOperationBegin.function ? resampleOperationBegin.function : resampleOperationEnd.function;
 	if (resampleFunction)
 	{
-		Resample::External external(bufferResampled, 0, 0);
-		resampleFunction(lappedSynthesisBuffer, external, resampleOperationBegin.ratio, resampleOperationEnd.ratio, !resampleOperationEnd.function);
-		return makeOutputChunk(bufferResampled.topRows(external.activeFrameCount));
+		// The end grain's midpoint ratio bends the ramp from the begin grain's ratio to its own
+		const auto ratioBend = resampleOperationEnd.midpointRatio ? resampleOperationEnd.midpointRatio - 0.5 * (resampleOperationBegin.ratio + resampleOperationEnd.ratio) : 0.;
+
+		Resample::External external(destination, 0, 0);
+		resampleFunction(lappedSynthesisBuffer, external, resampleOperationBegin.ratio, resampleOperationEnd.ratio, ratioBend, !resampleOperationEnd.function);
+		return makeOutputChunk(destination.topRows(external.activeFrameCount));
+	}
+	else if (interleaved)
+	{
+		BUNGEE_ASSERT1(lappedSynthesisBuffer.frameCount <= destination.rows());
+		destination.topRows(lappedSynthesisBuffer.frameCount) = lappedSynthesisBuffer.unpadded().topRows(lappedSynthesisBuffer.frameCount);
+		return makeOutputChunk(destination.topRows(lappedSynthesisBuffer.frameCount));
 	}
 	else
 	{
@@ -73,4 +119,13 @@ OutputChunk Output::resample(Resample::Operation resampleOperationBegin, Resampl
 	}
 }
 
+void Output::writeInt16(const OutputChunk &outputChunk, int16_t *data, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride)
+{
+	const Assert::FloatingPointExceptions floatingPointExceptions(FE_INEXACT);
+
+	for (int i = 0; i < outputChunk.frameCount; ++i)
+		for (int c = 0; c < bufferResampled.cols(); ++c)
+			data[i * frameStride + c * channelStride] = Samples::toInt16(outputChunk.data[i * chunkFrameStride() + c * outputChunk.channelStride], dither);
+}
+
 } // namespace Bungee
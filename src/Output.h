@@ -3,32 +3,62 @@
 
 #pragma once
 
+#include "Arena.h"
 #include "Fourier.h"
 #include "Resample.h"
+#include "Samples.h"
 #include "Window.h"
+#include "Workers.h"
 
 #include "bungee/Bungee.h"
 
 #include <Eigen/Core>
 
 #include <initializer_list>
+#include <memory>
 
 namespace Bungee {
 
-struct Grains;
+struct Grain;
 
 struct Output
 {
-	Eigen::ArrayXf synthesisWindow;
-	Eigen::ArrayXXf inverseTransformed;
-	Eigen::ArrayXXf bufferResampled;
+	const std::shared_ptr<const Eigen::ArrayXf> sharedSynthesisWindow;
+	const Eigen::Map<const Eigen::ArrayXf, Eigen::AlignedMax> synthesisWindow;
+	Mapped<Eigen::ArrayXXf> inverseTransformed;
+	Mapped<Eigen::ArrayXXf> bufferResampled;
 	Resample::Internal lappedSynthesisBuffer;
 
-	Output(Fourier::Transforms &transforms, int log2SynthesisHop, int channelCount, int maxOutputChunkSize, float windowGain, std::initializer_list<float> windowCoefficients);
+	// When set, output chunks are interleaved in bufferResampled's storage
+	bool interleaved{};
 
-	void applySynthesisWindow(int log2SynthesisHop, Grains &grains, const Eigen::Ref<const Eigen::ArrayXf> &window);
+	// stride between consecutive frames of output chunks
+	inline std::ptrdiff_t chunkFrameStride() const
+	{
+		return interleaved ? bufferResampled.cols() : 1;
+	}
+
+	Samples::Dither dither;
+
+	Output(Fourier::Transforms &transforms, int log2SynthesisHop, float windowGain, std::initializer_list<float> windowCoefficients);
+
+	// lays out buffers in the stretcher's arena
+	void allocate(Arena &arena, int log2SynthesisHop, int channelCount, int maxOutputChunkSize);
+
+	// Set by a stage that has already overlap-added the current grain, channel by channel as each was inverse transformed
+	bool lapped{};
+
+	template <class Shape>
+	void applySynthesisWindow(int log2SynthesisHop, const Grain &grain, const Eigen::Ref<const Eigen::ArrayXf> &window, Workers &workers);
+
+	// as above, for channel c only
+	template <class Shape>
+	void applySynthesisWindow(int c, int log2SynthesisHop, const Grain &grain, const Eigen::Ref<const Eigen::ArrayXf> &window);
 
 	OutputChunk resample(Resample::Operation resampleOperationBegin, Resample::Operation resampleOperationEnd);
+
+	// converts an output chunk returned by resample() to dithered 16-bit samples
+	void writeInt16(const OutputChunk &outputChunk, int16_t *data, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride);
 };
 
 } // namespace Bungee
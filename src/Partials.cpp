@@ -3,9 +3,80 @@
 
 #include "Partials.h"
 
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__)
+#	include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#endif
+
 namespace Bungee::Partials {
 
-void enumerate(std::vector<Partial> &partials, int n, Eigen::Ref<Eigen::ArrayX<float>> energy)
+namespace {
+
+// Returns a mask whose bit m - begin is set where energy[m] < energy[m + 1], for begin <= m < end <= begin + 64
+inline uint64_t rising(const float *energy, int begin, int end)
+{
+	uint64_t bits = 0;
+	int m = begin;
+#if defined(__SSE2__)
+	for (; m + 4 <= end; m += 4)
+		bits |= uint64_t(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(energy + m), _mm_loadu_ps(energy + m + 1)))) << (m - begin);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint32x4_t weights = {1, 2, 4, 8};
+	for (; m + 4 <= end; m += 4)
+		bits |= uint64_t(vaddvq_u32(vandq_u32(vcltq_f32(vld1q_f32(energy + m), vld1q_f32(energy + m + 1)), weights))) << (m - begin);
+#endif
+	for (; m < end; ++m)
+		bits |= uint64_t(energy[m] < energy[m + 1]) << (m - begin);
+	return bits;
+}
+
+// Finds the next bin at which energy is, or is not, rising by comparing 64 bins at a time
+class Runs
+{
+	const float *energy;
+	const int end;
+	int base = -64;
+	uint64_t bits{};
+
+public:
+	Runs(const float *energy, int end) :
+		energy(energy),
+		end(end)
+	{
+	}
+
+	// returns the first m >= from for which (energy[m] < energy[m + 1]) == isRising
+	template <bool isRising>
+	inline int next(int from)
+	{
+		for (;;)
+		{
+			const int word = from & ~63;
+			if (word != base)
+			{
+				base = word;
+				bits = rising(energy, word, std::min(word + 64, end));
+			}
+
+			const auto mask = (isRising ? bits : ~bits) >> (from - word);
+			if (mask)
+			{
+				BUNGEE_ASSERT1(from + std::countr_zero(mask) < end);
+				return from + std::countr_zero(mask);
+			}
+
+			from = word + 64;
+		}
+	}
+};
+
+} // namespace
+
+void enumerate(List &partials, int n, Eigen::Ref<Eigen::ArrayX<float>> energy)
 {
 	float undo[] = {-1.f, 0.f};
 	std::swap(energy[n], undo[0]);
@@ -13,16 +84,17 @@ void enumerate(std::vector<Partial> &partials, int n, Eigen::Ref<Eigen::ArrayX<f
 
 	partials.resize(partials.capacity());
 
+	// The sentinels guarantee that energy falls at n - 1 and rises at n, so runs end within the first n + 1 bins
+	Runs runs(energy.data(), n + 1);
+
 	int count = 0;
 	int m = 1;
 	do
 	{
-		while ((energy[m] < energy[m + 1]))
-			m++;
+		m = runs.next<false>(m);
 		partials[count].peak = m++;
 
-		while (!(energy[m] < energy[m + 1]))
-			m++;
+		m = runs.next<true>(m);
 		partials[count++].end = m++;
 
 	} while (m < n + 1);
@@ -35,7 +107,68 @@ void enumerate(std::vector<Partial> &partials, int n, Eigen::Ref<Eigen::ArrayX<f
 	std::swap(energy[n + 1], undo[1]);
 }
 
-inline void suppressPartial(std::vector<Partial> &partials, int i, const Eigen::Ref<const Eigen::ArrayX<float>> energy)
+bool track(List &partials, const List &hints, int n, Eigen::Ref<Eigen::ArrayX<float>> energy, const Eigen::Ref<const Eigen::ArrayX<float>> previousEnergy, float floor)
+{
+	BUNGEE_ASSERT1(hints.size() > 0 && hints.size() <= partials.capacity());
+	BUNGEE_ASSERT1(n >= 2 && previousEnergy.rows() >= n);
+
+	float undo[] = {-1.f, 0.f};
+	std::swap(energy[n], undo[0]);
+	std::swap(energy[n + 1], undo[1]);
+
+	const auto rising = [&](int m) { return energy[m] < energy[m + 1]; };
+
+	constexpr float k = 4.f; // fudge: growth of energy at a valley by which a new partial is suspected
+	constexpr float depth = 1e4f; // fudge: valleys this far below their peaks are noise floor, whose growth is ignored
+	bool tracked = true;
+
+	// Peaks, as enumerate() finds them: bins at which energy stops rising, the first of any plateau
+	partials.resize(hints.size());
+	int count = 0;
+	for (int i = 0; tracked && i < hints.size(); ++i)
+	{
+		if (previousEnergy[hints[i].peak] < floor)
+			continue;
+
+		int m = std::clamp<int>(hints[i].peak, 1, n - 1);
+		while (rising(m))
+			++m;
+		while (m > 1 && !rising(m - 1))
+			--m;
+
+		partials[count].peak = m;
+		partials[count].end = hints[i].end;
+		tracked = !count || m > partials[count - 1].peak;
+		++count;
+	}
+	partials.resize(count);
+	tracked = tracked && count;
+
+	// Ends, as enumerate() finds them: bins at which energy starts to rise again after a peak
+	for (int i = 0; tracked && i + 1 < partials.size(); ++i)
+	{
+		const int peak = partials[i].peak, nextPeak = partials[i + 1].peak;
+		int m = partials[i].end;
+		if (m <= peak || m >= nextPeak)
+			m = peak + 1;
+		if (rising(m))
+			while (m - 1 > peak && rising(m - 1))
+				--m;
+		else
+			while (!rising(m))
+				++m;
+		partials[i].end = m;
+		tracked = !(energy[m] > k * previousEnergy[m] && energy[m] * depth > std::min(energy[peak], energy[nextPeak]));
+	}
+	if (tracked)
+		partials[partials.size() - 1].end = n;
+
+	std::swap(energy[n], undo[0]);
+	std::swap(energy[n + 1], undo[1]);
+	return tracked;
+}
+
+inline void suppressPartial(List &partials, int i, const Eigen::Ref<const Eigen::ArrayX<float>> energy)
 {
 	if (energy[partials[i - 1].end] > energy[partials[i].end])
 		partials[i - 1].end = partials[i].end;
@@ -43,20 +176,37 @@ inline void suppressPartial(std::vector<Partial> &partials, int i, const Eigen::
 		partials[i].end = partials[i - 1].end;
 }
 
-void suppressTransientPartials(std::vector<Partial> &partials, const Eigen::Ref<const Eigen::ArrayX<float>> energy, const Eigen::Ref<const Eigen::ArrayX<float>> previousEnergy)
+float suppressTransientPartials(List &partials, const Eigen::Ref<const Eigen::ArrayX<float>> energy, const Eigen::Ref<const Eigen::ArrayX<float>> previousEnergy, int log2PreviousRatio, float previousScale)
 {
+	const auto previous = [&](int m) {
+		if (!log2PreviousRatio)
+			return previousEnergy[m];
+		return previousScale * previousEnergy[equivalentPeak(m, log2PreviousRatio, previousEnergy.data(), (int)previousEnergy.rows())];
+	};
+
+	constexpr auto k = 1.5f; // fudge: lower constant helps transients, higher helps tones
+	const auto transient = [&](int i) {
+		return energy[partials[i].peak] > k * previous(partials[i].peak);
+	};
+
 	int strongestPartialIndex = 0;
-	for (int i = 1; i < partials.size(); ++i)
-		if (energy[partials[i].peak] > energy[partials[strongestPartialIndex].peak])
+	float peakEnergy = 0.f;
+	float transientEnergy = 0.f;
+	for (int i = 0; i < partials.size(); ++i)
+	{
+		const auto e = energy[partials[i].peak];
+		if (e > energy[partials[strongestPartialIndex].peak])
 			strongestPartialIndex = i;
+		peakEnergy += e;
+		if (transient(i))
+			transientEnergy += e;
+	}
 
 	for (int i = 1; i < partials.size() - 1; ++i)
-		if (i != strongestPartialIndex)
-		{
-			constexpr auto k = 1.5f; // fudge: lower constant helps transients, higher helps tones
-			if (energy[partials[i].peak] > k * previousEnergy[partials[i].peak])
-				suppressPartial(partials, i, energy);
-		}
+		if (i != strongestPartialIndex && transient(i))
+			suppressPartial(partials, i, energy);
+
+	return peakEnergy > 0.f ? transientEnergy / peakEnergy : 0.f;
 }
 
 } // namespace Bungee::Partials
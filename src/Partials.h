@@ -7,8 +7,8 @@
 
 #include <Eigen/Core>
 
+#include <algorithm>
 #include <cstdint>
-#include <vector>
 
 namespace Bungee::Partials {
 
@@ -18,8 +18,97 @@ struct Partial
 	int16_t end;
 };
 
-void enumerate(std::vector<Partial> &partials, int n, Eigen::Ref<Eigen::ArrayX<float>> energy);
+// The partials of one grain, in storage of fixed capacity that the list does not own
+class List
+{
+	Partial *partials{};
+	int capacityCount{};
+	int count{};
+
+public:
+	List() = default;
+
+	List(Partial *storage, int capacity) :
+		partials(storage),
+		capacityCount(capacity)
+	{
+	}
+
+	inline int capacity() const
+	{
+		return capacityCount;
+	}
+
+	inline int size() const
+	{
+		return count;
+	}
+
+	inline void resize(int size)
+	{
+		BUNGEE_ASSERT1(size <= capacityCount);
+		count = size;
+	}
+
+	inline Partial &operator[](int i)
+	{
+		BUNGEE_ASSERT2(i < capacityCount);
+		return partials[i];
+	}
+
+	inline const Partial &operator[](int i) const
+	{
+		BUNGEE_ASSERT2(i < capacityCount);
+		return partials[i];
+	}
+
+	inline const Partial &back() const
+	{
+		BUNGEE_ASSERT1(count > 0);
+		return partials[count - 1];
+	}
+};
+
+// Of the bins of a transform 2^log2Ratio times as long (log2Ratio may be negative) that are nearest in frequency to bin m,
+// returns the one of greatest energy, so that peaks correspond across a change of transform length
+inline int equivalentPeak(int m, int log2Ratio, const float *energy, int binCount)
+{
+	int begin, end;
+	if (log2Ratio >= 0)
+	{
+		begin = (m << log2Ratio) - (1 << log2Ratio >> 1);
+		end = (m << log2Ratio) + (1 << log2Ratio >> 1);
+	}
+	else
+	{
+		begin = m >> -log2Ratio;
+		end = (m + (1 << -log2Ratio) - 1) >> -log2Ratio;
+	}
+	begin = std::max(begin, 0);
+	end = std::min(end, binCount - 1);
+
+	int peak = begin;
+	for (int q = begin + 1; q <= end; ++q)
+		if (energy[q] > energy[peak])
+			peak = q;
+	return peak;
+}
+
+void enumerate(List &partials, int n, Eigen::Ref<Eigen::ArrayX<float>> energy);
+
+// Incremental alternative to enumerate() for a grain whose spectrum resembles previousEnergy, whose partials are given as
+// hints: each hint's peak climbs to the nearest peak of energy, and each hint's end, where it still lies between the new
+// peaks, moves to the nearest valley. Hints whose peak in previousEnergy lies below floor are the noise floor of the
+// transform and are dropped, their bins joining a neighbouring partial. Costs time in proportion to the number of
+// partials rather than of bins. Returns false, leaving partials to be enumerated, where the spectrum has changed too
+// much to track: where two hints climb to one peak, or where energy at a valley has grown, as it does when a partial
+// appears between those of the hints.
+bool track(List &partials, const List &hints, int n, Eigen::Ref<Eigen::ArrayX<float>> energy, const Eigen::Ref<const Eigen::ArrayX<float>> previousEnergy, float floor = 0.f);
 
-void suppressTransientPartials(std::vector<Partial> &partials, const Eigen::Ref<const Eigen::ArrayX<float>> energy, const Eigen::Ref<const Eigen::ArrayX<float>> previousEnergy);
+// Merges partials that have grown since the previous grain into a neighbour, and returns the grain's energy flux: the
+// energy at the peaks of grown partials as a fraction of that at all peaks. Where the previous grain's transform was 2^log2PreviousRatio
+// times as long, its energy, scaled by previousScale, is compared at the equivalent peak (see equivalentPeak()) and
+// previousEnergy must be limited to its valid bins.
+float suppressTransientPartials(List &partials, const Eigen::Ref<const Eigen::ArrayX<float>> energy, const Eigen::Ref<const Eigen::ArrayX<float>> previousEnergy, int log2PreviousRatio = 0, float previousScale = 1.f);
 
 } // namespace Bungee::Partials
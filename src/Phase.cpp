@@ -0,0 +1,23 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#include "Phase.h"
+
+#include <cmath>
+
+namespace Bungee::Phase {
+
+Rotations::Rotations()
+{
+	for (int i = 0; i < 256; ++i)
+	{
+		const double coarseRadians = (2 * std::numbers::pi / 256) * i;
+		const double fineRadians = (2 * std::numbers::pi / 65536) * i;
+		coarse[i] = {float(std::cos(coarseRadians)), float(std::sin(coarseRadians))};
+		fine[i] = {float(std::cos(fineRadians)), float(std::sin(fineRadians))};
+	}
+}
+
+const Rotations rotations;
+
+} // namespace Bungee::Phase
@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <array>
 
+#include <cmath>
 #include <complex>
 #include <cstdint>
 #include <limits>
@@ -69,6 +70,33 @@ static inline constexpr T fromRadians(float radians)
 	return phase;
 }
 
+// Minimax polynomial for atan(a), 0 <= a <= 1, in odd powers of a, scaled to revolutions
+namespace Arctangent {
+static constexpr float k = float(1. / (2 * std::numbers::pi));
+static constexpr float c1 = 0.99997726f * k, c3 = -0.33262347f * k, c5 = 0.19354346f * k, c7 = -0.11643287f * k, c9 = 0.05265332f * k, c11 = -0.01172120f * k;
+} // namespace Arctangent
+
+// Fast approximation of std::arg(std::complex<float>(real, imag)) with error well below one least significant bit of T.
+// SIMD implementations in Polar.cpp follow exactly the same sequence of operations.
+template <typename T = Type>
+static inline T fromCartesian(float real, float imag)
+{
+	using namespace Arctangent;
+	const float ax = std::abs(real);
+	const float ay = std::abs(imag);
+	const float a = std::min(ax, ay) / std::max(std::max(ax, ay), std::numeric_limits<float>::min());
+	const float s = a * a;
+	float r = (((((c11 * s + c9) * s + c7) * s + c5) * s + c3) * s + c1) * a;
+	if (ay > ax)
+		r = 0.25f - r;
+	if (real < 0.f)
+		r = 0.5f - r;
+	if (imag < 0.f)
+		r = -r;
+	constexpr auto k = float(1ull << (8 * sizeof(T)));
+	return T(int32_t(r * k));
+}
+
 template <typename T = Type>
 static inline constexpr T fromTime(double time, int log2Period)
 {
@@ -77,4 +105,26 @@ static inline constexpr T fromTime(double time, int log2Period)
 	return T(int64_t(phase));
 }
 
+// Tabulates exp(i * toRadians(phase)) as the product of a coarse rotation, indexed by the phase's most
+// significant byte, and a fine rotation, indexed by its least significant byte. Both tables fit in L1 cache.
+struct Rotations
+{
+	static_assert(sizeof(Type) == 2);
+
+	std::array<std::complex<float>, 256> coarse, fine;
+
+	Rotations();
+
+	inline std::complex<float> operator()(Type phase) const
+	{
+		const auto u = uint16_t(phase);
+		const auto a = coarse[u >> 8];
+		const auto b = fine[u & 0xff];
+		// Explicit product avoids the NaN-handling path of std::complex multiplication
+		return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+	}
+};
+
+extern const Rotations rotations;
+
 } // namespace Bungee::Phase
@@ -0,0 +1,226 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#include "Polar.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#	include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#endif
+
+namespace Bungee::Polar {
+
+namespace {
+
+using namespace Phase::Arctangent;
+
+static constexpr float phaseScale = float(1ull << (8 * sizeof(Phase::Type)));
+
+template <int fixedChannelCount>
+void scalar(int binCount, int channelCount, const std::complex<float> *spectrum, ptrdiff_t channelStride, float *energy, Phase::Type *phase)
+{
+	if constexpr (fixedChannelCount != 0)
+		channelCount = fixedChannelCount;
+
+	for (int i = 0; i < binCount; ++i)
+	{
+		auto x = spectrum[i];
+		for (int c = 1; c < channelCount; ++c)
+			x += spectrum[i + c * channelStride];
+		energy[i] = x.real() * x.real() + x.imag() * x.imag();
+		phase[i] = Phase::fromCartesian(x.real(), x.imag());
+	}
+}
+
+#if defined(__SSE2__)
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+template <int fixedChannelCount>
+void sse2(int binCount, int channelCount, const std::complex<float> *spectrum, ptrdiff_t channelStride, float *energy, Phase::Type *phase)
+{
+	if constexpr (fixedChannelCount != 0)
+		channelCount = fixedChannelCount;
+
+	const auto signBit = _mm_set1_ps(-0.f);
+
+	int i = 0;
+	for (; i + 4 <= binCount; i += 4)
+	{
+		auto lo = _mm_loadu_ps((const float *)(spectrum + i));
+		auto hi = _mm_loadu_ps((const float *)(spectrum + i + 2));
+		for (int c = 1; c < channelCount; ++c)
+		{
+			lo = _mm_add_ps(lo, _mm_loadu_ps((const float *)(spectrum + i + c * channelStride)));
+			hi = _mm_add_ps(hi, _mm_loadu_ps((const float *)(spectrum + i + 2 + c * channelStride)));
+		}
+		const auto re = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+		const auto im = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+
+		_mm_storeu_ps(energy + i, _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im)));
+
+		const auto ax = _mm_andnot_ps(signBit, re);
+		const auto ay = _mm_andnot_ps(signBit, im);
+		const auto a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(std::numeric_limits<float>::min())));
+		const auto s = _mm_mul_ps(a, a);
+		auto r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c11), s), _mm_set1_ps(c9));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(c7));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(c5));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(c3));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(c1));
+		r = _mm_mul_ps(r, a);
+		r = select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(0.25f), r), r);
+		r = select(_mm_cmplt_ps(re, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(0.5f), r), r);
+		r = select(_mm_cmplt_ps(im, _mm_setzero_ps()), _mm_xor_ps(signBit, r), r);
+
+		// Sign-extend the low 16 bits so that packing wraps rather than saturates
+		auto p = _mm_cvttps_epi32(_mm_mul_ps(r, _mm_set1_ps(phaseScale)));
+		p = _mm_srai_epi32(_mm_slli_epi32(p, 16), 16);
+		_mm_storel_epi64((__m128i *)(phase + i), _mm_packs_epi32(p, p));
+	}
+
+	if (i < binCount)
+		scalar<fixedChannelCount>(binCount - i, channelCount, spectrum + i, channelStride, energy + i, phase + i);
+}
+
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2"))) static inline __m256 select(__m256 mask, __m256 a, __m256 b)
+{
+	return _mm256_blendv_ps(b, a, mask);
+}
+
+template <int fixedChannelCount>
+__attribute__((target("avx2"))) void avx2(int binCount, int channelCount, const std::complex<float> *spectrum, ptrdiff_t channelStride, float *energy, Phase::Type *phase)
+{
+	if constexpr (fixedChannelCount != 0)
+		channelCount = fixedChannelCount;
+
+	const auto signBit = _mm256_set1_ps(-0.f);
+
+	int i = 0;
+	for (; i + 8 <= binCount; i += 8)
+	{
+		auto lo = _mm256_loadu_ps((const float *)(spectrum + i));
+		auto hi = _mm256_loadu_ps((const float *)(spectrum + i + 4));
+		for (int c = 1; c < channelCount; ++c)
+		{
+			lo = _mm256_add_ps(lo, _mm256_loadu_ps((const float *)(spectrum + i + c * channelStride)));
+			hi = _mm256_add_ps(hi, _mm256_loadu_ps((const float *)(spectrum + i + 4 + c * channelStride)));
+		}
+
+		// Shuffles operate within 128-bit lanes, so restore bin order with a cross-lane permute
+		const auto re = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+		const auto im = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+
+		_mm256_storeu_ps(energy + i, _mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im)));
+
+		const auto ax = _mm256_andnot_ps(signBit, re);
+		const auto ay = _mm256_andnot_ps(signBit, im);
+		const auto a = _mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(std::numeric_limits<float>::min())));
+		const auto s = _mm256_mul_ps(a, a);
+		auto r = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(c11), s), _mm256_set1_ps(c9));
+		r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps(c7));
+		r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps(c5));
+		r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps(c3));
+		r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps(c1));
+		r = _mm256_mul_ps(r, a);
+		r = select(_mm256_cmp_ps(ay, ax, _CMP_GT_OQ), _mm256_sub_ps(_mm256_set1_ps(0.25f), r), r);
+		r = select(_mm256_cmp_ps(re, _mm256_setzero_ps(), _CMP_LT_OQ), _mm256_sub_ps(_mm256_set1_ps(0.5f), r), r);
+		r = select(_mm256_cmp_ps(im, _mm256_setzero_ps(), _CMP_LT_OQ), _mm256_xor_ps(signBit, r), r);
+
+		// Sign-extend the low 16 bits so that packing wraps rather than saturates
+		auto p = _mm256_cvttps_epi32(_mm256_mul_ps(r, _mm256_set1_ps(phaseScale)));
+		p = _mm256_srai_epi32(_mm256_slli_epi32(p, 16), 16);
+		_mm_storeu_si128((__m128i *)(phase + i), _mm_packs_epi32(_mm256_castsi256_si128(p), _mm256_extracti128_si256(p, 1)));
+	}
+
+	if (i < binCount)
+		scalar<fixedChannelCount>(binCount - i, channelCount, spectrum + i, channelStride, energy + i, phase + i);
+}
+
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+
+template <int fixedChannelCount>
+void neon(int binCount, int channelCount, const std::complex<float> *spectrum, ptrdiff_t channelStride, float *energy, Phase::Type *phase)
+{
+	if constexpr (fixedChannelCount != 0)
+		channelCount = fixedChannelCount;
+
+	int i = 0;
+	for (; i + 4 <= binCount; i += 4)
+	{
+		auto x = vld2q_f32((const float *)(spectrum + i));
+		for (int c = 1; c < channelCount; ++c)
+		{
+			const auto y = vld2q_f32((const float *)(spectrum + i + c * channelStride));
+			x.val[0] = vaddq_f32(x.val[0], y.val[0]);
+			x.val[1] = vaddq_f32(x.val[1], y.val[1]);
+		}
+		const auto re = x.val[0];
+		const auto im = x.val[1];
+
+		vst1q_f32(energy + i, vaddq_f32(vmulq_f32(re, re), vmulq_f32(im, im)));
+
+		const auto ax = vabsq_f32(re);
+		const auto ay = vabsq_f32(im);
+		const auto a = vdivq_f32(vminq_f32(ax, ay), vmaxq_f32(vmaxq_f32(ax, ay), vdupq_n_f32(std::numeric_limits<float>::min())));
+		const auto s = vmulq_f32(a, a);
+		auto r = vaddq_f32(vmulq_f32(vdupq_n_f32(c11), s), vdupq_n_f32(c9));
+		r = vaddq_f32(vmulq_f32(r, s), vdupq_n_f32(c7));
+		r = vaddq_f32(vmulq_f32(r, s), vdupq_n_f32(c5));
+		r = vaddq_f32(vmulq_f32(r, s), vdupq_n_f32(c3));
+		r = vaddq_f32(vmulq_f32(r, s), vdupq_n_f32(c1));
+		r = vmulq_f32(r, a);
+		r = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(vdupq_n_f32(0.25f), r), r);
+		r = vbslq_f32(vcltq_f32(re, vdupq_n_f32(0.f)), vsubq_f32(vdupq_n_f32(0.5f), r), r);
+		r = vbslq_f32(vcltq_f32(im, vdupq_n_f32(0.f)), vnegq_f32(r), r);
+
+		// Narrowing keeps the low 16 bits, i.e. wraps
+		vst1_s16(phase + i, vmovn_s32(vcvtq_s32_f32(vmulq_f32(r, vdupq_n_f32(phaseScale)))));
+	}
+
+	if (i < binCount)
+		scalar<fixedChannelCount>(binCount - i, channelCount, spectrum + i, channelStride, energy + i, phase + i);
+}
+
+#endif
+
+template <int fixedChannelCount>
+Kernel selectKernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("avx2"))
+		return &avx2<fixedChannelCount>;
+#endif
+#if defined(__SSE2__)
+	return &sse2<fixedChannelCount>;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	return &neon<fixedChannelCount>;
+#else
+	return &scalar<fixedChannelCount>;
+#endif
+}
+
+} // namespace
+
+template <int fixedChannelCount>
+Kernel kernel()
+{
+	static const auto kernel = selectKernel<fixedChannelCount>();
+	return kernel;
+}
+
+template Kernel kernel<0>();
+template Kernel kernel<1>();
+template Kernel kernel<2>();
+
+} // namespace Bungee::Polar
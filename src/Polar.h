@@ -0,0 +1,23 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include "Phase.h"
+
+#include <complex>
+#include <cstddef>
+
+namespace Bungee::Polar {
+
+// Sums the channels of a complex spectrum and, for each bin, writes energy (squared magnitude) and phase.
+// Implementations are vectorised across bins and give results identical to the scalar reference:
+// energy as |sum|^2 and phase as Phase::fromCartesian.
+typedef void (*Kernel)(int binCount, int channelCount, const std::complex<float> *spectrum, ptrdiff_t channelStride, float *energy, Phase::Type *phase);
+
+// Returns the fastest kernel supported by the running CPU, compiled for fixedChannelCount channels unless zero.
+// Kernels are instantiated for 0, 1 and 2 channels.
+template <int fixedChannelCount = 0>
+Kernel kernel();
+
+} // namespace Bungee::Polar
@@ -0,0 +1,181 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#include "Resample.h"
+
+#include <cmath>
+#include <numbers>
+
+#if defined(__x86_64__) || defined(__i386__)
+#	include <immintrin.h>
+#elif defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+namespace Bungee::Resample {
+
+namespace {
+
+// Modified Bessel function of the first kind, order zero
+double besselI0(double x)
+{
+	double sum = 1., term = 1.;
+	for (int k = 1; term > 1e-12 * sum; ++k)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+} // namespace
+
+Sinc::Table::Table()
+{
+	// Cutoff just below the internal Nyquist frequency; beta = 7 gives around 70dB stopband rejection
+	constexpr double cutoff = 0.47;
+	constexpr double beta = 7.;
+	constexpr double halfLength = tapCount / 2;
+
+	for (int p = 0; p <= phaseCount; ++p)
+	{
+		double taps[tapCount], sum = 0.;
+		for (int t = 0; t < tapCount; ++t)
+		{
+			const double d = tapsBefore + double(p) / phaseCount - t;
+			const double u = d / halfLength;
+			const double window = std::abs(u) < 1. ? besselI0(beta * std::sqrt(1. - u * u)) / besselI0(beta) : 0.;
+			const double argument = 2 * cutoff * d;
+			const double sinc = argument == 0. ? 1. : std::sin(std::numbers::pi * argument) / (std::numbers::pi * argument);
+			taps[t] = window * sinc;
+			sum += taps[t];
+		}
+
+		// Normalise each phase to unity gain at DC
+		for (int t = 0; t < tapCount; ++t)
+			coefficients[p][t] = float(taps[t] / sum);
+	}
+}
+
+const Sinc::Table Sinc::table;
+
+namespace {
+
+void bilinearOutputScalar(int frameCount, const float *x, int channelCount, const float *internal, ptrdiff_t internalStride, float *external, ptrdiff_t externalStride)
+{
+	for (int c = 0; c < channelCount; ++c)
+		for (int i = 0; i < frameCount; ++i)
+			external[i + c * externalStride] = bilinearOutputTap(x[i], internal + c * internalStride);
+}
+
+#if defined(__SSE2__)
+
+void bilinearOutputSse2(int frameCount, const float *x, int channelCount, const float *internal, ptrdiff_t internalStride, float *external, ptrdiff_t externalStride)
+{
+	int i = 0;
+	for (; i + 4 <= frameCount; i += 4)
+	{
+		const auto position = _mm_loadu_ps(x + i);
+		const auto integer = _mm_cvttps_epi32(position);
+		const auto fraction = _mm_sub_ps(position, _mm_cvtepi32_ps(integer));
+		const auto complement = _mm_sub_ps(_mm_set1_ps(1.f), fraction);
+
+		alignas(16) int32_t index[4];
+		_mm_store_si128((__m128i *)index, integer);
+
+		for (int c = 0; c < channelCount; ++c)
+		{
+			const auto column = internal + c * internalStride;
+			const auto tap0 = _mm_setr_ps(column[index[0]], column[index[1]], column[index[2]], column[index[3]]);
+			const auto tap1 = _mm_setr_ps(column[index[0] + 1], column[index[1] + 1], column[index[2] + 1], column[index[3] + 1]);
+			_mm_storeu_ps(external + i + c * externalStride, _mm_add_ps(_mm_mul_ps(tap1, fraction), _mm_mul_ps(tap0, complement)));
+		}
+	}
+
+	if (i < frameCount)
+		bilinearOutputScalar(frameCount - i, x + i, channelCount, internal, internalStride, external + i, externalStride);
+}
+
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2"))) void bilinearOutputAvx2(int frameCount, const float *x, int channelCount, const float *internal, ptrdiff_t internalStride, float *external, ptrdiff_t externalStride)
+{
+	int i = 0;
+	for (; i + 8 <= frameCount; i += 8)
+	{
+		const auto position = _mm256_loadu_ps(x + i);
+		const auto integer = _mm256_cvttps_epi32(position);
+		const auto fraction = _mm256_sub_ps(position, _mm256_cvtepi32_ps(integer));
+		const auto complement = _mm256_sub_ps(_mm256_set1_ps(1.f), fraction);
+
+		for (int c = 0; c < channelCount; ++c)
+		{
+			const auto column = internal + c * internalStride;
+			const auto tap0 = _mm256_i32gather_ps(column, integer, 4);
+			const auto tap1 = _mm256_i32gather_ps(column + 1, integer, 4);
+			_mm256_storeu_ps(external + i + c * externalStride, _mm256_add_ps(_mm256_mul_ps(tap1, fraction), _mm256_mul_ps(tap0, complement)));
+		}
+	}
+
+	if (i < frameCount)
+		bilinearOutputScalar(frameCount - i, x + i, channelCount, internal, internalStride, external + i, externalStride);
+}
+
+#endif
+
+#if defined(__ARM_NEON)
+
+void bilinearOutputNeon(int frameCount, const float *x, int channelCount, const float *internal, ptrdiff_t internalStride, float *external, ptrdiff_t externalStride)
+{
+	int i = 0;
+	for (; i + 4 <= frameCount; i += 4)
+	{
+		const auto position = vld1q_f32(x + i);
+		const auto integer = vcvtq_s32_f32(position);
+		const auto fraction = vsubq_f32(position, vcvtq_f32_s32(integer));
+		const auto complement = vsubq_f32(vdupq_n_f32(1.f), fraction);
+
+		int32_t index[4];
+		vst1q_s32(index, integer);
+
+		for (int c = 0; c < channelCount; ++c)
+		{
+			const auto column = internal + c * internalStride;
+			const float taps0[4] = {column[index[0]], column[index[1]], column[index[2]], column[index[3]]};
+			const float taps1[4] = {column[index[0] + 1], column[index[1] + 1], column[index[2] + 1], column[index[3] + 1]};
+			vst1q_f32(external + i + c * externalStride, vaddq_f32(vmulq_f32(vld1q_f32(taps1), fraction), vmulq_f32(vld1q_f32(taps0), complement)));
+		}
+	}
+
+	if (i < frameCount)
+		bilinearOutputScalar(frameCount - i, x + i, channelCount, internal, internalStride, external + i, externalStride);
+}
+
+#endif
+
+BilinearOutputKernel selectBilinearOutputKernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("avx2"))
+		return &bilinearOutputAvx2;
+#endif
+#if defined(__SSE2__)
+	return &bilinearOutputSse2;
+#elif defined(__ARM_NEON)
+	return &bilinearOutputNeon;
+#else
+	return &bilinearOutputScalar;
+#endif
+}
+
+} // namespace
+
+BilinearOutputKernel bilinearOutputKernel()
+{
+	static const auto kernel = selectBilinearOutputKernel();
+	return kernel;
+}
+
+} // namespace Bungee::Resample
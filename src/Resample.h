@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "Arena.h"
 #include "Assert.h"
 
 #include "bungee/Bungee.h"
@@ -24,13 +25,13 @@ struct Internal
 	static constexpr auto align = std::max<int>(EIGEN_DEFAULT_ALIGN_BYTES / sizeof(float), 1);
 	static constexpr auto padding = (32 + align - 1) / align * align;
 
-	Eigen::ArrayXXf array;
+	Mapped<Eigen::ArrayXXf> array;
 	int frameCount{};
 	double offset{};
 
-	Internal(int maxFrameCount, int channelCount) :
-		array(padding + maxFrameCount + padding, channelCount)
+	inline void allocate(Arena &arena, int maxFrameCount, int channelCount)
 	{
+		arena.allocate(array, padding + maxFrameCount + padding, channelCount);
 	}
 
 	inline Eigen::Ref<Eigen::ArrayXXf> unpadded()
@@ -39,10 +40,13 @@ struct Internal
 	}
 };
 
+// Frames in rows and channels in columns, with any row stride so that interleaved audio can be referenced in place
+typedef Eigen::Ref<Eigen::ArrayXXf, 0, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>> StridedRef;
+
 // The external buffer: contains input or output samples.
 struct External
 {
-	External(Eigen::Ref<Eigen::ArrayXXf> ref, ptrdiff_t muteHead, ptrdiff_t muteTail) :
+	External(StridedRef ref, ptrdiff_t muteHead, ptrdiff_t muteTail) :
 		ref(ref),
 		unmutedBegin(muteHead),
 		unmutedEnd(ref.rows() - muteTail),
@@ -59,7 +63,7 @@ struct External
 		BUNGEE_ASSERT1(activeFrameCount <= ref.rows());
 	}
 
-	Eigen::Ref<Eigen::ArrayXXf> ref;
+	StridedRef ref;
 	ptrdiff_t unmutedBegin;
 	ptrdiff_t unmutedEnd;
 	ptrdiff_t activeFrameCount;
@@ -111,19 +115,106 @@ struct Bilinear
 	}
 };
 
+// Polyphase Kaiser-windowed sinc interpolation: a bank of filters indexed by fractional position.
+// Coefficients are linearly interpolated between adjacent phases and shared by all channels.
+struct Sinc
+{
+	static constexpr int tapCount = 32;
+	static constexpr int phaseCount = 256;
+	static constexpr int tapsBefore = tapCount / 2 - 1;
+
+	struct Table
+	{
+		alignas(32) float coefficients[phaseCount + 1][tapCount];
+		Table();
+	};
+
+	static const Table table;
+
+	template <class Mode>
+	static inline void step(float x, size_t channelCount, float *internal, ptrdiff_t internalStride, float *external, ptrdiff_t externalStride, float gain)
+	{
+		const Assert::FloatingPointExceptions floatingPointExceptions(FE_INEXACT);
+		BUNGEE_ASSERT2(x >= 0);
+		const auto integer = intptr_t(x);
+		const float phase = (x - integer) * phaseCount;
+		const auto phaseInteger = std::min<int>(phase, phaseCount - 1);
+		const float phaseFraction = phase - phaseInteger;
+
+		alignas(32) float coefficients[tapCount];
+		{
+			const auto *a = table.coefficients[phaseInteger];
+			const auto *b = table.coefficients[phaseInteger + 1];
+			for (int t = 0; t < tapCount; ++t)
+				coefficients[t] = a[t] + phaseFraction * (b[t] - a[t]);
+		}
+
+		auto first = integer - tapsBefore;
+		auto tapBegin = 0, tapEnd = tapCount;
+		if (first < 0 || first + tapCount > internalStride)
+		{
+			// Input resampling may spread the outermost taps of the chunk beyond the internal buffer's padding
+			BUNGEE_ASSERT1((std::is_same_v<Mode, Input>));
+			tapBegin = (int)std::clamp<intptr_t>(-first, 0, tapCount);
+			tapEnd = (int)std::clamp<intptr_t>(internalStride - first, tapBegin, tapCount);
+		}
+
+		for (size_t c = 0; c < channelCount; ++c)
+		{
+			auto *column = internal + first + c * internalStride;
+			if constexpr (std::is_same_v<Mode, Input>)
+			{
+				const float sample = external[c * externalStride] * gain;
+				for (int t = tapBegin; t < tapEnd; ++t)
+					column[t] += sample * coefficients[t];
+			}
+			else
+			{
+				// Independent partial sums allow the dot product to vectorise
+				float sums[8]{};
+				for (int t = 0; t < tapCount; t += 8)
+					for (int j = 0; j < 8; ++j)
+						sums[j] += column[t + j] * coefficients[t + j];
+				external[c * externalStride] = ((sums[0] + sums[4]) + (sums[1] + sums[5])) + ((sums[2] + sums[6]) + (sums[3] + sums[7]));
+			}
+		}
+	}
+};
+
+// Reference (scalar) bilinear interpolation of one output sample, as performed by Bilinear::step<Output>
+static inline float bilinearOutputTap(float x, const float *internal)
+{
+	const auto integer = intptr_t(x);
+	const float fraction = x - integer;
+	float external = internal[integer + 1] * fraction;
+	external += internal[integer + 0] * (1.f - fraction);
+	return external;
+}
+
+// Bilinear interpolation of frameCount output frames from precomputed positions x, all channels at once.
+// Implementations are vectorised across frames and give results identical to bilinearOutputTap.
+typedef void (*BilinearOutputKernel)(int frameCount, const float *x, int channelCount, const float *internal, ptrdiff_t internalStride, float *external, ptrdiff_t externalStride);
+
+// Returns the fastest kernel supported by the running CPU
+BilinearOutputKernel bilinearOutputKernel();
+
 template <bool ratioIsConstant>
 struct RatioState;
 
+// The ratio at output frame u is ratioBegin + ratioGradient * u + ratioCurvature * u * u, and each step advances x by
+// its integral over one frame. Those integrals have constant second differences, so are accumulated in turn.
 template <>
 struct RatioState<false>
 {
-	const double ratioGradient;
+	const double ratioCurvature;
+	double ratioGradient;
 	double ratio;
 	double x;
 
-	inline RatioState(double offset, double ratioBegin, double ratioGradient) :
-		ratioGradient(ratioGradient),
-		ratio(ratioBegin + 0.5 * ratioGradient),
+	inline RatioState(double offset, double ratioBegin, double ratioGradient, double ratioCurvature) :
+		ratioCurvature(2 * ratioCurvature),
+		ratioGradient(ratioGradient + 2 * ratioCurvature),
+		ratio(ratioBegin + 0.5 * ratioGradient + ratioCurvature / 3),
 		x(offset)
 	{
 	}
@@ -132,6 +223,7 @@ struct RatioState<false>
 	{
 		x += ratio;
 		ratio += ratioGradient;
+		ratioGradient += ratioCurvature;
 	}
 };
 
@@ -141,11 +233,11 @@ struct RatioState<true>
 	const double ratio;
 	double x;
 
-	inline RatioState(double offset, double ratio, double ratioGradient) :
+	inline RatioState(double offset, double ratio, double ratioGradient, double ratioCurvature) :
 		ratio(ratio),
 		x(offset)
 	{
-		BUNGEE_ASSERT1(ratioGradient == 0);
+		BUNGEE_ASSERT1(ratioGradient == 0 && ratioCurvature == 0);
 	}
 
 	inline void step()
@@ -173,18 +265,89 @@ struct Loop
 			BUNGEE_ASSERT2(ratioState.ratio > 0.);
 
 			if (row >= external.unmutedBegin && row < external.unmutedEnd)
-				Interpolation::template step<Mode>(ratioState.x, external.ref.cols(), internal.array.data(), internal.array.colStride(), external.ref.data() + row, external.ref.colStride(), ratioState.ratio);
+				Interpolation::template step<Mode>(ratioState.x, external.ref.cols(), internal.array.data(), internal.array.colStride(), external.ref.data() + row * external.ref.rowStride(), external.ref.colStride(), ratioState.ratio);
 
 			ratioState.step();
 		}
 	}
 };
 
+// Bilinear output resampling handles a block of frames per kernel call: positions are accumulated
+// in double precision exactly as the generic loop does, then interpolated using SIMD.
+template <>
+struct Loop<Bilinear, Output>
+{
+	static constexpr int blockFrameCount = 64;
+
+	template <bool ratioIsConstant>
+	static __attribute__((noinline)) void run(RatioState<ratioIsConstant> &ratioState, Internal &internal, External external)
+	{
+		const Assert::FloatingPointExceptions floatingPointExceptions(FE_INEXACT | FE_UNDERFLOW);
+
+		BUNGEE_ASSERT1(internal.array.cols() == external.ref.cols());
+
+		const auto kernel = bilinearOutputKernel();
+		const auto channelCount = (int)external.ref.cols();
+
+		// Kernels store consecutive frames, so interleaved output takes the generic path
+		if (external.ref.rowStride() != 1)
+		{
+			for (ptrdiff_t row = 0; row < external.activeFrameCount; ++row)
+			{
+				if (row >= external.unmutedBegin && row < external.unmutedEnd)
+					Bilinear::step<Output>(ratioState.x, channelCount, internal.array.data(), internal.array.colStride(), external.ref.data() + row * external.ref.rowStride(), external.ref.colStride(), ratioState.ratio);
+				ratioState.step();
+			}
+			return;
+		}
+
+		ptrdiff_t row = 0;
+		for (; row < external.unmutedBegin; ++row)
+			ratioState.step();
+
+		while (row < external.unmutedEnd)
+		{
+			const auto frameCount = (int)std::min<ptrdiff_t>(blockFrameCount, external.unmutedEnd - row);
+
+			alignas(32) float x[blockFrameCount];
+			for (int i = 0; i < frameCount; ++i)
+			{
+				BUNGEE_ASSERT2(ratioState.x >= 0.);
+				BUNGEE_ASSERT2(ratioState.ratio > 0.);
+				BUNGEE_ASSERT2(intptr_t(ratioState.x) + 1 < internal.array.colStride());
+				x[i] = ratioState.x;
+				ratioState.step();
+			}
+
+			kernel(frameCount, x, channelCount, internal.array.data(), internal.array.colStride(), external.ref.data() + row, external.ref.colStride());
+
+			// Kernels match the scalar reference exactly unless the compiler contracts multiply-adds differently
+			if constexpr (Assert::level >= 2)
+				for (int c = 0; c < channelCount; ++c)
+					for (int i = 0; i < frameCount; ++i)
+					{
+						const auto column = internal.array.col(c).data();
+						const auto tolerance = 1e-6f * (std::abs(column[intptr_t(x[i])]) + std::abs(column[intptr_t(x[i]) + 1]));
+						BUNGEE_ASSERT2(std::abs(external.ref(row + i, c) - bilinearOutputTap(x[i], column)) <= tolerance);
+					}
+
+			row += frameCount;
+		}
+
+		for (; row < external.activeFrameCount; ++row)
+			ratioState.step();
+	}
+};
+
+// Over the active frames, the ratio runs from ratioBegin to ratioEnd along a line, or along a parabola that departs
+// from that line by ratioBend midway
 template <class Interpolation, class Mode, bool ratioIsConstant>
-inline void resampleSpecial(Internal &internal, External external, double ratioBegin, double ratioEnd)
+inline void resampleSpecial(Internal &internal, External external, double ratioBegin, double ratioEnd, double ratioBend)
 {
-	const auto ratioGradient = (ratioEnd - ratioBegin) / external.activeFrameCount;
-	RatioState<ratioIsConstant> ratioState(Internal::padding + internal.offset, ratioBegin, ratioGradient);
+	const double n = external.activeFrameCount;
+	const auto ratioGradient = (ratioEnd - ratioBegin + 4 * ratioBend) / n;
+	const auto ratioCurvature = -4 * ratioBend / (n * n);
+	RatioState<ratioIsConstant> ratioState(Internal::padding + internal.offset, ratioBegin, ratioGradient, ratioCurvature);
 
 	Loop<Interpolation, Mode>::run(ratioState, internal, external);
 
@@ -192,9 +355,24 @@ inline void resampleSpecial(Internal &internal, External external, double ratioB
 }
 
 template <class Interpolation, class Mode>
-void resample(Internal &internal, External &external, double ratioBegin, double ratioEnd, bool alignEnd)
+void resample(Internal &internal, External &external, double ratioBegin, double ratioEnd, double ratioBend, bool alignEnd)
 {
-	const auto idealFrameCount = (ptrdiff_t)std::round(2 * (internal.frameCount - internal.offset) / (ratioBegin + ratioEnd));
+	if (ratioBend < 0)
+	{
+		// A curve bowed low must turn well above zero ratio, or it is straightened
+		const double t = std::clamp((ratioEnd - ratioBegin + 4 * ratioBend) / (8 * ratioBend), 0., 1.);
+		const double lowest = ratioBegin + (ratioEnd - ratioBegin + 4 * ratioBend) * t - 4 * ratioBend * t * t;
+		if (!(lowest > 0.5 * std::min(ratioBegin, ratioEnd)))
+			ratioBend = 0.;
+	}
+
+	// The mean of the parabola's ratio exceeds that of the line by two thirds of its bend
+	auto idealFrameCount = (ptrdiff_t)std::round((internal.frameCount - internal.offset) / (0.5 * (ratioBegin + ratioEnd) + ratioBend * (2. / 3)));
+	if (ratioBend && idealFrameCount > external.ref.rows())
+	{
+		ratioBend = 0.;
+		idealFrameCount = (ptrdiff_t)std::round(2 * (internal.frameCount - internal.offset) / (ratioBegin + ratioEnd));
+	}
 
 	const bool truncate = idealFrameCount > external.ref.rows();
 	BUNGEE_ASSERT1(!truncate);
@@ -206,17 +384,17 @@ void resample(Internal &internal, External &external, double ratioBegin, double
 		if (alignEnd)
 		{
 			const auto meanRatio = (internal.frameCount - internal.offset) / external.activeFrameCount;
-			ratioEnd = 2 * meanRatio - ratioBegin;
+			ratioEnd = 2 * (meanRatio - ratioBend * (2. / 3)) - ratioBegin;
 			BUNGEE_ASSERT1(ratioEnd > 0);
 		}
 
 		external.unmutedBegin = std::clamp<ptrdiff_t>(external.unmutedBegin, 0, external.activeFrameCount);
 		external.unmutedEnd = std::clamp<ptrdiff_t>(external.unmutedEnd, external.unmutedBegin, external.activeFrameCount);
 
-		if (ratioBegin == ratioEnd)
-			resampleSpecial<Interpolation, Mode, true>(internal, external, ratioBegin, ratioEnd);
+		if (ratioBegin == ratioEnd && !ratioBend)
+			resampleSpecial<Interpolation, Mode, true>(internal, external, ratioBegin, ratioEnd, ratioBend);
 		else
-			resampleSpecial<Interpolation, Mode, false>(internal, external, ratioBegin, ratioEnd);
+			resampleSpecial<Interpolation, Mode, false>(internal, external, ratioBegin, ratioEnd, ratioBend);
 
 		internal.offset -= internal.frameCount;
 
@@ -234,20 +412,33 @@ struct Operation
 {
 	Function function{};
 	double ratio{1.};
+
+	// Output ratio midway from the previous grain, for a curved rather than linear ramp to this one, or zero
+	double midpointRatio{};
 };
 
 struct Operations
 {
 	Operation input, output;
 
-	double setup(const SampleRates &sampleRates, double pitch, ResampleMode resampleMode)
+	// interpolationMode selects only the resample functions, not the ratios or the returned scale of hops
+	double setup(const SampleRates &sampleRates, double pitch, ResampleMode resampleMode, InterpolationMode interpolationMode = interpolationMode_bilinear)
 	{
 		const double resampleRatio = pitch * sampleRates.input / sampleRates.output;
 		input.ratio = 1. / resampleRatio;
 		output.ratio = resampleRatio;
 
-		input.function = &resample<Bilinear, Input>;
-		output.function = &resample<Bilinear, Output>;
+		if (interpolationMode == interpolationMode_sinc)
+		{
+			input.function = &resample<Sinc, Input>;
+			output.function = &resample<Sinc, Output>;
+		}
+		else
+		{
+			BUNGEE_ASSERT1(interpolationMode == interpolationMode_bilinear);
+			input.function = &resample<Bilinear, Input>;
+			output.function = &resample<Bilinear, Output>;
+		}
 
 		if (resampleMode == resampleMode_forceOut)
 			input.function = nullptr;
@@ -0,0 +1,105 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include "Assert.h"
+
+#include "bungee/Bungee.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+namespace Bungee::Samples {
+
+// Packed, little-endian 24-bit sample
+struct Int24
+{
+	uint8_t bytes[3];
+};
+
+// IEEE 754 binary16 sample
+struct Float16
+{
+	uint16_t bits;
+};
+
+static inline float toFloat(float x)
+{
+	return x;
+}
+
+static inline float toFloat(int16_t x)
+{
+	return x * (1.f / (1 << 15));
+}
+
+static inline float toFloat(Int24 x)
+{
+	const auto i = int32_t(uint32_t(x.bytes[0]) << 8 | uint32_t(x.bytes[1]) << 16 | uint32_t(x.bytes[2]) << 24) >> 8;
+	return i * (1.f / (1 << 23));
+}
+
+static inline float toFloat(Float16 x)
+{
+	const uint32_t sign = uint32_t(x.bits & 0x8000) << 16;
+	const uint32_t exponent = (x.bits >> 10) & 0x1f;
+	const uint32_t mantissa = x.bits & 0x3ff;
+
+	if (exponent == 0)
+	{
+		// zero or subnormal
+		const float magnitude = mantissa * (1.f / (1 << 24));
+		return sign ? -magnitude : magnitude;
+	}
+
+	if (exponent == 0x1f)
+		return std::bit_cast<float>(sign | 0x7f800000 | mantissa << 13);
+
+	return std::bit_cast<float>(sign | (exponent + 127 - 15) << 23 | mantissa << 13);
+}
+
+// Calls f with data cast to a pointer to the sample type of sampleFormat
+template <class F>
+static inline decltype(auto) dispatch(SampleFormat sampleFormat, const void *data, F f)
+{
+	switch (sampleFormat)
+	{
+	case sampleFormat_int16:
+		return f(static_cast<const int16_t *>(data));
+	case sampleFormat_int24:
+		return f(static_cast<const Int24 *>(data));
+	case sampleFormat_float16:
+		return f(static_cast<const Float16 *>(data));
+	default:
+		BUNGEE_ASSERT1(sampleFormat == sampleFormat_float32);
+		return f(static_cast<const float *>(data));
+	}
+}
+
+// Triangular probability density dither of one 16-bit LSB peak, from a linear congruential generator
+struct Dither
+{
+	uint32_t state = 1;
+
+	inline float operator()()
+	{
+		return uniform() - uniform();
+	}
+
+	inline float uniform()
+	{
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.f / (1 << 24));
+	}
+};
+
+static inline int16_t toInt16(float x, Dither &dither)
+{
+	const auto y = std::round(x * (1 << 15) + dither());
+	return (int16_t)std::clamp(y, -32768.f, 32767.f);
+}
+
+} // namespace Bungee::Samples
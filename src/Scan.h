@@ -0,0 +1,128 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include "Phase.h"
+
+#if defined(__SSE2__)
+#	include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#endif
+
+// Wrapping prefix sums of phases, eight lanes at a time where SSE2 or NEON is available.
+// Results are identical to scalar loops because Phase::Type arithmetic wraps in every implementation.
+
+namespace Bungee::Scan {
+
+#if defined(__SSE2__)
+
+#	define BUNGEE_SCAN_VECTOR 1
+
+typedef __m128i Vector;
+
+static inline Vector load(const Phase::Type *p)
+{
+	return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void store(Phase::Type *p, Vector x)
+{
+	_mm_storeu_si128((__m128i *)p, x);
+}
+
+static inline Vector add(Vector a, Vector b)
+{
+	return _mm_add_epi16(a, b);
+}
+
+// Returns the inclusive prefix sum of the lanes of x, each offset by carry
+static inline Vector inclusive(Vector x, Vector carry)
+{
+	x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+	x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+	x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+	return _mm_add_epi16(x, carry);
+}
+
+// Returns the last lane of x in every lane
+static inline Vector last(Vector x)
+{
+	return _mm_shuffle_epi32(_mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static inline Phase::Type extract(Vector x)
+{
+	return Phase::Type(_mm_cvtsi128_si32(x));
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+#	define BUNGEE_SCAN_VECTOR 1
+
+typedef int16x8_t Vector;
+
+static inline Vector load(const Phase::Type *p)
+{
+	return vld1q_s16(p);
+}
+
+static inline void store(Phase::Type *p, Vector x)
+{
+	vst1q_s16(p, x);
+}
+
+static inline Vector add(Vector a, Vector b)
+{
+	return vaddq_s16(a, b);
+}
+
+static inline Vector inclusive(Vector x, Vector carry)
+{
+	const auto zero = vdupq_n_s16(0);
+	x = vaddq_s16(x, vextq_s16(zero, x, 7));
+	x = vaddq_s16(x, vextq_s16(zero, x, 6));
+	x = vaddq_s16(x, vextq_s16(zero, x, 4));
+	return vaddq_s16(x, carry);
+}
+
+static inline Vector last(Vector x)
+{
+	return vdupq_laneq_s16(x, 7);
+}
+
+static inline Phase::Type extract(Vector x)
+{
+	return vgetq_lane_s16(x, 0);
+}
+
+#else
+
+#	define BUNGEE_SCAN_VECTOR 0
+
+#endif
+
+// values[m] += steps[0] + ... + steps[m] for 0 <= m < n
+static inline void accumulate(Phase::Type *values, const Phase::Type *steps, int n)
+{
+	int m = 0;
+	Phase::Type sum = 0;
+#if BUNGEE_SCAN_VECTOR
+	Vector carry{};
+	for (; m + 8 <= n; m += 8)
+	{
+		const auto prefix = inclusive(load(steps + m), carry);
+		carry = last(prefix);
+		store(values + m, add(load(values + m), prefix));
+	}
+	sum = extract(carry);
+#endif
+	for (; m < n; ++m)
+	{
+		sum += steps[m];
+		values[m] += sum;
+	}
+}
+
+} // namespace Bungee::Scan
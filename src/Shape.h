@@ -0,0 +1,55 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include "Assert.h"
+
+namespace Bungee {
+
+// Shapes for which the stages of grain processing are compiled with a fixed channel count and synthesis hop.
+// Common configurations are listed: mono and stereo at 44.1 and 48 kHz for each value of log2SynthesisHopAdjust,
+// which also covers 88.2 and 96 kHz at default granularity. Other configurations use Shape<0, 0>.
+#define BUNGEE_SHAPES \
+	X_SHAPE(1, 8) \
+	X_SHAPE(1, 9) \
+	X_SHAPE(1, 10) \
+	X_SHAPE(2, 8) \
+	X_SHAPE(2, 9) \
+	X_SHAPE(2, 10)
+
+// Compile-time channel count and log2 synthesis hop of a stretcher, either being zero where known only at run time
+template <int fixedChannelCount_, int fixedLog2SynthesisHop_>
+struct Shape
+{
+	static constexpr int fixedChannelCount = fixedChannelCount_;
+	static constexpr int fixedLog2SynthesisHop = fixedLog2SynthesisHop_;
+
+	static inline int channelCount(int channelCount)
+	{
+		BUNGEE_ASSERT1(!fixedChannelCount || channelCount == fixedChannelCount);
+		return fixedChannelCount ? fixedChannelCount : channelCount;
+	}
+
+	static inline int log2SynthesisHop(int log2SynthesisHop)
+	{
+		BUNGEE_ASSERT1(!fixedLog2SynthesisHop || log2SynthesisHop == fixedLog2SynthesisHop);
+		return fixedLog2SynthesisHop ? fixedLog2SynthesisHop : log2SynthesisHop;
+	}
+};
+
+typedef Shape<0, 0> DynamicShape;
+
+// Calls f with a default-constructed shape for the given channel count and log2 synthesis hop
+template <class F>
+static inline decltype(auto) dispatchShape(int channelCount, int log2SynthesisHop, F f)
+{
+#define X_SHAPE(c, h) \
+	if (channelCount == c && log2SynthesisHop == h) \
+		return f(Shape<c, h>{});
+	BUNGEE_SHAPES
+#undef X_SHAPE
+	return f(DynamicShape{});
+}
+
+} // namespace Bungee
@@ -0,0 +1,300 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#include "Stretcher.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Bungee {
+
+namespace Snapshot {
+
+// Leading bytes of every snapshot, which also reject snapshots of the other byte order
+static constexpr uint32_t magic = 0x6e756253; // "Sbun" when little endian
+
+// Changes whenever the layout below changes
+static constexpr uint32_t format = 5;
+
+// Writes state to a buffer or, without one, just measures it
+struct Writer
+{
+	std::byte *data;
+	std::size_t size{};
+
+	static constexpr bool applying()
+	{
+		return false;
+	}
+
+	inline bool check(bool condition)
+	{
+		BUNGEE_ASSERT1(condition);
+		return true;
+	}
+
+	template <class T>
+	inline void array(const T *p, std::ptrdiff_t n)
+	{
+		const std::size_t bytes = n * sizeof(T);
+		if (data && bytes)
+			std::memcpy(data + size, p, bytes);
+		size += bytes;
+	}
+
+	template <class T, class Valid>
+	inline void array(const T *p, std::ptrdiff_t n, Valid)
+	{
+		array(p, n);
+	}
+
+	template <class T>
+	inline T value(const T &x)
+	{
+		array(&x, 1);
+		return x;
+	}
+};
+
+// Reads state from a buffer: first only to check it and then, with apply set, to replace the stretcher's state
+struct Reader
+{
+	const std::byte *data;
+	std::size_t size;
+	bool apply;
+	std::size_t used{};
+	bool ok = true;
+
+	inline bool applying() const
+	{
+		return apply;
+	}
+
+	inline bool check(bool condition)
+	{
+		ok = ok && condition;
+		return ok;
+	}
+
+	// Copies n elements to p, or when only checking just skips them
+	template <class T>
+	inline void array(T *p, std::ptrdiff_t n, bool copy = false)
+	{
+		if (!check(n >= 0 && std::size_t(n) <= (size - used) / sizeof(T)))
+			return;
+		if ((apply || copy) && n)
+			std::memcpy(p, data + used, n * sizeof(T));
+		used += n * sizeof(T);
+	}
+
+	// As above, also checking that valid() holds of each element, whether or not it is copied
+	template <class T, class Valid>
+	inline void array(T *p, std::ptrdiff_t n, Valid valid)
+	{
+		if (!check(n >= 0 && std::size_t(n) <= (size - used) / sizeof(T)))
+			return;
+		for (std::ptrdiff_t i = 0; i < n && ok; ++i)
+		{
+			T v;
+			std::memcpy(&v, data + used + i * sizeof(T), sizeof(T));
+			check(valid(v));
+		}
+		array(p, n);
+	}
+
+	// Returns the next value, which also replaces x when applying
+	template <class T>
+	inline T value(T &x)
+	{
+		T v{};
+		array(&v, 1, true);
+		if (apply && ok)
+			x = v;
+		return v;
+	}
+};
+
+// Restored values must not raise floating-point exceptions when later grains compare, scale, sum or round them
+static constexpr float maxEnergy = 0x1p100f; // far above the bin energy of any audio, far below overflow
+
+// Positions, restored or advanced by later grains' hops, stay well within int
+static constexpr double maxPosition = 0x1p30;
+
+static bool energy(float x)
+{
+	return std::isfinite(x) && x >= 0.f && x <= maxEnergy;
+}
+
+// Function pointers differ between processes, so resample operations are stored as the kind of interpolation
+template <class Mode, class Archive>
+static void transfer(Archive &archive, Resample::Operation &operation)
+{
+	const auto sinc = &Resample::resample<Resample::Sinc, Mode>;
+	const auto bilinear = &Resample::resample<Resample::Bilinear, Mode>;
+
+	uint8_t kind = operation.function == sinc ? 1 : operation.function == bilinear ? 2 : 0;
+	kind = archive.value(kind);
+	archive.check(kind <= 2);
+	archive.value(operation.ratio);
+	archive.value(operation.midpointRatio);
+
+	if (archive.applying())
+		operation.function = kind == 1 ? sinc : kind == 2 ? bilinear : nullptr;
+}
+
+} // namespace Snapshot
+
+template <class Archive>
+void Internal::Stretcher::transfer(Archive &archive)
+{
+	const int channelCount = (int)transformed.cols();
+
+	{
+		// Snapshots restore only to a stretcher of the same configuration
+		const uint32_t header[] = {
+			Snapshot::magic,
+			Snapshot::format,
+			uint32_t(sampleRates.input),
+			uint32_t(sampleRates.output),
+			uint32_t(channelCount),
+			uint32_t(log2SynthesisHop),
+			uint32_t(grains.vector.size()),
+			uint32_t(grains.bufferedCount),
+			uint32_t(pipelined | multiResolution << 1 | lowLatency << 2),
+			uint32_t(groupCount()),
+		};
+		for (const auto expected : header)
+		{
+			auto stored = expected;
+			if (!archive.check(archive.value(stored) == expected))
+				return;
+		}
+
+		for (const auto expected : groupBegin)
+		{
+			auto stored = expected;
+			if (!archive.check(archive.value(stored) == expected))
+				return;
+		}
+	}
+
+	for (int i = 0; i < (int)grains.vector.size(); ++i)
+	{
+		auto &grain = grains[i];
+
+		// Positions index input by int, and each positioned grain is within a frame of its rounded position
+		const auto position = archive.value(grain.request.position);
+		archive.check(std::isnan(position) || std::abs(position) <= Snapshot::maxPosition);
+		archive.value(grain.request.speed);
+		archive.value(grain.request.pitch);
+		archive.value(grain.request.reset);
+		archive.value(grain.request.resampleMode);
+
+		const auto log2TransformLength = archive.value(grain.log2TransformLength);
+		archive.check(log2TransformLength == log2SynthesisHop + 3 || ((multiResolution || lowLatency) && log2TransformLength == log2SynthesisHop + 2));
+		archive.value(grain.requestHop);
+		archive.value(grain.continuous);
+		archive.value(grain.passthrough);
+		const auto validBinCount = archive.value(grain.validBinCount);
+		archive.check(validBinCount >= 0 && validBinCount <= Fourier::binCount(log2SynthesisHop + 3));
+		archive.value(grain.muteFrameCountHead);
+		archive.value(grain.muteFrameCountTail);
+		archive.value(grain.silent);
+		const bool bypass = archive.value(grain.bypass);
+		const auto flux = archive.value(grain.flux);
+		archive.check(std::isfinite(flux));
+		archive.value(grain.transientDistance);
+		Snapshot::transfer<Resample::Input>(archive, grain.resampleOperations.input);
+		Snapshot::transfer<Resample::Output>(archive, grain.resampleOperations.output);
+		archive.value(grain.inputPosition);
+		archive.value(grain.inputChunk.begin);
+		archive.value(grain.inputChunk.end);
+		const auto positionError = archive.value(grain.analysis.positionError);
+		archive.check(std::isnan(position) || std::abs(positionError) <= 1.);
+		archive.value(grain.analysis.hopIdeal);
+		archive.value(grain.analysis.speed);
+		archive.value(grain.analysis.hop);
+
+		if (archive.applying())
+			grain.inputCopyFrameCount = 0;
+
+		if (i < grains.bufferedCount)
+		{
+			for (int g = 0; g < groupCount(); ++g)
+			{
+				auto &group = grain.groups[g];
+				archive.array(group.phase.data(), group.phase.size());
+				// Later grains compare the energies of analysed valid bins; the rest, like padding, are stored but unused
+				const int analysedBinCount = bypass ? 0 : validBinCount;
+				archive.array(group.energy.data(), analysedBinCount, Snapshot::energy);
+				archive.array(group.energy.data() + analysedBinCount, group.energy.size() - analysedBinCount);
+				archive.array(group.rotation.data(), group.rotation.size());
+
+				int partialCount = group.partials.size();
+				partialCount = archive.value(partialCount);
+				if (!archive.check(partialCount >= 0 && partialCount <= group.partials.capacity()))
+					return;
+				if (archive.applying())
+					group.partials.resize(partialCount);
+
+				// Synthesis indexes bins by the partials of a grain it has yet to synthesise, so they must cover its
+				// valid bins in order; the partials of other grains are not used again
+				const bool synthesised = validBinCount > 0 && !bypass;
+				archive.check(!synthesised || partialCount > 0);
+				int end = 0;
+				for (int k = 0; k < partialCount; ++k)
+				{
+					const auto partial = archive.value(group.partials[k]);
+					archive.check(!synthesised || (partial.peak >= 0 && partial.peak < validBinCount && partial.end >= end));
+					end = partial.end;
+				}
+				archive.check(!synthesised || end == validBinCount);
+			}
+
+			// Later grains may yet transform a bypass grain's windowed input
+			if (bypass)
+				archive.array(grain.windowedInput.data(), grain.windowedInput.size());
+		}
+	}
+
+	archive.value(output.lappedSynthesisBuffer.offset);
+	archive.array(output.lappedSynthesisBuffer.array.data(), output.lappedSynthesisBuffer.array.size());
+	archive.value(output.dither.state);
+
+	// The spectrum of the grain analysed most recently, which the next call synthesises
+	if (pipelined)
+		archive.array(transformed.data(), transformed.size());
+}
+
+std::size_t Internal::Stretcher::snapshot(void *data, std::size_t capacity) const
+{
+	// The writer only reads the stretcher's state. It measures the snapshot first so that, unless the whole snapshot
+	// fits, nothing is written.
+	Snapshot::Writer measure{nullptr};
+	const_cast<Stretcher *>(this)->transfer(measure);
+
+	if (data && measure.size <= capacity)
+	{
+		Snapshot::Writer writer{static_cast<std::byte *>(data)};
+		const_cast<Stretcher *>(this)->transfer(writer);
+		BUNGEE_ASSERT1(writer.size == measure.size);
+	}
+	return measure.size;
+}
+
+bool Internal::Stretcher::restore(const void *data, std::size_t size)
+{
+	// The whole snapshot is checked before any state changes, so a stretcher keeps its state if restore fails
+	for (bool apply : {false, true})
+	{
+		Snapshot::Reader reader{static_cast<const std::byte *>(data), data ? size : 0, apply};
+		transfer(reader);
+		if (!reader.ok || reader.used != size)
+			return false;
+	}
+	return true;
+}
+
+} // namespace Bungee
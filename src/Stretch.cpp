@@ -3,6 +3,7 @@
 
 #include "Stretch.h"
 #include "Assert.h"
+#include "Scan.h"
 
 #include <algorithm>
 #include <cmath>
@@ -24,7 +25,36 @@ Frequency::Frequency(float speed)
 void Frequency::operator()(int n, Eigen::Ref<Eigen::ArrayX<Phase::Type>> rotation, const Eigen::Ref<Eigen::ArrayX<Phase::Type>> &phase) const
 {
 	rotation[0] = 0;
-	for (int m = 1; m < n; ++m)
+	int m = 1;
+
+#if BUNGEE_SCAN_VECTOR
+	// Increments for eight bins at a time, as in the scalar loop below, then a prefix sum onto the previous rotation
+	const auto p = phase.data();
+	const auto r = rotation.data();
+	BUNGEE_ASSERT1(multiplier >= std::numeric_limits<int16_t>::min());
+	Scan::Vector carry{};
+	for (; m + 8 <= n; m += 8)
+	{
+#	if defined(__SSE2__)
+		const auto k = _mm_set1_epi16(int16_t(multiplier));
+		const auto delta = _mm_sub_epi16(Scan::load(p + m - 1), Scan::load(p + m));
+		const auto lo = _mm_mullo_epi16(delta, k);
+		const auto hi = _mm_mulhi_epi16(delta, k);
+		const auto x = _mm_or_si128(_mm_srli_epi16(lo, shift), _mm_slli_epi16(hi, 16 - shift));
+#	else
+		const auto k = vdupq_n_s16(int16_t(multiplier));
+		const auto delta = vsubq_s16(Scan::load(p + m - 1), Scan::load(p + m));
+		const auto lo = vshrq_n_s32(vmull_s16(vget_low_s16(delta), vget_low_s16(k)), shift);
+		const auto hi = vshrq_n_s32(vmull_high_s16(delta, k), shift);
+		const auto x = vcombine_s16(vmovn_s32(lo), vmovn_s32(hi));
+#	endif
+		const auto sum = Scan::inclusive(Scan::add(x, delta), carry);
+		carry = Scan::last(sum);
+		Scan::store(r + m, sum);
+	}
+#endif
+
+	for (; m < n; ++m)
 	{
 		Phase::Type delta = phase[m - 1] - phase[m];
 
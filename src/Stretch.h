@@ -24,17 +24,18 @@ struct Frequency
 template <bool reverse, bool reversePrevious>
 struct Time
 {
-	static constexpr auto log2SynthesisHopRevolution = -3;
-
 	int32_t a;
 	int32_t multiplier = 0;
 
-	Time(int log2SynthesisHop, int analysisHop, [[maybe_unused]] int analysisHopPrevious)
+	// Expected phase advance, per bin, over a synthesis hop: 2^logS of 2^32 units of a revolution
+	int logS;
+
+	Time(int log2SynthesisHop, int log2TransformLength, int analysisHop, [[maybe_unused]] int analysisHopPrevious) :
+		logS(32 + log2SynthesisHop - log2TransformLength)
 	{
 		BUNGEE_ASSERT1(reverse ^ (analysisHop >= 0));
 		BUNGEE_ASSERT1(reversePrevious ^ (analysisHopPrevious >= 0));
 
-		const auto log2TransformLength = log2SynthesisHop - log2SynthesisHopRevolution;
 		a = int32_t(analysisHop) << (32 - log2TransformLength);
 
 		const auto dividend = int32_t(1 << log2SynthesisHop) << 16;
@@ -50,7 +51,6 @@ struct Time
 
 	inline int32_t delta(int32_t phase, int32_t previous, int m) const
 	{
-		constexpr auto logS = 32 + log2SynthesisHopRevolution;
 		const int32_t da = (phase - previous) - m * a;
 		return (m << logS) + (da >> 15) * multiplier;
 	}
@@ -6,29 +6,113 @@
 #include "Stretcher.h"
 #include "Assert.h"
 #include "Instrumentation.h"
+#include "Polar.h"
 #include "Resample.h"
+#include "Shape.h"
 #include "Synthesis.h"
 #include "log2.h"
 
 namespace Bungee {
 
-Internal::Stretcher::Stretcher(SampleRates sampleRates, int channelCount, int log2SynthesisHopAdjust) :
+namespace {
+
+template <class Shape>
+static constexpr Internal::Stretcher::Stages shapedStages{
+	&Internal::Stretcher::analyseInput<Shape>,
+	&Internal::Stretcher::analyseSpectrum<Shape>,
+	&Internal::Stretcher::synthesiseSpectrum<Shape>,
+	&Internal::Stretcher::synthesiseOutput<Shape>,
+};
+
+} // namespace
+
+Internal::Stretcher::Stretcher(SampleRates sampleRates, int channelCount, int log2SynthesisHopAdjust, const Allocator *allocator) :
 	Timing(sampleRates, log2SynthesisHopAdjust),
+	arena(allocator),
 	input(log2SynthesisHop, channelCount, transforms),
-	grains(4),
-	output(transforms, log2SynthesisHop, channelCount, maxOutputFrameCount(true), 0.25f, {1.f, 0.5f}),
-	synthesis(log2SynthesisHop + 3)
+	grains(4, allocator),
+	output(transforms, log2SynthesisHop, 0.25f, {1.f, 0.5f}),
+	stages(dispatchShape(channelCount, log2SynthesisHop, [](auto shape) { return &shapedStages<decltype(shape)>; }))
 {
 	for (auto &grain : grains.vector)
 		grain = std::make_unique<Grain>(log2SynthesisHop, channelCount);
 
+	// Measure, allocate once, then lay out for real
+	allocate(channelCount);
+	arena.allocate();
+	allocate(channelCount);
+
 	grains.prepare();
+	if constexpr (Assert::level)
+		grains.allocateInputCopies(maxInputFrameCount(true));
+
+	// One group of all channels, with room for as many groups as channels
+	groupBegin.reserve(channelCount + 1);
+	groupBegin = {0, channelCount};
+	channelGroup.assign(channelCount, 0);
+}
+
+void Internal::Stretcher::allocate(int channelCount)
+{
+	input.allocate(arena, log2SynthesisHop, channelCount, maxInputFrameCount(true));
+	grains.allocate(arena, log2SynthesisHop + 3, channelCount);
+	output.allocate(arena, log2SynthesisHop, channelCount, maxOutputFrameCount(true));
+	synthesis.allocate(arena, log2SynthesisHop + 3);
+	formant.allocate(arena, log2SynthesisHop + 3);
+	Fourier::allocate<true>(arena, log2SynthesisHop + 3, channelCount, temporary);
+	Fourier::allocate<true>(arena, log2SynthesisHop + 3, channelCount, transformed);
+
+	// Allocated whether or not pipelining is enabled, so that enablePipelining() does not allocate buffers
+	Fourier::allocate<true>(arena, log2SynthesisHop + 3, channelCount, transformedNext);
+}
+
+void Internal::Stretcher::enableInstrumentation(bool enable)
+{
+	Instrumentation::enableInstrumentation(enable);
+	if (enable)
+		grains.allocateInputCopies(maxInputFrameCount(true));
+}
+
+void Internal::Stretcher::enableRealTime(bool enable)
+{
+	Instrumentation::enableRealTime(enable);
+	workers.setRealTime(enable);
+}
 
-	Fourier::resize<true>(log2SynthesisHop + 3, 1, temporary);
-	Fourier::resize<true>(log2SynthesisHop + 3, channelCount, transformed);
+void Internal::Stretcher::enableMultiResolution(bool enable)
+{
+	if (enable)
+	{
+		input.prepareShortWindow(log2SynthesisHop, (int)transformed.cols(), transforms);
+		transforms.prepareInverse(log2SynthesisHop + 2);
+	}
+	multiResolution = enable;
 }
 
-InputChunk Internal::Stretcher::specifyGrain(const Request &request, double bufferStartPosition)
+void Internal::Stretcher::enableLowLatency(bool enable)
+{
+	if (enable)
+	{
+		input.prepareShortWindow(log2SynthesisHop, (int)transformed.cols(), transforms);
+		transforms.prepareInverse(log2SynthesisHop + 2);
+	}
+	lowLatency = enable;
+
+	// Input resampling fills the shorter analysis window
+	input.resampled.frameCount = Fourier::transformLength(log2AnalysisLength());
+}
+
+double Internal::Stretcher::latency(const Request &request) const
+{
+	Resample::Operations resampleOperations;
+	resampleOperations.setup(sampleRates, request.pitch, request.resampleMode);
+	const int lookahead = Grain::halfInputFrameCount(log2AnalysisLength(), resampleOperations.input.ratio);
+
+	// Each output chunk begins at the position of the grain before last, or of one grain earlier when pipelined
+	return lookahead + (2 + pipelined) * std::abs(calculateInputHop(request));
+}
+
+InputChunk Internal::Stretcher::specifyGrain(const Request &request, double bufferStartPosition, double pitchMidpoint)
 {
 	Instrumentation::Call call(*this, 0);
 	const Assert::FloatingPointExceptions floatingPointExceptions(0);
@@ -38,87 +122,501 @@ InputChunk Internal::Stretcher::specifyGrain(const Request &request, double buff
 	auto &grain = grains[0];
 	auto &previous = grains[1];
 
-	return grain.specify(request, previous, sampleRates, log2SynthesisHop, bufferStartPosition, *this);
+	const auto inputChunk = grain.specify(request, interpolationMode, pitchMidpoint, previous, sampleRates, log2SynthesisHop, log2AnalysisLength(), bufferStartPosition, *this);
+	if (multiResolution && !lowLatency)
+		grain.selectTransformLength(previous, log2SynthesisHop);
+	return inputChunk;
 }
 
-void Internal::Stretcher::analyseGrain(const float *data, std::ptrdiff_t stride, int muteFrameCountHead, int muteFrameCountTail)
+void Internal::Stretcher::analyseGrain(const void *data, SampleFormat sampleFormat, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int muteFrameCountHead, int muteFrameCountTail)
 {
 	Instrumentation::Call call(*this, 1);
+
+	if (pipelined)
+	{
+		// Analyse this grain while synthesising the previous grain, whose output synthesiseGrain() will return
+		workers.forEach(2, [&](int task) {
+			if (task == 0)
+			{
+				analyseInput(data, sampleFormat, channelStride, frameStride, muteFrameCountHead, muteFrameCountTail);
+				analyseSpectrum();
+			}
+			else
+			{
+				synthesiseSpectrum();
+				synthesiseOutput(pipelinedOutputChunk);
+			}
+		});
+		swap(transformed, transformedNext);
+	}
+	else
+	{
+		analyseInput(data, sampleFormat, channelStride, frameStride, muteFrameCountHead, muteFrameCountTail);
+		analyseSpectrum();
+	}
+}
+
+void Internal::Stretcher::synthesiseGrain(OutputChunk &outputChunk)
+{
+	Instrumentation::Call call(*this, 2);
+
+	if (pipelined)
+	{
+		outputChunk = pipelinedOutputChunk;
+	}
+	else
+	{
+		synthesiseSpectrum();
+		synthesiseOutput(outputChunk);
+	}
+}
+
+void Internal::Stretcher::synthesiseGrain(OutputChunk &outputChunk, int16_t *data, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride)
+{
+	synthesiseGrain(outputChunk);
+	output.writeInt16(outputChunk, data, channelStride, frameStride);
+}
+
+void Internal::Stretcher::enablePipelining(bool enable)
+{
+	BUNGEE_ASSERT1(grains.flushed());
+	if (enable == pipelined)
+		return;
+
+	pipelined = enable;
+
+	// Synthesis of the previous grain needs phase and rotation buffers for one more grain, and output chunks
+	// refer to requests of one grain further back, so the pipeline keeps an extra grain.
+	if (pipelined)
+	{
+		grains.vector.push_back(std::make_unique<Grain>(log2SynthesisHop, (int)transformed.cols()));
+		grains.bufferedCount = 3;
+	}
+	else
+	{
+		grains.vector.pop_back();
+		grains.bufferedCount = 2;
+	}
+	grains.prepare();
+	pipelinedOutputChunk = OutputChunk{};
+}
+
+bool Internal::Stretcher::setChannelGroups(const int *channelCounts, int count)
+{
+	const int channelCount = (int)channelGroup.size();
+	if (!grains.flushed() || count < 0 || count > channelCount || (count && !channelCounts))
+		return false;
+
+	int total = 0;
+	for (int g = 0; g < count; ++g)
+	{
+		if (channelCounts[g] < 1)
+			return false;
+		total += channelCounts[g];
+	}
+	if (count && total != channelCount)
+		return false;
+
+	groupBegin.resize(1);
+	if (count)
+		for (int g = 0; g < count; ++g)
+			groupBegin.push_back(groupBegin.back() + channelCounts[g]);
+	else
+		groupBegin.push_back(channelCount);
+
+	for (int g = 0; g < groupCount(); ++g)
+		for (int c = groupBegin[g]; c < groupBegin[g + 1]; ++c)
+			channelGroup[c] = g;
+	return true;
+}
+
+void Internal::Stretcher::processGrains(int count, Stretcher *const *stretchers, const GrainInput *inputs, OutputChunk *outputChunks)
+{
+	// Stretchers of equal granularity share windows and transform kernels (see Window::shared and
+	// Fourier::sharedKernel) so processing stage by stage keeps these tables in cache.
+	for (int i = 0; i < count; ++i)
+	{
+		Instrumentation::Call call(*stretchers[i], 1);
+		stretchers[i]->analyseInput(inputs[i].data, sampleFormat_float32, inputs[i].channelStride, 1, inputs[i].muteFrameCountHead, inputs[i].muteFrameCountTail);
+	}
+
+	for (int i = 0; i < count; ++i)
+		stretchers[i]->analyseSpectrum();
+
+	for (int i = 0; i < count; ++i)
+	{
+		Instrumentation::Call call(*stretchers[i], 2);
+		stretchers[i]->synthesiseSpectrum();
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		stretchers[i]->synthesiseOutput(outputChunks[i]);
+		if (stretchers[i]->pipelined)
+			swap(stretchers[i]->transformed, stretchers[i]->transformedNext);
+	}
+}
+
+void Internal::Stretcher::analyseInput(const void *data, SampleFormat sampleFormat, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int muteFrameCountHead, int muteFrameCountTail)
+{
+	(this->*stages->analyseInput)(data, sampleFormat, channelStride, frameStride, muteFrameCountHead, muteFrameCountTail);
+}
+
+void Internal::Stretcher::analyseSpectrum()
+{
+	(this->*stages->analyseSpectrum)();
+}
+
+void Internal::Stretcher::synthesiseSpectrum()
+{
+	(this->*stages->synthesiseSpectrum)();
+}
+
+void Internal::Stretcher::synthesiseOutput(OutputChunk &outputChunk)
+{
+	(this->*stages->synthesiseOutput)(outputChunk);
+}
+
+template <class Shape>
+void Internal::Stretcher::polar(Grain &grain, int group, const Mapped<Eigen::ArrayXXcf> &analysed)
+{
+	auto &g = grain.groups[group];
+	if (groupCount() == 1)
+	{
+		Polar::kernel<Shape::fixedChannelCount>()(grain.validBinCount, Shape::channelCount((int)analysed.cols()), analysed.data(), analysed.colStride(), g.energy.data(), g.phase.data());
+	}
+	else
+	{
+		const int begin = groupBegin[group];
+		Polar::kernel<0>()(grain.validBinCount, groupBegin[group + 1] - begin, analysed.col(begin).data(), analysed.colStride(), g.energy.data(), g.phase.data());
+	}
+}
+
+template <class Shape>
+void Internal::Stretcher::analyseInput(const void *data, SampleFormat sampleFormat, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int muteFrameCountHead, int muteFrameCountTail)
+{
 	const Assert::FloatingPointExceptions floatingPointExceptions(FE_INEXACT | FE_UNDERFLOW | FE_DENORMALOPERAND);
 
 	auto &grain = grains[0];
-	const auto &previous = grains[1];
+	auto &previous = grains[1];
 
-	Instrumentation::log("analyseGrain: position=%f speed=%f pitch=%f reset=%s data=%p stride=%d mute=%d:%d", grain.request.position, grain.request.speed, grain.request.pitch, grain.request.reset ? "true" : "false", data, stride, muteFrameCountHead, muteFrameCountTail);
+	Instrumentation::log("analyseGrain: position=%f speed=%f pitch=%f reset=%s data=%p stride=%d:%d mute=%d:%d", grain.request.position, grain.request.speed, grain.request.pitch, grain.request.reset ? "true" : "false", data, (int)channelStride, (int)frameStride, muteFrameCountHead, muteFrameCountTail);
 
 	grain.muteFrameCountHead = muteFrameCountHead;
 	grain.muteFrameCountTail = muteFrameCountTail;
 
 	grain.validBinCount = 0;
+	grain.bypass = false;
 	if (grain.valid())
 	{
-		auto m = grain.inputChunkMap(data, stride, muteFrameCountHead, muteFrameCountTail, previous, *this);
+		const auto n = Fourier::binCount(grain.log2TransformLength) - 1;
+		grain.validBinCount = std::min<int>(std::ceil(n / grain.resampleOperations.output.ratio), n) + 1;
 
-		auto ref = grain.resampleInput(m, log2SynthesisHop + 3, muteFrameCountHead, muteFrameCountTail, input.resampled);
+		// Rotation is zero throughout passthrough so, unless output resampling band limits the spectrum or formant
+		// correction scales it, the inverse transform would just reproduce the windowed input: a bypass grain overlap-adds that directly
+		grain.bypass = grain.passthrough && grain.validBinCount == n + 1 && !formantCorrected(grain);
 
-		auto log2TransformLength = input.applyAnalysisWindow(ref, muteFrameCountHead, muteFrameCountTail);
+		auto &analysed = pipelined ? transformedNext : transformed;
 
-		transforms.forward(log2TransformLength, input.windowedInput, transformed);
+		if (grain.continuous && previous.bypass && !grain.bypass)
+		{
+			// Synthesis of this grain continues from the phase of the previous, bypass grain, so analyse that now
+			const Timer timer(*this, statsPhase_forwardTransform);
+			if (workers.threadCount() > 1)
+				workers.forEach(Shape::channelCount((int)analysed.cols()), [&](int c) {
+					transforms.forward(previous.log2TransformLength, previous.windowedInput.middleCols(c, 1), analysed.middleCols(c, 1));
+				});
+			else
+				transforms.forward(previous.log2TransformLength, previous.windowedInput, analysed);
+			for (int g = 0; g < groupCount(); ++g)
+				polar<Shape>(previous, g, analysed);
+		}
 
-		const auto n = Fourier::binCount(grain.log2TransformLength) - 1;
-		grain.validBinCount = std::min<int>(std::ceil(n / grain.resampleOperations.output.ratio), n) + 1;
-		transformed.middleRows(grain.validBinCount, n + 1 - grain.validBinCount).setZero();
+		// Unless the backend batches channels, each channel is transformed as soon as it is windowed, while still in cache.
+		// Channels quiet enough that the grain might yet be silent wait until that is known, below.
+		const bool fused = !grain.bypass && !transforms.batchedForward(grain.log2TransformLength);
+		const auto transform = [&](int c) {
+			if (input.channelEnergy[c] > input.silentEnergy)
+				transforms.forward(grain.log2TransformLength, input.windowedInput.middleCols(c, 1), analysed.middleCols(c, 1));
+		};
+		const auto windowed = fused ? Input::Windowed::of(transform) : Input::Windowed{};
+		const auto window = input.windowFor(grain.log2TransformLength);
+
+		int log2TransformLength;
+		if (sampleFormat != sampleFormat_float32 && !grain.resampleOperations.input.function && !(Instrumentation::enabled || Bungee::Assert::level))
+		{
+			// Conversion to float is fused with the analysis window
+			const Timer timer(*this, statsPhase_analysisWindow);
+			grain.clampMuteFrameCounts(data, muteFrameCountHead, muteFrameCountTail);
+			log2TransformLength = input.applyAnalysisWindow(sampleFormat, data, channelStride, frameStride, grain.inputChunk.end - grain.inputChunk.begin, window, muteFrameCountHead, muteFrameCountTail, workers, windowed);
+		}
+		else
+		{
+			if (sampleFormat != sampleFormat_float32)
+			{
+				grain.clampMuteFrameCounts(data, muteFrameCountHead, muteFrameCountTail);
+				auto converted = input.convert(sampleFormat, data, channelStride, frameStride, grain.inputChunk.end - grain.inputChunk.begin, muteFrameCountHead, muteFrameCountTail);
+				data = converted.data();
+				channelStride = converted.colStride();
+				frameStride = 1;
+			}
 
-		grain.log2TransformLength = log2TransformLength;
+			auto m = grain.inputChunkMap((const float *)data, channelStride, frameStride, muteFrameCountHead, muteFrameCountTail, previous, *this);
 
-		for (int i = 0; i < grain.validBinCount; ++i)
-		{
-			const auto x = transformed.row(i).sum();
-			grain.energy[i] = x.real() * x.real() + x.imag() * x.imag();
-			grain.phase[i] = Phase::fromRadians(std::arg(x));
+			auto ref = grain.resampleInput(m, log2AnalysisLength(), muteFrameCountHead, muteFrameCountTail, input.resampled, *this);
+
+			const Timer timer(*this, statsPhase_analysisWindow);
+			log2TransformLength = input.applyAnalysisWindow<Shape>(ref, window, muteFrameCountHead, muteFrameCountTail, workers, windowed);
 		}
 
-		Partials::enumerate(grain.partials, grain.validBinCount, grain.energy);
+		// A silent grain needs no forward transform and, in synthesiseSpectrum(), no inverse transform
+		grain.silent = !grain.bypass && input.silent();
+		if (grain.bypass)
+		{
+			grain.windowedInput = input.windowedInput;
+		}
+		else if (grain.silent)
+		{
+			analysed.setZero();
+		}
+		else
+		{
+			const Timer timer(*this, statsPhase_forwardTransform);
+
+			// Without workers to share channels, all channels go to a batching backend in one call
+			if (fused)
+			{
+				for (int c = 0; c < analysed.cols(); ++c)
+					if (!(input.channelEnergy[c] > input.silentEnergy))
+						transforms.forward(log2TransformLength, input.windowedInput.middleCols(c, 1), analysed.middleCols(c, 1));
+			}
+			else if (workers.threadCount() > 1)
+				workers.forEach(Shape::channelCount((int)analysed.cols()), [&](int c) {
+					transforms.forward(log2TransformLength, input.windowedInput.middleCols(c, 1), analysed.middleCols(c, 1));
+				});
+			else
+				transforms.forward(log2TransformLength, input.windowedInput, analysed);
+			analysed.middleRows(grain.validBinCount, n + 1 - grain.validBinCount).setZero();
+		}
 
-		if (grain.continuous)
-			Partials::suppressTransientPartials(grain.partials, grain.energy, grains[1].energy);
+		grain.log2TransformLength = log2TransformLength;
 	}
 }
 
-void Internal::Stretcher::synthesiseGrain(OutputChunk &outputChunk)
+template <class Shape>
+void Internal::Stretcher::analyseSpectrum()
 {
-	Instrumentation::Call call(*this, 2);
+	const Assert::FloatingPointExceptions floatingPointExceptions(FE_INEXACT | FE_UNDERFLOW | FE_DENORMALOPERAND);
 
+	auto &grain = grains[0];
+	if (grain.valid() && !grain.bypass)
+	{
+		const auto &analysed = pipelined ? transformedNext : transformed;
+		for (int g = 0; g < groupCount(); ++g)
+		{
+			auto &group = grain.groups[g];
+			{
+				const Timer timer(*this, statsPhase_polar);
+				polar<Shape>(grain, g, analysed);
+			}
+
+			if constexpr (Assert::level >= 2)
+				for (int i = 0; i < grain.validBinCount; ++i)
+				{
+					const auto x = analysed.row(i).segment(groupBegin[g], groupBegin[g + 1] - groupBegin[g]).sum();
+					BUNGEE_ASSERT2(group.energy[i] == x.real() * x.real() + x.imag() * x.imag());
+					BUNGEE_ASSERT2(std::abs(Phase::Type(group.phase[i] - Phase::fromRadians(std::arg(x)))) <= 2);
+				}
+
+			const auto &previous = grains[1];
+			const auto &previousGroup = previous.groups[g];
+
+			// Partial tracking follows the previous grain's partials while the spectrum is sparse and changes little
+			constexpr float trackingFlux = 0.1f; // fudge: lower constant finds new partials sooner, higher tracks more grains
+			constexpr int trackingSparsity = 16; // fudge: least bins per partial, below which enumeration is as fast
+			constexpr float trackingDepth = 1e-6f; // fudge: peaks 60 dB below the strongest are noise floor, and are not tracked
+			bool tracked = partialTracking && grain.continuous && !previous.bypass && !previous.silent && previous.flux <= trackingFlux;
+			tracked = tracked && previous.log2TransformLength == grain.log2TransformLength && previous.validBinCount == grain.validBinCount;
+			tracked = tracked && grain.validBinCount >= 2 && previousGroup.partials.size() > 0;
+
+			{
+				const Timer timer(*this, statsPhase_enumeratePartials);
+
+				float trackingFloor = 0.f;
+				if (tracked)
+				{
+					// Sparsity counts only partials above the noise floor, of which a single-precision transform has many
+					for (int i = 0; i < previousGroup.partials.size(); ++i)
+						trackingFloor = std::max(trackingFloor, previousGroup.energy[previousGroup.partials[i].peak]);
+					trackingFloor *= trackingDepth;
+
+					int significant = 0;
+					for (int i = 0; i < previousGroup.partials.size(); ++i)
+						significant += previousGroup.energy[previousGroup.partials[i].peak] >= trackingFloor;
+					tracked = significant * trackingSparsity <= grain.validBinCount;
+				}
+				if (tracked)
+				{
+					// A change of total energy by more than a factor of two is large change
+					const float energy = group.energy.head(grain.validBinCount).sum();
+					const float previousEnergy = previousGroup.energy.head(grain.validBinCount).sum();
+					tracked = energy <= 2 * previousEnergy && previousEnergy <= 2 * energy;
+				}
+
+				tracked = tracked && Partials::track(group.partials, previousGroup.partials, grain.validBinCount, group.energy, previousGroup.energy, trackingFloor);
+				if (!tracked)
+					Partials::enumerate(group.partials, grain.validBinCount, group.energy);
+			}
+
+			if (grain.continuous)
+			{
+				const Timer timer(*this, statsPhase_suppressTransientPartials);
+
+				// Across a change of transform length, the previous grain's peaks differ in bin and in energy
+				const int log2PreviousRatio = previous.log2TransformLength - grain.log2TransformLength;
+				float previousScale = 1.f;
+				if (log2PreviousRatio)
+					previousScale = log2PreviousRatio > 0 ? input.shortWindowGain * input.shortWindowGain : 1.f / (input.shortWindowGain * input.shortWindowGain);
+
+				// A transient in any group shortens multi-resolution transforms for all
+				const auto previousBinCount = log2PreviousRatio ? previous.validBinCount : (int)previousGroup.energy.rows();
+				float flux = Partials::suppressTransientPartials(group.partials, group.energy, previousGroup.energy.head(previousBinCount), log2PreviousRatio, previousScale);
+
+				// Tracked partials of a grain whose peaks have grown are replaced by a full enumeration, timed in this phase
+				if (tracked && flux > trackingFlux)
+				{
+					Partials::enumerate(group.partials, grain.validBinCount, group.energy);
+					flux = Partials::suppressTransientPartials(group.partials, group.energy, previousGroup.energy.head(previousBinCount), log2PreviousRatio, previousScale);
+				}
+
+				grain.flux = g ? std::max(grain.flux, flux) : flux;
+			}
+		}
+	}
+}
+
+template <class Shape>
+void Internal::Stretcher::synthesiseSpectrum()
+{
 	const Assert::FloatingPointExceptions floatingPointExceptions(FE_INEXACT);
 
-	auto &grain = grains[0];
+	// In pipelined operation, synthesis lags analysis by one grain
+	const int lag = pipelined;
+	auto &grain = grains[lag];
+	output.lapped = false;
 	if (grain.valid())
 	{
 		BUNGEE_ASSERT1(!grain.passthrough || grain.analysis.speed == grain.passthrough);
 
-		synthesis.synthesise(log2SynthesisHop, grain, grains[1]);
+		if (grain.bypass)
+		{
+			// The inverse transform of the forward transform scales by the transform length, and conjugation reverses time
+			const auto transformLength = Fourier::transformLength(grain.log2TransformLength);
+			const auto scale = float(transformLength);
+			auto &t = output.inverseTransformed;
+			if (grain.reverse())
+			{
+				t.topRows(1) = grain.windowedInput.topRows(1) * scale;
+				t.middleRows(1, transformLength - 1) = grain.windowedInput.middleRows(1, transformLength - 1).colwise().reverse() * scale;
+			}
+			else
+			{
+				t.topRows(transformLength) = grain.windowedInput.topRows(transformLength) * scale;
+			}
+			for (int g = 0; g < groupCount(); ++g)
+				grain.groups[g].rotation.setZero();
+			return;
+		}
+
+		{
+			const Timer timer(*this, statsPhase_synthesise);
+			for (int g = 0; g < groupCount(); ++g)
+			{
+				synthesis.synthesise(log2SynthesisHop, grain, grains[lag + 1], g);
+				BUNGEE_ASSERT2(!grain.passthrough || grain.groups[g].rotation.topRows(grain.validBinCount).isZero());
+			}
+		}
 
-		BUNGEE_ASSERT2(!grain.passthrough || grain.rotation.topRows(grain.validBinCount).isZero());
+		// Phase and rotation of a silent grain are still synthesised above, for continuity with the next grain
+		if (grain.silent)
+		{
+			output.inverseTransformed.setZero();
+			return;
+		}
 
-		auto t = temporary.topRows(grain.validBinCount);
+		const Timer timer(*this, statsPhase_inverseTransform);
 
-		t = grain.rotation.topRows(grain.validBinCount).cast<float>() * (std::complex<float>{0, std::numbers::pi_v<float> / 0x8000});
-		t = t.exp();
+		for (int g = 0; g < groupCount(); ++g)
+		{
+			auto t = temporary.col(g).head(grain.validBinCount);
+			const auto &rotation = grain.groups[g].rotation;
+
+			for (int i = 0; i < grain.validBinCount; ++i)
+				t[i] = Phase::rotations(rotation[i]);
+
+			// Formant correction scales the same multiply
+			if (formantCorrected(grain))
+			{
+				formant.analyse(grain, g, grain.request.pitch);
+				t *= formant.gain.head(grain.validBinCount);
+			}
+		}
 
-		if (grain.reverse())
-			transformed.topRows(grain.validBinCount) = transformed.topRows(grain.validBinCount).conjugate().colwise() * t;
+		const auto rotate = [&](int c) {
+			const auto t = temporary.col(channelGroup[c]).head(grain.validBinCount);
+			auto bins = transformed.col(c).head(grain.validBinCount);
+			if (grain.reverse())
+				bins = bins.conjugate() * t;
+			else
+				bins *= t;
+		};
+
+		const int channelCount = Shape::channelCount((int)transformed.cols());
+		if (!transforms.batchedInverse(grain.log2TransformLength))
+		{
+			// Each channel is overlap-added as soon as it is inverse transformed, while still in cache
+			workers.forEach(channelCount, [&](int c) {
+				rotate(c);
+				transforms.inverse(grain.log2TransformLength, output.inverseTransformed.middleCols(c, 1), transformed.middleCols(c, 1));
+				output.applySynthesisWindow<Shape>(c, log2SynthesisHop, grain, output.synthesisWindow);
+			});
+			output.lapped = true;
+		}
+		else if (workers.threadCount() > 1)
+		{
+			workers.forEach(channelCount, [&](int c) {
+				rotate(c);
+				transforms.inverse(grain.log2TransformLength, output.inverseTransformed.middleCols(c, 1), transformed.middleCols(c, 1));
+			});
+		}
 		else
-			transformed.topRows(grain.validBinCount) = transformed.topRows(grain.validBinCount).colwise() * t;
-
-		transforms.inverse(grain.log2TransformLength, output.inverseTransformed, transformed);
+		{
+			for (int c = 0; c < channelCount; ++c)
+				rotate(c);
+			transforms.inverse(grain.log2TransformLength, output.inverseTransformed, transformed);
+		}
 	}
+}
 
-	output.applySynthesisWindow(log2SynthesisHop, grains, output.synthesisWindow);
+template <class Shape>
+void Internal::Stretcher::synthesiseOutput(OutputChunk &outputChunk)
+{
+	const Assert::FloatingPointExceptions floatingPointExceptions(FE_INEXACT);
 
-	outputChunk = output.resample(grains[2].resampleOperations.output, grains[1].resampleOperations.output);
+	const int lag = pipelined;
+	if (!output.lapped)
+	{
+		const Timer timer(*this, statsPhase_overlapAdd);
+		output.applySynthesisWindow<Shape>(log2SynthesisHop, grains[lag], output.synthesisWindow, workers);
+	}
+
+	{
+		const Timer timer(*this, statsPhase_outputResample);
+		outputChunk = output.resample(grains[lag + 2].resampleOperations.output, grains[lag + 1].resampleOperations.output);
+	}
 
-	outputChunk.request[OutputChunk::begin] = &grains[2].request;
-	outputChunk.request[OutputChunk::end] = &grains[1].request;
+	outputChunk.request[OutputChunk::begin] = &grains[lag + 2].request;
+	outputChunk.request[OutputChunk::end] = &grains[lag + 1].request;
 }
 
 extern const char *versionDescription;
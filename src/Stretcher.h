@@ -4,14 +4,18 @@
 #pragma once
 
 #include "Assert.h"
+#include "Formant.h"
 #include "Grains.h"
 #include "Input.h"
 #include "Instrumentation.h"
 #include "Output.h"
 #include "Synthesis.h"
 #include "Timing.h"
+#include "Workers.h"
 
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 namespace Bungee::Internal {
 
@@ -19,25 +23,134 @@ struct Stretcher :
 	Timing,
 	Instrumentation
 {
+	// Holds the fixed-size buffers below, and those of input, grains, output and synthesis, in one allocation
+	Arena arena;
+
 	Fourier::Transforms transforms;
+	Workers workers;
 	Input input;
 	Grains grains;
 	Output output;
 	Synthesis synthesis;
-	Eigen::ArrayXcf temporary;
-	Eigen::ArrayXXcf transformed;
+	Formant formant;
+	Mapped<Eigen::ArrayXXcf> temporary; // a column for each channel group
+	Mapped<Eigen::ArrayXXcf> transformed;
+
+	// Channel groups: group g is channels [groupBegin[g], groupBegin[g + 1]), which share phase and so stay coherent
+	std::vector<int> groupBegin;
+	std::vector<int> channelGroup; // of each channel
+
+	// Pipelined operation: analysis of each grain, into transformedNext, runs concurrently with synthesis of the previous grain
+	bool pipelined{};
+	Mapped<Eigen::ArrayXXcf> transformedNext;
+	OutputChunk pipelinedOutputChunk{};
+
+	// Multi-resolution operation: transient grains are analysed and synthesised with transforms of half the usual length
+	bool multiResolution{};
+
+	// Formant preservation: pitch-shifted grains are corrected, bin by bin, to keep their spectral envelope
+	bool formantPreservation{};
 
-	Stretcher(SampleRates sampleRates, int channelCount, int log2SynthesisHopAdjust);
+	// Partial tracking: while the spectrum changes little, each grain's partials follow the previous grain's
+	bool partialTracking{};
 
+	// Interpolation filter of the resampling of subsequent grains
+	InterpolationMode interpolationMode{};
+
+	Stretcher(SampleRates sampleRates, int channelCount, int log2SynthesisHopAdjust, const Allocator *allocator = nullptr);
+
+	// Lays out all fixed-size buffers in arena
+	void allocate(int channelCount);
+
+	// Also allocates storage for the checks of instrumentation, so that they do not allocate on the grain path
 	void enableInstrumentation(bool enable);
 
-	InputChunk specifyGrain(const Request &request, double bufferStartPosition);
+	void enableRealTime(bool enable);
+
+	// Also prepares the short window and transforms, so that grains do not allocate
+	void enableMultiResolution(bool enable);
 
-	void analyseGrain(const float *inputAudio, std::ptrdiff_t stride, int muteFrameCountHead, int muteFrameCountTail);
+	// As above, for low-latency operation, in which every grain uses the short transform
+	void enableLowLatency(bool enable);
+
+	// Input frames by which the first frame of each output chunk lags the end of the latest grain's input chunk
+	double latency(const Request &request) const;
+
+	// Output pitch ramps from the previous grain along the parabola through pitchMidpoint, or linearly if it is zero
+	InputChunk specifyGrain(const Request &request, double bufferStartPosition, double pitchMidpoint = 0.);
+
+	void analyseGrain(const void *inputAudio, SampleFormat sampleFormat, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int muteFrameCountHead, int muteFrameCountTail);
 
 	void synthesiseGrain(OutputChunk &outputChunk);
 
+	// Also writes the output chunk's audio as dithered 16-bit samples
+	void synthesiseGrain(OutputChunk &outputChunk, int16_t *data, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride);
+
+	void enablePipelining(bool enable);
+
+	// Divides the channels into consecutive groups of the given sizes, or one group if groupCount is zero, returning false
+	// and changing nothing if the sizes do not sum to the channel count or the stretcher is not flushed. Does not allocate.
+	bool setChannelGroups(const int *channelCounts, int groupCount);
+
+	inline int groupCount() const
+	{
+		return (int)groupBegin.size() - 1;
+	}
+
+	static void processGrains(int count, Stretcher *const *stretchers, const GrainInput *inputs, OutputChunk *outputChunks);
+
 	bool isFlushed() const;
+
+	inline bool formantCorrected(const Grain &grain) const
+	{
+		return formantPreservation && grain.request.pitch != 1.;
+	}
+
+	// Serialises the state that carries from one grain to the next, writing it to data if capacity allows and returning its size
+	std::size_t snapshot(void *data, std::size_t capacity) const;
+
+	// Replaces that state with a snapshot of a stretcher of the same configuration, returning false and changing nothing otherwise
+	bool restore(const void *data, std::size_t size);
+
+	// Visits that state in snapshot order, with a Snapshot::Writer or Snapshot::Reader (see Snapshot.cpp)
+	template <class Archive>
+	void transfer(Archive &archive);
+
+	// Backend of the transforms of grains
+	inline FftBackend fftBackend() const
+	{
+		return transforms.selected(log2SynthesisHop + 3);
+	}
+
+	// Stages of analyseGrain() and synthesiseGrain()
+	void analyseInput(const void *inputAudio, SampleFormat sampleFormat, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int muteFrameCountHead, int muteFrameCountTail);
+	void analyseSpectrum();
+	void synthesiseSpectrum();
+	void synthesiseOutput(OutputChunk &outputChunk);
+
+	// The stages above call these, compiled for a fixed Shape where one matches the stretcher (see Shape.h)
+	template <class Shape>
+	void analyseInput(const void *inputAudio, SampleFormat sampleFormat, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int muteFrameCountHead, int muteFrameCountTail);
+	template <class Shape>
+	void analyseSpectrum();
+	template <class Shape>
+	void synthesiseSpectrum();
+	template <class Shape>
+	void synthesiseOutput(OutputChunk &outputChunk);
+
+	// Energy and phase of each bin of the sum of a channel group's channels
+	template <class Shape>
+	void polar(Grain &grain, int group, const Mapped<Eigen::ArrayXXcf> &analysed);
+
+	struct Stages
+	{
+		void (Stretcher::*analyseInput)(const void *inputAudio, SampleFormat sampleFormat, std::ptrdiff_t channelStride, std::ptrdiff_t frameStride, int muteFrameCountHead, int muteFrameCountTail);
+		void (Stretcher::*analyseSpectrum)();
+		void (Stretcher::*synthesiseSpectrum)();
+		void (Stretcher::*synthesiseOutput)(OutputChunk &outputChunk);
+	};
+
+	const Stages *stages;
 };
 
 template <class S, const char *const *e, const char *const *v>
@@ -50,14 +163,50 @@ struct Functions :
 		version = []() { return *v; };
 		create = [](SampleRates sampleRates, int channelCount, int log2SynthesisHop) { return (void *)new S(sampleRates, channelCount, log2SynthesisHop); };
 		destroy = [](void *stretcher) { delete reinterpret_cast<S *>(stretcher); };
-		enableInstrumentation = [](void *stretcher, int enable) { reinterpret_cast<S *>(stretcher)->Instrumentation::enableInstrumentation(enable); };
+		enableInstrumentation = [](void *stretcher, int enable) { reinterpret_cast<S *>(stretcher)->enableInstrumentation(enable); };
 		maxInputFrameCount = [](const void *stretcher) { return reinterpret_cast<const S *>(stretcher)->maxInputFrameCount(true); };
 		preroll = [](const void *stretcher, Request *request) { reinterpret_cast<const S *>(stretcher)->preroll(*request); };
 		next = [](const void *stretcher, Request *request) { reinterpret_cast<const S *>(stretcher)->next(*request); };
 		specifyGrain = [](void *stretcher, const Request *request, double bufferStartPosition) { return reinterpret_cast<S *>(stretcher)->specifyGrain(*request, bufferStartPosition); };
-		analyseGrain = [](void *stretcher, const float *data, intptr_t channelStride, int muteFrameCountHead, int muteFrameCountTail) { reinterpret_cast<S *>(stretcher)->analyseGrain(data, channelStride, muteFrameCountHead, muteFrameCountTail); };
+		analyseGrain = [](void *stretcher, const float *data, intptr_t channelStride, int muteFrameCountHead, int muteFrameCountTail) { reinterpret_cast<S *>(stretcher)->analyseGrain(data, sampleFormat_float32, channelStride, 1, muteFrameCountHead, muteFrameCountTail); };
 		synthesiseGrain = [](void *stretcher, OutputChunk *outputChunk) { reinterpret_cast<S *>(stretcher)->synthesiseGrain(*outputChunk); };
 		isFlushed = [](const void *stretcher) { return reinterpret_cast<const S *>(stretcher)->grains.flushed(); };
+		processGrains = [](int count, void *const *stretchers, const GrainInput *inputs, OutputChunk *outputChunks) { S::processGrains(count, reinterpret_cast<S *const *>(stretchers), inputs, outputChunks); };
+		setThreadCount = [](void *stretcher, int threadCount) { reinterpret_cast<S *>(stretcher)->workers.setThreadCount(threadCount); };
+		enablePipelining = [](void *stretcher, int enable) { reinterpret_cast<S *>(stretcher)->enablePipelining(enable); };
+		analyseGrainStrided = [](void *stretcher, const float *data, intptr_t channelStride, intptr_t frameStride, int muteFrameCountHead, int muteFrameCountTail) { reinterpret_cast<S *>(stretcher)->analyseGrain(data, sampleFormat_float32, channelStride, frameStride, muteFrameCountHead, muteFrameCountTail); };
+		enableInterleavedOutput = [](void *stretcher, int enable) { reinterpret_cast<S *>(stretcher)->output.interleaved = enable; };
+		analyseGrainFormatted = [](void *stretcher, const void *data, SampleFormat sampleFormat, intptr_t channelStride, intptr_t frameStride, int muteFrameCountHead, int muteFrameCountTail) { reinterpret_cast<S *>(stretcher)->analyseGrain(data, sampleFormat, channelStride, frameStride, muteFrameCountHead, muteFrameCountTail); };
+		synthesiseGrainInt16 = [](void *stretcher, OutputChunk *outputChunk, int16_t *data, intptr_t channelStride, intptr_t frameStride) { reinterpret_cast<S *>(stretcher)->synthesiseGrain(*outputChunk, data, channelStride, frameStride); };
+		maxOutputFrameCount = [](const void *stretcher) { return reinterpret_cast<const S *>(stretcher)->maxOutputFrameCount(true); };
+		getStats = [](const void *stretcher, Stats *stats) { reinterpret_cast<const S *>(stretcher)->getStats(*stats); };
+		setFftBackend = [](void *stretcher, FftBackend backend) -> bool { return reinterpret_cast<S *>(stretcher)->transforms.select(backend); };
+		setDefaultFftBackend = [](FftBackend backend) -> bool { return Fourier::setDefaultBackend(backend); };
+		fftBackend = [](const void *stretcher) { return reinterpret_cast<const S *>(stretcher)->fftBackend(); };
+		enableRealTime = [](void *stretcher, int enable) { reinterpret_cast<S *>(stretcher)->enableRealTime(enable); };
+		enableMultiResolution = [](void *stretcher, int enable) { reinterpret_cast<S *>(stretcher)->enableMultiResolution(enable); };
+		enableLowLatency = [](void *stretcher, int enable) { reinterpret_cast<S *>(stretcher)->enableLowLatency(enable); };
+		latency = [](const void *stretcher, const Request *request) { return reinterpret_cast<const S *>(stretcher)->latency(*request); };
+		schedule = [](const void *stretcher, const Keyframe *keyframes, int keyframeCount, Request *requests, InputChunk *inputChunks, int capacity) { return reinterpret_cast<const S *>(stretcher)->schedule(keyframes, keyframeCount, requests, inputChunks, capacity); };
+		snapshot = [](const void *stretcher, void *data, intptr_t capacity) { return (intptr_t)reinterpret_cast<const S *>(stretcher)->snapshot(data, capacity > 0 ? capacity : 0); };
+		restore = [](void *stretcher, const void *data, intptr_t size) -> bool { return size >= 0 && reinterpret_cast<S *>(stretcher)->restore(data, size); };
+		enableFormantPreservation = [](void *stretcher, int enable) { reinterpret_cast<S *>(stretcher)->formantPreservation = enable; };
+		setChannelGroups = [](void *stretcher, const int *channelCounts, int groupCount) -> bool { return reinterpret_cast<S *>(stretcher)->setChannelGroups(channelCounts, groupCount); };
+		createWithAllocator = [](SampleRates sampleRates, int channelCount, int log2SynthesisHop, const Allocator *allocator) -> void * {
+			// No exception may cross the C interface
+			try
+			{
+				return new S(sampleRates, channelCount, log2SynthesisHop, allocator);
+			}
+			catch (const std::bad_alloc &)
+			{
+				return nullptr;
+			}
+		};
+		enablePartialTracking = [](void *stretcher, int enable) { reinterpret_cast<S *>(stretcher)->partialTracking = enable; };
+		setInterpolationMode = [](void *stretcher, InterpolationMode interpolationMode) { reinterpret_cast<S *>(stretcher)->interpolationMode = interpolationMode; };
+		specifyGrainWithPitchMidpoint = [](void *stretcher, const Request *request, double bufferStartPosition, double pitchMidpoint) { return reinterpret_cast<S *>(stretcher)->specifyGrain(*request, bufferStartPosition, pitchMidpoint); };
+		outputFrameStride = [](const void *stretcher) { return (intptr_t)reinterpret_cast<const S *>(stretcher)->output.chunkFrameStride(); };
 	}
 };
 
@@ -5,6 +5,7 @@
 
 #include "Dispatch.h"
 #include "Grains.h"
+#include "Scan.h"
 #include "Stretch.h"
 #include "log2.h"
 
@@ -16,32 +17,44 @@ static constexpr int flagReverse1 = 1 << 1;
 struct Synthesis::Temporal
 {
 	template <int index>
-	static void special(int log2SynthesisHop, Grain &grain, Grain &previous, Eigen::ArrayX<Phase::Type> &delta)
+	static void special(int log2SynthesisHop, Grain &grain, Grain &previous, int group, Mapped<Eigen::ArrayX<Phase::Type>> &delta)
 	{
+		auto &g = grain.groups[group];
+		const auto &p = previous.groups[group];
+
 		typedef Stretch::Time<!!(index & flagReverse0), !!(index & flagReverse1)> StretchTime;
 
-		const StretchTime stretchTime(log2SynthesisHop, grain.analysis.hop, previous.analysis.hop);
+		const StretchTime stretchTime(log2SynthesisHop, grain.log2TransformLength, grain.analysis.hop, previous.analysis.hop);
+
+		BUNGEE_ASSERT1(g.partials.back().end == grain.validBinCount);
 
-		BUNGEE_ASSERT1(grain.partials.back().end == grain.validBinCount);
+		// After a change of transform length, each peak continues from the previous grain's equivalent peak
+		const int log2PreviousRatio = previous.log2TransformLength - grain.log2TransformLength;
 
-		for (int i = 0; i < grain.partials.size(); ++i)
+		for (int i = 0; i < g.partials.size(); ++i)
 		{
-			const auto peak = grain.partials[i].peak;
+			const auto peak = g.partials[i].peak;
 
-			const Phase::Type offset = StretchTime::offset(grain.phase[peak], previous.phase[peak]);
-			const Phase::Type stretched = stretchTime.delta(grain.phase[peak], previous.phase[peak], peak);
-			delta[i] = previous.rotation[peak] - offset + stretched;
+			int q = peak;
+			if (log2PreviousRatio)
+				q = Partials::equivalentPeak(peak, log2PreviousRatio, p.energy.data(), previous.validBinCount);
+
+			const Phase::Type offset = StretchTime::offset(g.phase[peak], p.phase[q]);
+			const Phase::Type stretched = stretchTime.delta(g.phase[peak], p.phase[q], peak);
+			delta[i] = p.rotation[q] - offset + stretched;
 			BUNGEE_ASSERT2(!grain.passthrough || !delta[i]);
 
-			delta[i] -= grain.rotation[peak];
+			delta[i] -= g.rotation[peak];
 		}
 	}
 };
 
-void Synthesis::synthesise(int log2SynthesisHop, Grain &grain, Grain &previous)
+void Synthesis::synthesise(int log2SynthesisHop, Grain &grain, Grain &previous, int group)
 {
-	Stretch::Frequency(grain.analysis.speed)(grain.validBinCount, grain.rotation, grain.phase);
-	BUNGEE_ASSERT2(!grain.passthrough || grain.rotation.topRows(grain.validBinCount).isZero());
+	auto &g = grain.groups[group];
+
+	Stretch::Frequency(grain.analysis.speed)(grain.validBinCount, g.rotation, g.phase);
+	BUNGEE_ASSERT2(!grain.passthrough || g.rotation.topRows(grain.validBinCount).isZero());
 
 	if (grain.continuous)
 	{
@@ -52,25 +65,37 @@ void Synthesis::synthesise(int log2SynthesisHop, Grain &grain, Grain &previous)
 			index |= flagReverse1;
 
 		static constexpr Dispatch<Temporal, 4> dispatch;
-		dispatch[index](log2SynthesisHop, grain, previous, delta);
+		dispatch[index](log2SynthesisHop, grain, previous, group, delta);
 	}
 	else
 	{
-		for (int i = 0; i < grain.partials.size(); ++i)
-			delta[i] = -grain.rotation[grain.partials[i].peak];
+		for (int i = 0; i < g.partials.size(); ++i)
+			delta[i] = -g.rotation[g.partials[i].peak];
 	}
 
-	for (int i = 0, n = 0; i < grain.partials.size(); ++i)
-		do
+	// Each partial's region, which extends to its end but covers at least one bin, is rotated by its delta:
+	// a prefix sum of the steps in delta at the start of each region
+	int n = 0;
+	{
+		steps.topRows(grain.validBinCount).setZero();
+
+		Phase::Type previousDelta = 0;
+		for (int i = 0; i < g.partials.size(); ++i)
 		{
-			grain.rotation[n] += delta[i];
-			BUNGEE_ASSERT1(!grain.passthrough || !grain.rotation[n]);
-		} while (++n < grain.partials[i].end);
+			BUNGEE_ASSERT1(!grain.passthrough || !delta[i]);
+			BUNGEE_ASSERT1(n < steps.rows());
+			steps[n] = delta[i] - previousDelta;
+			previousDelta = delta[i];
+			n = std::max<int>(n + 1, g.partials[i].end);
+		}
+		BUNGEE_ASSERT1(n <= grain.validBinCount);
+	}
+	Scan::accumulate(g.rotation.data(), steps.data(), n);
 
-	BUNGEE_ASSERT2(!grain.passthrough || grain.rotation.topRows(grain.validBinCount).isZero());
+	BUNGEE_ASSERT2(!grain.passthrough || g.rotation.topRows(grain.validBinCount).isZero());
 
 	const auto mNyquist = Fourier::binCount(grain.log2TransformLength) - 1;
-	grain.rotation[mNyquist] = grain.rotation[mNyquist - 1];
+	g.rotation[mNyquist] = g.rotation[mNyquist - 1];
 }
 
 } // namespace Bungee
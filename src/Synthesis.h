@@ -15,14 +15,19 @@ struct Synthesis
 {
 	struct Temporal;
 
-	Eigen::ArrayX<Phase::Type> delta;
+	Mapped<Eigen::ArrayX<Phase::Type>> delta;
 
-	Synthesis(int log2TransformLength)
+	// Change of delta at the first bin of each partial's region, zero elsewhere
+	Mapped<Eigen::ArrayX<Phase::Type>> steps;
+
+	inline void allocate(Arena &arena, int log2TransformLength)
 	{
-		Fourier::resize<true>(log2TransformLength, 1, delta);
+		Fourier::allocate<true>(arena, log2TransformLength, 1, delta);
+		Fourier::allocate<true>(arena, log2TransformLength, 1, steps);
 	}
 
-	void synthesise(int log2SynthesisHop, Grain &grain, Grain &previous);
+	// Rotation of one channel group of grain, continuing from that group of previous
+	void synthesise(int log2SynthesisHop, Grain &grain, Grain &previous, int group);
 };
 
 } // namespace Bungee
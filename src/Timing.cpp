@@ -8,6 +8,7 @@
 
 #include "bungee/Bungee.h"
 
+#include <cmath>
 #include <cstdint>
 
 namespace Bungee {
@@ -55,4 +56,76 @@ void Timing::next(Request &request) const
 	}
 }
 
+InputChunk Timing::inputChunk(const Request &request, double bufferStartPosition) const
+{
+	if (std::isnan(request.position))
+		return InputChunk{};
+
+	Resample::Operations resampleOperations;
+	resampleOperations.setup(sampleRates, request.pitch, request.resampleMode);
+	const int halfInputFrameCount = Grain::halfInputFrameCount(log2AnalysisLength(), resampleOperations.input.ratio);
+
+	const int offset = int(std::round(request.position - bufferStartPosition));
+	return InputChunk{offset - halfInputFrameCount, offset + halfInputFrameCount};
+}
+
+int Timing::schedule(const Keyframe *keyframes, int keyframeCount, Request *requests, InputChunk *inputChunks, int capacity) const
+{
+	if (keyframeCount < 1 || std::isnan(keyframes[0].request.position))
+		return 0;
+
+	// Output frames between successive grains, which are independent of speed
+	const auto outputHop = [&](const Request &request) {
+		const double unitHop = (1 << log2SynthesisHop) * Resample::Operations().setup(sampleRates, request.pitch, request.resampleMode);
+		return unitHop * sampleRates.output / sampleRates.input;
+	};
+
+	Request request = keyframes[0].request;
+	preroll(request);
+
+	// The first grain after preroll is at the first keyframe's output frame
+	double outputFrame = keyframes[0].outputFrame - outputHop(request);
+	const double endOutputFrame = keyframes[keyframeCount - 1].outputFrame;
+
+	int count = 0;
+	for (int k = 0; outputFrame <= endOutputFrame; outputFrame += outputHop(request), next(request))
+	{
+		if (count)
+		{
+			// Keyframes take effect in turn, seeking where they have a position
+			while (k + 1 < keyframeCount && keyframes[k + 1].outputFrame <= outputFrame)
+			{
+				++k;
+				if (!std::isnan(keyframes[k].request.position))
+				{
+					request.position = keyframes[k].request.position;
+					request.reset = keyframes[k].request.reset;
+				}
+			}
+
+			const auto &from = keyframes[k];
+			request.speed = from.request.speed;
+			request.pitch = from.request.pitch;
+			request.resampleMode = from.request.resampleMode;
+
+			if (k + 1 < keyframeCount && keyframes[k + 1].outputFrame > from.outputFrame)
+			{
+				const auto &to = keyframes[k + 1];
+				const double t = (outputFrame - from.outputFrame) / (to.outputFrame - from.outputFrame);
+				request.speed += t * (to.request.speed - from.request.speed);
+				request.pitch += t * (to.request.pitch - from.request.pitch);
+			}
+		}
+
+		if (count < capacity)
+		{
+			requests[count] = request;
+			inputChunks[count] = inputChunk(request, 0.);
+		}
+		++count;
+	}
+
+	return count;
+}
+
 } // namespace Bungee
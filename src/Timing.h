@@ -12,8 +12,17 @@ struct Timing
 	const int log2SynthesisHop;
 	const SampleRates sampleRates;
 
+	// Low-latency operation: every grain is analysed with a transform of half the usual length, so reads half as much input
+	bool lowLatency{};
+
 	Timing(SampleRates sampleRates, int log2SynthesisHopAdjust);
 
+	// Length of the transforms that input chunks span
+	inline int log2AnalysisLength() const
+	{
+		return log2SynthesisHop + 3 - lowLatency;
+	}
+
 	int maxInputFrameCount(bool mayDownsampleInput) const;
 	int maxOutputFrameCount(bool mayUpsampleOutput) const;
 
@@ -22,6 +31,13 @@ struct Timing
 	void preroll(Request &request) const;
 
 	void next(Request &request) const;
+
+	// Input chunk that specifyGrain() would return for request
+	InputChunk inputChunk(const Request &request, double bufferStartPosition) const;
+
+	// Requests and input chunks of every grain of a timeline, from preroll, without changing any stretcher state.
+	// Returns the number of grains, of which the first capacity are written.
+	int schedule(const Keyframe *keyframes, int keyframeCount, Request *requests, InputChunk *inputChunks, int capacity) const;
 };
 
 } // namespace Bungee
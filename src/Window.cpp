@@ -8,6 +8,10 @@
 #include <Eigen/Core>
 
 #include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
 namespace Bungee::Window {
 
@@ -28,4 +32,23 @@ Eigen::ArrayXf fromFrequencyDomainCoefficients(Fourier::Transforms &transforms,
 	return window;
 }
 
+std::shared_ptr<const Eigen::ArrayXf> shared(int log2Size, float gain, std::initializer_list<float> coefficients)
+{
+	typedef std::tuple<int, float, std::vector<float>> Key;
+
+	static std::mutex mutex;
+	static std::map<Key, std::weak_ptr<const Eigen::ArrayXf>> registry;
+
+	const std::lock_guard lock(mutex);
+
+	auto &entry = registry[Key{log2Size, gain, coefficients}];
+	auto window = entry.lock();
+	if (!window)
+	{
+		Fourier::Transforms transforms;
+		entry = window = std::make_shared<const Eigen::ArrayXf>(fromFrequencyDomainCoefficients(transforms, log2Size, gain, coefficients));
+	}
+	return window;
+}
+
 } // namespace Bungee::Window
@@ -6,9 +6,14 @@
 #include "Fourier.h"
 
 #include <initializer_list>
+#include <memory>
 
 namespace Bungee::Window {
 
 Eigen::ArrayXf fromFrequencyDomainCoefficients(Fourier::Transforms &transforms, int log2Size, float gain, std::initializer_list<float> coefficients);
 
+// Returns a window from a process-wide, thread-safe cache so that all stretchers with equal
+// parameters share one reference-counted, read-only copy.
+std::shared_ptr<const Eigen::ArrayXf> shared(int log2Size, float gain, std::initializer_list<float> coefficients);
+
 } // namespace Bungee::Window
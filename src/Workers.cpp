@@ -0,0 +1,149 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#include "Workers.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#	include <immintrin.h>
+#endif
+
+namespace Bungee {
+
+namespace {
+
+static constexpr int spinCount = 4096;
+
+static inline uint32_t generationOf(uint64_t state)
+{
+	return uint32_t(state >> 32);
+}
+
+static inline uint32_t indexOf(uint64_t state)
+{
+	return uint32_t(state);
+}
+
+static inline void pause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+} // namespace
+
+Workers::~Workers()
+{
+	setThreadCount(1);
+}
+
+void Workers::setThreadCount(int threadCount)
+{
+	threadCount = std::max(threadCount, 1);
+	if (threadCount == this->threadCount())
+		return;
+
+	if (!threads.empty())
+	{
+		stop.store(true, std::memory_order_relaxed);
+		state.store((uint64_t(generationOf(state.load()) + 1) << 32), std::memory_order_release);
+		state.notify_all();
+		for (auto &thread : threads)
+			thread.join();
+		threads.clear();
+		stop.store(false, std::memory_order_relaxed);
+	}
+
+	threads.reserve(threadCount - 1);
+	for (int i = 1; i < threadCount; ++i)
+		threads.emplace_back(&Workers::run, this);
+}
+
+void Workers::setRealTime(bool enable)
+{
+	realTime.store(enable, std::memory_order_relaxed);
+
+	// A task wakes any sleeping workers, which then see the change
+	if (enable)
+		forEach(threadCount(), [](int) {});
+}
+
+void Workers::dispatch(int count, Function function, const void *context)
+{
+	BUNGEE_ASSERT1(pending.load() == 0);
+
+	active.store(true, std::memory_order_relaxed);
+	this->function.store(function, std::memory_order_relaxed);
+	this->context.store(context, std::memory_order_relaxed);
+	this->count.store(count, std::memory_order_relaxed);
+	pending.store(count, std::memory_order_relaxed);
+
+	const auto generation = generationOf(state.load(std::memory_order_relaxed)) + 1;
+	state.store(uint64_t(generation) << 32, std::memory_order_release);
+	state.notify_all(); // no system call unless a worker sleeps, which none do in real-time mode
+
+	work(generation);
+
+	const bool spinOnly = realTime.load(std::memory_order_relaxed);
+	for (int spin = 0;; ++spin)
+	{
+		const auto remaining = pending.load(std::memory_order_acquire);
+		if (!remaining)
+			break;
+		if (spin < spinCount || spinOnly)
+			pause();
+		else
+			pending.wait(remaining, std::memory_order_acquire);
+	}
+
+	active.store(false, std::memory_order_relaxed);
+}
+
+void Workers::work(uint32_t generation)
+{
+	auto s = state.load(std::memory_order_acquire);
+	while (generationOf(s) == generation && indexOf(s) < uint32_t(count.load(std::memory_order_relaxed)))
+	{
+		// Claiming with compare-exchange ensures that an item is only ever claimed by a thread that has seen its task
+		if (state.compare_exchange_weak(s, s + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			function.load(std::memory_order_relaxed)(context.load(std::memory_order_relaxed), (int)indexOf(s));
+			if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				pending.notify_one();
+			s = state.load(std::memory_order_acquire);
+		}
+	}
+}
+
+void Workers::run()
+{
+	uint32_t generation = generationOf(state.load(std::memory_order_acquire));
+	while (true)
+	{
+		uint64_t s;
+		for (int spin = 0;; ++spin)
+		{
+			s = state.load(std::memory_order_acquire);
+			if (generationOf(s) != generation)
+				break;
+			if (spin < spinCount)
+				pause();
+			else if (realTime.load(std::memory_order_relaxed))
+				std::this_thread::yield();
+			else
+				state.wait(s, std::memory_order_acquire);
+		}
+
+		generation = generationOf(s);
+		if (stop.load(std::memory_order_relaxed))
+			return;
+
+		work(generation);
+	}
+}
+
+} // namespace Bungee
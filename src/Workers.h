@@ -0,0 +1,74 @@
+// Copyright (C) 2020-2026 Parabola Research Limited
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include "Assert.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace Bungee {
+
+// An optional pool of worker threads that share independent items of work (typically channels) with the
+// calling thread. Threads are created by setThreadCount(); thereafter forEach() neither allocates nor
+// locks: work is handed off through atomics and idle workers sleep on an atomic wait.
+struct Workers
+{
+	Workers() = default;
+	Workers(const Workers &) = delete;
+	~Workers();
+
+	// Total number of threads, including the caller's, that will share work. Allocates, so call outside real-time code.
+	void setThreadCount(int threadCount);
+
+	inline int threadCount() const
+	{
+		return (int)threads.size() + 1;
+	}
+
+	// In real-time mode, idle workers yield rather than sleep and the caller spins until work is complete, so that
+	// forEach() never makes a system call, to wake a worker or to wait, at the cost of keeping worker cores busy.
+	void setRealTime(bool enable);
+
+	// Calls job(i) for each i in [0, count) and returns when all calls are complete.
+	// Calls made from within a job run inline on the calling thread.
+	template <class Job>
+	inline void forEach(int count, const Job &job)
+	{
+		if (threads.empty() || count < 2 || active.load(std::memory_order_relaxed))
+		{
+			for (int i = 0; i < count; ++i)
+				job(i);
+		}
+		else
+		{
+			dispatch(count, [](const void *context, int i) { (*static_cast<const Job *>(context))(i); }, &job);
+		}
+	}
+
+private:
+	typedef void (*Function)(const void *context, int i);
+
+	// Upper 32 bits: generation of the current task; lower 32 bits: index of the next unclaimed item.
+	std::atomic<uint64_t> state{};
+	std::atomic<int> pending{};
+
+	// Task description, published by the release store of a new generation to state.
+	// Atomic because a worker may still read these while the next task is being published.
+	std::atomic<Function> function{};
+	std::atomic<const void *> context{};
+	std::atomic<int> count{};
+	std::atomic<bool> stop{};
+	std::atomic<bool> active{};
+	std::atomic<bool> realTime{};
+	std::vector<std::thread> threads;
+
+	void dispatch(int count, Function function, const void *context);
+	void work(uint32_t generation);
+	void run();
+};
+
+} // namespace Bungee